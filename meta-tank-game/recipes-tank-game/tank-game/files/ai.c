@@ -0,0 +1,383 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ai.h"
+
+static const int dir_dx[4] = { 0, 0, -1, 1 }; // Indexed by Direction
+static const int dir_dy[4] = { -1, 1, 0, 0 };
+
+// Function to set up the AI for a game and attach it; bots are always driven, players only if in the mask
+int ai_init(Ai* ai, GameState* g, uint32_t players) {
+    size_t cells = (size_t)g->width * g->height;
+    memset(ai, 0, sizeof(Ai));
+    ai->players = players;
+    
+    for (int p = 0; p < NUM_PLAYERS; p++) {
+        AiField* f = &ai->fields[p];
+        f->target = p;
+        f->base = AI_BASE;
+        f->dist = malloc(cells * sizeof(uint32_t));
+        f->queue = malloc(cells * sizeof(uint32_t));
+        if (!f->dist || !f->queue) {
+            ai_free(ai, g);
+            return -1;
+        }
+        memset(f->dist, 0xFF, cells * sizeof(uint32_t)); // Out of reach everywhere
+    }
+    ai->threat = malloc(g->num_tanks * sizeof(int8_t));
+    ai->threat_gap = malloc(g->num_tanks * sizeof(uint8_t));
+    ai->plan = malloc(g->num_tanks * sizeof(int8_t));
+    if (!ai->threat || !ai->threat_gap || !ai->plan) {
+        ai_free(ai, g);
+        return -1;
+    }
+    
+    g->ai = ai;
+    return 0;
+}
+
+// Function to detach the AI from its game and release the fields
+void ai_free(Ai* ai, GameState* g) {
+    for (int p = 0; p < NUM_PLAYERS; p++) {
+        free(ai->fields[p].dist);
+        free(ai->fields[p].queue);
+        ai->fields[p].dist = NULL;
+        ai->fields[p].queue = NULL;
+    }
+    free(ai->threat);
+    free(ai->threat_gap);
+    free(ai->plan);
+    ai->threat = NULL;
+    ai->threat_gap = NULL;
+    ai->plan = NULL;
+    if (g->ai == ai) {
+        g->ai = NULL;
+    }
+}
+
+// Function to tell whether the AI drives a tank
+int ai_drives(GameState* g, int tank) {
+    if (!g->ai || (g->bot_driven && g->bot_driven[tank])) {
+        return 0;
+    }
+    return tank >= NUM_PLAYERS || (g->ai->players >> tank) & 1;
+}
+
+// Function to tell which tank a field leads to: its player while alive, then the p-th live bot, wrapping around.
+// It reads the board alone, so a round restored from a checkpoint follows the same targets as the one that was saved.
+// Once the players are dead the last bots hunt each other instead of wandering until the tick limit.
+static int field_target(GameState* g, int p) {
+    int live = 0;
+    
+    if (g->tanks[p].health > 0) {
+        return p;
+    }
+    for (int i = NUM_PLAYERS; i < g->num_tanks; i++) {
+        live += g->tanks[i].health > 0;
+    }
+    for (int i = NUM_PLAYERS, k = live ? p % live : 0; i < g->num_tanks; i++) {
+        if (g->tanks[i].health > 0 && k-- == 0) {
+            return i;
+        }
+    }
+    return p;
+}
+
+// Function to start a wave from the target's new cell; the old distances stay readable until the wave lowers them.
+// After a move base drops by the steps the field already holds for the new cell, which keeps every entry an upper
+// bound, so the wave only rewrites cells now nearer. A new target, or a cell the field never reached, drops base by
+// the cell count instead, so the wave rewrites every cell it reaches.
+static void start_wave(GameState* g, Ai* ai, AiField* f, int x, int y) {
+    uint32_t cells = (uint32_t)g->width * g->height;
+    size_t c = (size_t)y * g->width + x;
+    uint32_t steps = f->dist[c] - f->base;
+    
+    if (f->src_x < 0 || steps >= cells) {
+        steps = cells;
+        ai->rebuilds++;
+    }
+    if (f->base - steps < cells) {
+        // Shift base back up; entries left from older targets are out of reach of this one
+        for (uint32_t i = 0; i < cells; i++) {
+            f->dist[i] = f->dist[i] - f->base < cells ? f->dist[i] - f->base + AI_BASE : UINT32_MAX;
+        }
+        f->base = AI_BASE;
+    }
+    f->base -= steps;
+    f->dist[c] = f->base;
+    f->queue[0] = (uint32_t)y << 16 | x;
+    f->head = 0;
+    f->tail = 1;
+    f->src_x = x;
+    f->src_y = y;
+    ai->waves++;
+}
+
+// Function to advance a field's wave by up to budget cells, lowering the cells it reaches by a shorter way.
+// Cells come off the queue nearest first, so a cell is lowered, and queued, at most once per wave.
+static void run_wave(GameState* g, Ai* ai, AiField* f, long budget) {
+    uint32_t start = f->head;
+    
+    while (f->head < f->tail && budget-- > 0) {
+        uint32_t cell = f->queue[f->head++];
+        int x = cell & 0xFFFF;
+        int y = cell >> 16;
+        uint32_t next = f->dist[(size_t)y * g->width + x] + 1;
+        
+        for (int k = 0; k < 4; k++) {
+            int nx = x + dir_dx[k];
+            int ny = y + dir_dy[k];
+            if (nx < 0 || nx >= g->width || ny < 0 || ny >= g->height || WALL_AT(g, nx, ny)) {
+                continue;
+            }
+            uint32_t* d = &f->dist[(size_t)ny * g->width + nx];
+            if (*d <= next) {
+                continue;
+            }
+            *d = next;
+            f->queue[f->tail++] = (uint32_t)ny << 16 | nx;
+        }
+    }
+    ai->wave_cells += f->head - start;
+}
+
+// Function to rebuild every field from scratch for a new round
+void ai_reset(GameState* g) {
+    Ai* ai = g->ai;
+    size_t cells = (size_t)g->width * g->height;
+    
+    for (int p = 0; p < NUM_PLAYERS; p++) {
+        AiField* f = &ai->fields[p];
+        f->target = field_target(g, p);
+        Tank* t = &g->tanks[f->target];
+        memset(f->dist, 0xFF, cells * sizeof(uint32_t));
+        f->base = AI_BASE;
+        f->head = f->tail = 0;
+        f->src_x = f->src_y = -1;
+        if (t->health > 0) {
+            start_wave(g, ai, f, t->x, t->y);
+            run_wave(g, ai, f, (long)cells);
+        }
+    }
+}
+
+// Function to read the distance to the nearest target a tank hunts, AI_FAR if none
+static unsigned field_min(GameState* g, Ai* ai, int self, int x, int y) {
+    unsigned best = AI_FAR;
+    size_t c = (size_t)y * g->width + x;
+    
+    for (int p = 0; p < NUM_PLAYERS; p++) {
+        AiField* f = &ai->fields[p];
+        uint32_t steps = f->dist[c] - f->base;
+        if (f->target != self && g->tanks[f->target].health > 0 && steps < best) {
+            best = steps;
+        }
+    }
+    return best;
+}
+
+// Function to tell whether a tank could step onto a cell
+static int cell_open(GameState* g, int x, int y) {
+    return x >= 0 && x < g->width && y >= 0 && y < g->height && !WALL_AT(g, x, y) && !TANK_AT(g, x, y);
+}
+
+// Function to pick a step down the fields, straight ahead winning ties (caller holds board_mutex).
+// With no target left the tank wanders, turning when it runs into something. Returns -1 to stay.
+static int steer(GameState* g, Ai* ai, int i) {
+    Tank* t = &g->tanks[i];
+    unsigned best = field_min(g, ai, i, t->x, t->y);
+    int best_dir = -1;
+    
+    for (int k = 0; k < 4; k++) {
+        int d = (t->dir + k) % 4;
+        int nx = t->x + dir_dx[d];
+        int ny = t->y + dir_dy[d];
+        if (!cell_open(g, nx, ny)) {
+            continue; // Another tank in the way: take the next best step
+        }
+        unsigned v = field_min(g, ai, i, nx, ny);
+        if (v < best || (best == AI_FAR && best_dir < 0)) {
+            best = v;
+            best_dir = d;
+        }
+    }
+    return best_dir;
+}
+
+// Function to find the nearest tank in a straight line of sight, -1 if none (caller holds board_mutex)
+static int find_aim(GameState* g, Tank* t, int* gap) {
+    int aim = -1;
+    *gap = AI_SIGHT;
+    
+    for (int d = 0; d < 4; d++) {
+        int n = line_of_fire(g, t->x, t->y, (Direction)d, 1, AI_SIGHT);
+        int tx = t->x + dir_dx[d] * (n + 1);
+        int ty = t->y + dir_dy[d] * (n + 1);
+        if (n < *gap && tx >= 0 && tx < g->width && ty >= 0 && ty < g->height && TANK_AT(g, tx, ty)) {
+            aim = d;
+            *gap = n;
+        }
+    }
+    return aim;
+}
+
+// Function to find, for every tank, the nearest shot of another tank flying straight at it (caller holds board_mutex).
+// Each projectile in flight looks down its own lane once, a word at a time, so the pass costs one ray per shot.
+static void find_threats(GameState* g, Ai* ai) {
+    memset(ai->threat, -1, g->num_tanks * sizeof(int8_t));
+    int words = (g->projectile_hwm + 63) / 64;
+    
+    for (int w = 0; w < words; w++) {
+        for (uint64_t bits = g->active_slots[w]; bits; bits &= bits - 1) {
+            Projectile* p = &g->projectiles[w * 64 + __builtin_ctzll(bits)];
+            int n = line_of_fire(g, p->x, p->y, p->dir, 1, AI_SIGHT);
+            int tx = p->x + dir_dx[p->dir] * (n + 1);
+            int ty = p->y + dir_dy[p->dir] * (n + 1);
+            if (tx < 0 || tx >= g->width || ty < 0 || ty >= g->height || !TANK_AT(g, tx, ty)) {
+                continue;
+            }
+            int k = ENTITY_TANK(ENTITY(g, tx, ty));
+            if (k != p->owner && (ai->threat[k] < 0 || n < ai->threat_gap[k])) {
+                ai->threat[k] = (int8_t)p->dir;
+                ai->threat_gap[k] = (uint8_t)n;
+            }
+        }
+    }
+}
+
+// Function to pick a step out of the lane a shot is coming down, the one nearer a target first; -1 if boxed in
+static int dodge(GameState* g, Ai* ai, int i, int threat) {
+    Tank* t = &g->tanks[i];
+    int side = threat == UP || threat == DOWN ? LEFT : UP; // Either way across the lane
+    int best = -1;
+    unsigned best_v = 0;
+    
+    for (int d = side; d <= side + 1; d++) {
+        int nx = t->x + dir_dx[d];
+        int ny = t->y + dir_dy[d];
+        if (!cell_open(g, nx, ny)) {
+            continue;
+        }
+        unsigned v = field_min(g, ai, i, nx, ny);
+        if (best < 0 || v < best_v) {
+            best = d;
+            best_v = v;
+        }
+    }
+    return best;
+}
+
+// Function to decide what one tank does this tick, -1 for nothing (caller holds board_mutex): shoot what is in line,
+// step out of the way of a shot still far off, else step towards a target. Opposing shots cancel each other, so two
+// tanks trading shots down one lane would never finish a match: a tank never fires back at a shot coming at it, and
+// when its target could fire in the same tick it holds on a draw from the round's generator, so a seed plays the same.
+static int decide(GameState* g, Ai* ai, int i) {
+    Tank* t = &g->tanks[i];
+    int gap;
+    int move = -1;
+    int threat = ai->threat[i];
+    
+    int aim = find_aim(g, t, &gap);
+    int tx = aim >= 0 ? t->x + dir_dx[aim] * (gap + 1) : -1; // The tank in line
+    int ty = aim >= 0 ? t->y + dir_dy[aim] * (gap + 1) : -1;
+    if (aim >= 0 && gap > 0 && aim != (threat ^ 1)) {
+        Tank* target = &g->tanks[ENTITY_TANK(ENTITY(g, tx, ty))];
+        if (g->tick >= target->input.next_fire && (rng_next(&g->rng) & 1)) {
+            ai->holds++;
+            return -1;
+        }
+        t->dir = (Direction)aim; // Turn the turret without moving
+        return ACTION_FIRE;
+    }
+    if (threat >= 0 && ai->threat_gap[i] > AI_DODGE_GAP && (move = dodge(g, ai, i, threat)) >= 0) {
+        ai->dodges += g->tick >= t->input.next_move;
+        return move;
+    }
+    if (aim == (threat ^ 1)) {
+        ai->holds++; // Take the hit rather than cancel it
+        return -1;
+    }
+    if (aim >= 0) {
+        // Too close to shoot, the shot would spawn inside the other tank: back off. A tank that cannot back straight
+        // away waits if the other can, as stepping aside while the other backs off only brings them together again.
+        int back = aim ^ 1; // UP/DOWN and LEFT/RIGHT are pairs
+        if (!cell_open(g, t->x + dir_dx[back], t->y + dir_dy[back]) &&
+            cell_open(g, tx + dir_dx[aim], ty + dir_dy[aim])) {
+            return -1; // The other one can back away instead
+        }
+        for (int k = 0; k < 4 && move < 0; k++) {
+            int d = (back + k) % 4;
+            if (d != aim && cell_open(g, t->x + dir_dx[d], t->y + dir_dy[d])) {
+                move = d;
+            }
+        }
+        return move;
+    }
+    return steer(g, ai, i);
+}
+
+// Function to run the AI for one tick: advance the fields, then let every driven tank act.
+// The fields cost the same however many tanks read them; each tank only looks at its neighbours.
+void ai_tick(GameState* g) {
+    Ai* ai = g->ai;
+    long long t0 = perf_clock();
+    long long span = trace_begin();
+    
+    // A field whose wave has finished is repaired once its target has moved, or started over on a new target
+    for (int p = 0; p < NUM_PLAYERS; p++) {
+        AiField* f = &ai->fields[p];
+        if (f->head == f->tail) {
+            // Players may be moved by key presses from other threads
+            game_lock(g);
+            int target = field_target(g, p);
+            if (target != f->target) {
+                f->target = target;
+                f->src_x = f->src_y = -1; // A wave from the new target even if it stands where the old one fell
+            }
+            Tank* t = &g->tanks[f->target];
+            int alive = t->health > 0;
+            int x = t->x, y = t->y;
+            game_unlock(g);
+            if (!alive || (x == f->src_x && y == f->src_y)) {
+                continue;
+            }
+            start_wave(g, ai, f, x, y);
+        }
+        run_wave(g, ai, f, AI_WAVE_BUDGET);
+    }
+    long long t1 = perf_clock();
+    
+    // Every tank decides on the board as it stands before any of them acts, so none gains from coming later
+    game_lock(g);
+    find_threats(g, ai);
+    long long t2 = perf_clock();
+    for (int i = 0; i < g->num_tanks; i++) {
+        ai->plan[i] = g->tanks[i].health > 0 && ai_drives(g, i) ? (int8_t)decide(g, ai, i) : -1;
+    }
+    for (int i = 0; i < g->num_tanks && !g->game_over; i++) {
+        if (ai->plan[i] >= 0) {
+            tank_drive_locked(g, i, (Action)ai->plan[i]);
+        }
+    }
+    game_unlock(g);
+    long long t3 = perf_clock();
+    
+    ai->ticks++;
+    ai->field_ns += t1 - t0;
+    ai->threat_ns += t2 - t1;
+    ai->drive_ns += t3 - t2;
+    perf_sample(PERF_AI, t3 - t0);
+    trace_end("ai", span);
+}
+
+// Function to print what the AI cost
+void ai_print_stats(Ai* ai, FILE* out) {
+    if (ai->ticks == 0) {
+        return;
+    }
+    fprintf(out, "ai: %lu ticks, fields %.1f us/tick, shots %.1f us/tick, tanks %.1f us/tick, %lu waves "
+            "(%lu from scratch), %.0f cells per wave, %lu dodges, %lu ticks holding fire\n",
+            ai->ticks, ai->field_ns / 1000.0 / ai->ticks, ai->threat_ns / 1000.0 / ai->ticks,
+            ai->drive_ns / 1000.0 / ai->ticks, ai->waves, ai->rebuilds,
+            ai->waves ? (double)ai->wave_cells / ai->waves : 0.0, ai->dodges, ai->holds);
+}
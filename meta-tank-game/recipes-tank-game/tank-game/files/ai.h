@@ -0,0 +1,50 @@
+#ifndef TANK_AI_H
+#define TANK_AI_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "game.h"
+
+#define AI_FAR 0xFFFF // Distance of cells no wave has reached
+#define AI_BASE 0x80000000u // Field base after a reset; each move lowers it, far from wrapping around
+#define AI_WAVE_BUDGET 65536 // Cells one field's BFS wave may visit per tick
+#define AI_SIGHT 64 // How far along rows and columns AI tanks look for something to shoot
+#define AI_DODGE_GAP 2 // Shots further off than this are sidestepped; closer ones are taken, or duels would never end
+
+// Steps to one target tank from every cell, shared by every AI tank that hunts it.
+// Each cell holds base plus its steps. When the target moves, base drops by the steps between its old and new cell, so
+// every entry stays an upper bound, and a BFS wave from the new cell lowers only the cells the move brought closer.
+typedef struct {
+    int target; // Tank the field leads to: its player, then a live bot once that one is dead
+    uint32_t* dist; // height * width row-major, base + steps, UINT32_MAX where no wave has reached
+    uint32_t base; // What the target's cell holds
+    uint32_t* queue; // Cells of the current wave as y << 16 | x, each cell is queued at most once
+    uint32_t head, tail; // The wave is finished when they meet
+    int src_x, src_y; // Where the current wave started
+} AiField;
+
+// AI controller: one field per player, then every driven tank steers down the fields
+typedef struct Ai {
+    AiField fields[NUM_PLAYERS];
+    uint32_t players; // Bitmask of players the AI drives; bots are always driven
+    int8_t* threat; // Per tank, the direction of the nearest other tank's shot flying at it, -1 for none
+    uint8_t* threat_gap; // Per tank, free cells between it and that shot
+    int8_t* plan; // Per tank, the action decided this tick, -1 for none
+    unsigned long dodges; // Steps out of a shot's lane
+    unsigned long holds; // Ticks a tank in line held its fire so its shot would not meet one coming the other way
+    unsigned long ticks;
+    unsigned long waves; // Waves started
+    unsigned long rebuilds; // Waves that started over because the target changed or came from a cell out of reach
+    unsigned long long wave_cells; // Cells visited by all waves
+    unsigned long long field_ns, drive_ns, threat_ns;
+} Ai;
+
+int ai_init(Ai* ai, GameState* g, uint32_t players);
+void ai_free(Ai* ai, GameState* g);
+void ai_reset(GameState* g);
+void ai_tick(GameState* g);
+int ai_drives(GameState* g, int tank);
+void ai_print_stats(Ai* ai, FILE* out);
+
+#endif
@@ -0,0 +1,339 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "ansi.h"
+
+// Cells pack the color (plus one, 0 is the default color) above the character
+#define CELL(ch, color) (uint16_t)(((color) + 1) << 8 | (unsigned char)(ch))
+#define CELL_CHAR(c) (char)((c) & 0xFF)
+#define CELL_COLOR(c) ((int)((c) >> 8) - 1)
+#define BLANK CELL(' ', ANSI_DEFAULT_COLOR)
+#define PEN_UNKNOWN -2
+
+// Function to set up the writer for a terminal of the given size; the screen is taken to be blank
+int ansi_init(AnsiWriter* w, int fd, long budget, int lines, int columns) {
+    ansi_free(w);
+    w->fd = fd;
+    w->budget = budget > 0 ? budget : 0;
+    w->rows = lines;
+    w->cols = columns;
+    w->shown = malloc((size_t)w->rows * w->cols * sizeof(uint16_t));
+    w->next = malloc((size_t)w->rows * w->cols * sizeof(uint16_t));
+    w->out_cap = 4096;
+    w->out = malloc(w->out_cap);
+    if (!w->shown || !w->next || !w->out) {
+        ansi_free(w);
+        return -1;
+    }
+    ansi_blank(w);
+    return 0;
+}
+
+// Function to release the screen copies and the frame buffer
+void ansi_free(AnsiWriter* w) {
+    free(w->shown);
+    free(w->next);
+    free(w->out);
+    w->shown = w->next = NULL;
+    w->out = NULL;
+    w->out_len = w->out_cap = 0;
+}
+
+// Function to record that the terminal was just cleared; the next frame starts from a blank screen
+void ansi_blank(AnsiWriter* w) {
+    for (size_t i = 0; i < (size_t)w->rows * w->cols; i++) {
+        w->shown[i] = BLANK;
+        w->next[i] = BLANK;
+    }
+    w->cur_y = w->cur_x = -1;
+    w->pen = PEN_UNKNOWN;
+    w->resume_row = 0;
+}
+
+// Function to set one cell of the next frame
+void ansi_put(AnsiWriter* w, int y, int x, char ch, int color) {
+    if (y >= 0 && y < w->rows && x >= 0 && x < w->cols) {
+        w->next[(size_t)y * w->cols + x] = CELL(ch, color);
+    }
+}
+
+// Function to set a run of cells of the next frame, clipped at the right edge
+void ansi_puts(AnsiWriter* w, int y, int x, const char* s, int color) {
+    for (; *s; s++, x++) {
+        ansi_put(w, y, x, *s, color);
+    }
+}
+
+// Function to make room for n more bytes in the frame buffer
+static int reserve(AnsiWriter* w, size_t n) {
+    if (w->out_len + n <= w->out_cap) {
+        return 0;
+    }
+    size_t cap = w->out_cap * 2;
+    while (cap < w->out_len + n) {
+        cap *= 2;
+    }
+    char* grown = realloc(w->out, cap);
+    if (!grown) {
+        return -1;
+    }
+    w->out = grown;
+    w->out_cap = cap;
+    return 0;
+}
+
+// Function to append bytes to the frame
+static void emit(AnsiWriter* w, const char* s, size_t n) {
+    if (reserve(w, n) == 0) {
+        memcpy(w->out + w->out_len, s, n);
+        w->out_len += n;
+    }
+}
+
+// Function to append a control sequence with up to two numeric parameters (-1 leaves one out)
+static void emit_csi(AnsiWriter* w, int a, int b, char final) {
+    char seq[32];
+    int n;
+    
+    if (b >= 0) {
+        n = snprintf(seq, sizeof(seq), "\033[%d;%d%c", a, b, final);
+    } else if (a > 1) {
+        n = snprintf(seq, sizeof(seq), "\033[%d%c", a, final);
+    } else {
+        n = snprintf(seq, sizeof(seq), "\033[%c", final); // 1 is the default count
+    }
+    emit(w, seq, n);
+}
+
+// Function to count the decimal digits of a sequence parameter
+static int digits(int n) {
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+// Function to tell whether the cells before x on a row can be written again as they are with the current pen
+static int can_reprint(AnsiWriter* w, int y, int from, int x) {
+    if (x - from > ANSI_REPRINT_MAX) {
+        return 0;
+    }
+    for (int i = from; i < x; i++) {
+        uint16_t c = w->shown[(size_t)y * w->cols + i];
+        if (c != w->next[(size_t)y * w->cols + i] || (CELL_CHAR(c) != ' ' && CELL_COLOR(c) != w->pen)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Function to price moving right along a row from one column to another, in bytes
+static int forward_cost(AnsiWriter* w, int y, int from, int x, int* reprint) {
+    int gap = x - from;
+    int jump = gap == 1 ? 3 : 3 + digits(gap);
+    
+    *reprint = gap > 0 && gap <= jump && can_reprint(w, y, from, x);
+    return gap == 0 ? 0 : *reprint ? gap : jump;
+}
+
+// Function to move right along the current row, rewriting the gap when that is shorter than a jump
+static void move_forward(AnsiWriter* w, int y, int x, int reprint) {
+    if (reprint) {
+        for (int i = w->cur_x; i < x; i++) {
+            char ch = CELL_CHAR(w->shown[(size_t)y * w->cols + i]);
+            emit(w, &ch, 1);
+        }
+    } else if (x > w->cur_x) {
+        emit_csi(w, x - w->cur_x, -1, 'C');
+    }
+    w->cur_x = x;
+}
+
+// Function to move the cursor to a cell with the shortest sequence on offer
+static void move_to(AnsiWriter* w, int y, int x) {
+    if (y == w->cur_y && x == w->cur_x) {
+        return;
+    }
+    
+    // Absolute position, always possible
+    int best = x == 0 ? 3 + digits(y + 1) : 4 + digits(y + 1) + digits(x + 1);
+    int how = 0;
+    int reprint = 0;
+    int r;
+    
+    if (w->cur_y >= 0 && w->cur_x >= 0) {
+        int down = y - w->cur_y;
+        int vertical = down == 0 ? 0 : (down == 1 || down == -1) ? 3 : 3 + digits(down < 0 ? -down : down);
+        
+        // Up or down, then right along the row
+        if (x >= w->cur_x) {
+            int cost = vertical + forward_cost(w, y, w->cur_x, x, &r);
+            if (cost < best) {
+                best = cost;
+                how = 1;
+                reprint = r;
+            }
+        }
+        // Carriage return (and line feed to the next row), then right from the first column
+        if (down == 0 || down == 1) {
+            int cost = 1 + down + forward_cost(w, y, 0, x, &r);
+            if (cost < best) {
+                best = cost;
+                how = 2;
+                reprint = r;
+            }
+        }
+    }
+    
+    w->stats.moves++;
+    if (how == 1) {
+        if (y != w->cur_y) {
+            int down = y - w->cur_y;
+            emit_csi(w, down < 0 ? -down : down, -1, down < 0 ? 'A' : 'B');
+            w->cur_y = y;
+        }
+        move_forward(w, y, x, reprint);
+    } else if (how == 2) {
+        emit(w, y == w->cur_y ? "\r" : "\r\n", y == w->cur_y ? 1 : 2);
+        w->cur_y = y;
+        w->cur_x = 0;
+        move_forward(w, y, x, reprint);
+    } else {
+        if (x == 0) {
+            emit_csi(w, y + 1, -1, 'H');
+        } else {
+            emit_csi(w, y + 1, x + 1, 'H');
+        }
+        w->cur_y = y;
+        w->cur_x = x;
+    }
+}
+
+// Function to select a foreground color
+static void set_pen(AnsiWriter* w, int color) {
+    if (color == w->pen) {
+        return;
+    }
+    if (color == ANSI_DEFAULT_COLOR) {
+        emit(w, "\033[m", 3);
+    } else {
+        emit_csi(w, 30 + color, -1, 'm');
+    }
+    w->pen = color;
+    w->stats.colors++;
+}
+
+// Function to write one cell at the cursor
+static void write_cell(AnsiWriter* w, int y, int x) {
+    size_t i = (size_t)y * w->cols + x;
+    uint16_t c = w->next[i];
+    
+    move_to(w, y, x);
+    if (CELL_CHAR(c) != ' ') {
+        set_pen(w, CELL_COLOR(c)); // A blank looks the same in any foreground color
+    }
+    char ch = CELL_CHAR(c);
+    emit(w, &ch, 1);
+    w->shown[i] = c;
+    w->stats.cells++;
+    
+    // After the last column the cursor waits to wrap, so its position is not to be trusted
+    w->cur_x = x + 1 < w->cols ? x + 1 : -1;
+    if (w->cur_x < 0) {
+        w->cur_y = -1;
+    }
+}
+
+// Function to tell whether the link still has more than a frame's budget of earlier output to send
+static int link_busy(AnsiWriter* w) {
+    int queued;
+    return w->budget && ioctl(w->fd, TIOCOUTQ, &queued) == 0 && queued > w->budget;
+}
+
+// Function to send the cells that changed since the last frame with one write().
+// Rows are sent in order until the budget runs out; the rest go first in the next frame.
+long ansi_flush(AnsiWriter* w) {
+    if (!w->shown) {
+        return 0;
+    }
+    if (link_busy(w)) {
+        w->stats.skipped++;
+        return 0;
+    }
+    
+    w->out_len = 0;
+    int cut = 0;
+    int start = w->resume_row < w->rows ? w->resume_row : 0;
+    
+    for (int r = 0; r < w->rows && !cut; r++) {
+        int y = (start + r) % w->rows;
+        for (int x = 0; x < w->cols; x++) {
+            size_t i = (size_t)y * w->cols + x;
+            if (w->next[i] == w->shown[i]) {
+                continue;
+            }
+            if (y == w->rows - 1 && x == w->cols - 1) {
+                w->shown[i] = w->next[i]; // Writing the bottom-right cell would scroll the screen
+                continue;
+            }
+            if (w->budget && w->out_len >= (size_t)w->budget) {
+                w->resume_row = y;
+                cut = 1;
+                break;
+            }
+            write_cell(w, y, x);
+        }
+    }
+    if (!cut) {
+        w->resume_row = 0;
+    }
+    if (w->out_len == 0) {
+        return 0;
+    }
+    set_pen(w, ANSI_DEFAULT_COLOR); // ncurses draws the menus expecting plain text
+    
+    size_t done = 0;
+    while (done < w->out_len) {
+        ssize_t n = write(w->fd, w->out + done, w->out_len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    
+    w->stats.frames++;
+    w->stats.partial += cut;
+    w->stats.bytes_total += w->out_len;
+    if (w->out_len > w->stats.bytes_max) {
+        w->stats.bytes_max = w->out_len;
+    }
+    return (long)w->out_len;
+}
+
+// Function to read the writer's statistics
+const AnsiStats* ansi_stats(AnsiWriter* w) {
+    return &w->stats;
+}
+
+// Function to print what the writer sent
+void ansi_print_stats(AnsiWriter* w, FILE* out_file) {
+    if (w->stats.frames == 0) {
+        return;
+    }
+    fprintf(out_file, "ansi: %lu frames, %.1f bytes/frame (max %lu), %.1f cells, %.1f moves, %.1f color changes per frame",
+            w->stats.frames, (double)w->stats.bytes_total / w->stats.frames, w->stats.bytes_max,
+            (double)w->stats.cells / w->stats.frames, (double)w->stats.moves / w->stats.frames,
+            (double)w->stats.colors / w->stats.frames);
+    if (w->budget) {
+        fprintf(out_file, ", budget %ld: %lu cut short, %lu held back", w->budget, w->stats.partial, w->stats.skipped);
+    }
+    fprintf(out_file, "\n");
+}
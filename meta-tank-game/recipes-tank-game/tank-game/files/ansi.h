@@ -0,0 +1,48 @@
+#ifndef TANK_ANSI_H
+#define TANK_ANSI_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define ANSI_DEFAULT_COLOR -1 // The terminal's own foreground color
+#define ANSI_REPRINT_MAX 8 // Longest gap of unchanged cells rewritten instead of jumped over
+
+// Output statistics of the direct writer
+typedef struct {
+    unsigned long frames; // Frames written
+    unsigned long partial; // Frames cut short by the byte budget
+    unsigned long skipped; // Frames held back while the link was still busy
+    unsigned long long bytes_total;
+    unsigned long bytes_max;
+    unsigned long long cells; // Cells written
+    unsigned long long moves; // Cursor movement sequences
+    unsigned long long colors; // Color changes
+} AnsiStats;
+
+// Direct writer for one terminal: next is the screen the renderer wants, shown is what the terminal has
+typedef struct {
+    int fd;
+    long budget; // Bytes per frame, 0 for no limit
+    int rows, cols;
+    uint16_t* shown;
+    uint16_t* next;
+    int cur_y, cur_x; // Cursor position, -1 when unknown
+    int pen; // Foreground color last selected
+    int resume_row; // Where a frame cut short by the budget carries on
+    AnsiStats stats;
+    
+    // Frame being built, flushed with one write()
+    char* out;
+    size_t out_len, out_cap;
+} AnsiWriter;
+
+int ansi_init(AnsiWriter* w, int fd, long budget, int lines, int cols);
+void ansi_free(AnsiWriter* w);
+void ansi_blank(AnsiWriter* w);
+void ansi_put(AnsiWriter* w, int y, int x, char ch, int color);
+void ansi_puts(AnsiWriter* w, int y, int x, const char* s, int color);
+long ansi_flush(AnsiWriter* w);
+const AnsiStats* ansi_stats(AnsiWriter* w);
+void ansi_print_stats(AnsiWriter* w, FILE* out);
+
+#endif
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "ai.h"
+
+// Bench defaults
+#define DEFAULT_BOARDS "60x20,256x256,1024x1024"
+#define DEFAULT_PROJECTILES "0,100,1000,10000"
+#define DEFAULT_TICKS 20000
+#define MAX_SCRIPT 65536
+
+// One benchmark run's settings
+typedef struct {
+    int width, height;
+    int projectiles; // Projectiles kept in flight
+    int tanks;
+    int ticks;
+    unsigned int seed;
+    const char* script; // Keys fed one per tick, NULL for random input
+    size_t script_len;
+    int ai; // Bots are driven by the AI instead of random input
+} BenchConfig;
+
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to compare tick latencies for qsort
+static int cmp_ll(const void* a, const void* b) {
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+// Function to feed one tick of input, either a scripted key or a random action for every tank
+static void feed_input(GameState* g, const BenchConfig* cfg) {
+    if (cfg->script) {
+        handle_input(g, cfg->script[g->tick % cfg->script_len]);
+        return;
+    }
+    
+    for (int i = 0; i < g->num_tanks; i++) {
+        if (ai_drives(g, i)) {
+            continue;
+        }
+        tank_action(g, i, (Action)(rand() % NUM_ACTIONS));
+    }
+}
+
+// Function to fire from the tanks until the requested number of projectiles is in flight
+static void top_up_projectiles(GameState* g, int target) {
+    int failures = 0;
+    
+    while (g->num_projectiles < target && failures < 4 * g->num_tanks) {
+        Tank* tank = &g->tanks[rand() % g->num_tanks];
+        tank->dir = (Direction)(rand() % 4);
+        if (fire_projectile(g, tank) == PROJECTILE_NONE) {
+            failures++; // Blocked in that direction or pool exhausted
+        }
+    }
+}
+
+// Function to put a fresh round on the board with tanks that cannot die
+static void start_round(GameState* g, unsigned int seed) {
+    reset_game(g, seed);
+    for (int i = 0; i < g->num_tanks; i++) {
+        g->tanks[i].health = INT_MAX / 2;
+    }
+}
+
+// Function to run one configuration and print its results
+static int run_bench(const BenchConfig* cfg) {
+    GameState g;
+    int pool = cfg->projectiles + 64; // Headroom for shots fired by the input stream
+    if (pool > PROJECTILE_POOL_LIMIT - 1) {
+        pool = PROJECTILE_POOL_LIMIT - 1;
+    }
+    
+    if (game_init(&g, cfg->width, cfg->height, pool, cfg->tanks) < 0) {
+        fprintf(stderr, "tank-bench: cannot allocate %dx%d board\n", cfg->width, cfg->height);
+        return -1;
+    }
+    
+    long long* samples = malloc(cfg->ticks * sizeof(long long));
+    if (!samples) {
+        game_free(&g);
+        return -1;
+    }
+    
+    Ai ai;
+    if (cfg->ai && ai_init(&ai, &g, 0) < 0) {
+        free(samples);
+        game_free(&g);
+        return -1;
+    }
+    
+    setup_tanks(&g, 'A', 'B');
+    start_round(&g, cfg->seed);
+    srand(cfg->seed); // Input stream is reproducible for a given seed
+    
+    unsigned long steps = 0;
+    unsigned long long in_flight = 0;
+    long long start = now_ns();
+    
+    for (int i = 0; i < cfg->ticks; i++) {
+        long long t0 = now_ns();
+        
+        feed_input(&g, cfg);
+        top_up_projectiles(&g, cfg->projectiles);
+        simulation_tick(&g);
+        
+        samples[i] = now_ns() - t0;
+        in_flight += g.num_projectiles;
+        
+        if (g.game_over) {
+            steps += g.projectile_steps;
+            start_round(&g, cfg->seed + i);
+        }
+    }
+    
+    long long elapsed = now_ns() - start;
+    steps += g.projectile_steps;
+    
+    qsort(samples, cfg->ticks, sizeof(long long), cmp_ll);
+    double secs = elapsed / 1e9;
+    
+    printf("board %5dx%-5d tanks %4d projectiles %6d: %10.0f ticks/s %12.0f proj-updates/s  p50 %8.2f us  p99 %8.2f us  in-flight %8.1f\n",
+           cfg->width, cfg->height, cfg->tanks, cfg->projectiles,
+           cfg->ticks / secs,
+           steps / secs,
+           samples[cfg->ticks / 2] / 1000.0,
+           samples[(int)(cfg->ticks * 0.99)] / 1000.0,
+           (double)in_flight / cfg->ticks);
+    if (cfg->ai) {
+        ai_print_stats(&ai, stdout);
+        ai_free(&ai, &g);
+    }
+    
+    free(samples);
+    game_free(&g);
+    return 0;
+}
+
+// Function to load a key script from a file
+static char* load_script(const char* path, size_t* len) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    
+    char* buf = malloc(MAX_SCRIPT);
+    *len = buf ? fread(buf, 1, MAX_SCRIPT, f) : 0;
+    fclose(f);
+    
+    if (*len == 0) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+// Function to print command line help
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-b WxH[,WxH...]] [-p N[,N...]] [-n tanks] [-t ticks] [-s seed] [-i script] [-a] [-P] [-T trace.json]\n"
+            "  -b  board sizes to sweep (default " DEFAULT_BOARDS ")\n"
+            "  -p  projectiles kept in flight (default " DEFAULT_PROJECTILES ")\n"
+            "  -n  tanks on the board, players plus bots (default %d)\n"
+            "  -t  ticks per run (default %d)\n"
+            "  -s  seed for the board and random input (default 1)\n"
+            "  -i  file of keys fed one per tick instead of random input\n"
+            "  -a  let the AI drive the bots (tanks after the two players)\n"
+            "  -P  enable the performance counters and print them at the end\n"
+            "  -T  write a Chrome trace of the last ticks of every run\n",
+            prog, NUM_PLAYERS, DEFAULT_TICKS);
+}
+
+int main(int argc, char* argv[]) {
+    const char* boards = DEFAULT_BOARDS;
+    const char* counts = DEFAULT_PROJECTILES;
+    BenchConfig cfg = { .tanks = NUM_PLAYERS, .ticks = DEFAULT_TICKS, .seed = 1 };
+    const char* trace_path = NULL;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "b:p:n:t:s:i:aPT:")) != -1) {
+        switch (opt) {
+            case 'b':
+                boards = optarg;
+                break;
+            case 'p':
+                counts = optarg;
+                break;
+            case 'n':
+                cfg.tanks = atoi(optarg);
+                break;
+            case 't':
+                cfg.ticks = atoi(optarg);
+                break;
+            case 's':
+                cfg.seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'i':
+                cfg.script = load_script(optarg, &cfg.script_len);
+                if (!cfg.script) {
+                    fprintf(stderr, "tank-bench: cannot read script %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'a':
+                cfg.ai = 1;
+                break;
+            case 'P':
+                perf_enabled = 1;
+                break;
+            case 'T':
+                trace_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    if (cfg.ticks <= 0 || cfg.tanks < NUM_PLAYERS || cfg.tanks > MAX_TANKS) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (trace_path && trace_init(TRACE_DEFAULT_EVENTS) < 0) {
+        fprintf(stderr, "tank-bench: out of memory\n");
+        return 1;
+    }
+    
+    // Sweep every board size against every projectile count
+    for (const char* b = boards; *b; ) {
+        if (sscanf(b, "%dx%d", &cfg.width, &cfg.height) != 2) {
+            usage(argv[0]);
+            return 1;
+        }
+        for (const char* p = counts; *p; ) {
+            cfg.projectiles = atoi(p);
+            if (run_bench(&cfg) < 0) {
+                return 1;
+            }
+            p += strcspn(p, ",");
+            p += (*p == ',');
+        }
+        b += strcspn(b, ",");
+        b += (*b == ',');
+    }
+    
+    free((char*)cfg.script);
+    if (perf_enabled) {
+        perf_dump(stdout);
+    }
+    if (trace_path) {
+        trace_thread_exit();
+        if (trace_write(trace_path) < 0) {
+            fprintf(stderr, "tank-bench: cannot write %s\n", trace_path);
+            return 1;
+        }
+    }
+    return 0;
+}
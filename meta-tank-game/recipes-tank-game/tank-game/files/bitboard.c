@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitboard.h"
+
+// Two words at once where the target has 128-bit vectors (SSE2 on x86, NEON on the Pi)
+#if defined(__SSE2__) || defined(__ARM_NEON)
+#define BIT_RAY_VECTOR 1
+typedef uint64_t u64x2 __attribute__((vector_size(16)));
+#endif
+
+// Function to allocate a cleared layer
+int bit_layer_alloc(BitLayer* l, int width, int height) {
+    l->width = width;
+    l->height = height;
+    l->stride = BIT_WORDS(width);
+    l->bits = calloc((size_t)l->stride * height, sizeof(uint64_t));
+    return l->bits ? 0 : -1;
+}
+
+// Function to release a layer allocated by bit_layer_alloc()
+void bit_layer_free(BitLayer* l) {
+    free(l->bits);
+    l->bits = NULL;
+}
+
+// Function to wrap existing words (a mapped map file) as a layer
+void bit_layer_attach(BitLayer* l, int width, int height, uint64_t* bits) {
+    l->width = width;
+    l->height = height;
+    l->stride = BIT_WORDS(width);
+    l->bits = bits;
+}
+
+// Function to read word w of a row from one layer, or the union of two
+static inline uint64_t obstacle_word(const uint64_t* ra, const uint64_t* rb, int w) {
+    return rb ? ra[w] | rb[w] : ra[w];
+}
+
+// Function to find the first set bit at or after start, or -1
+static int scan_forward(const uint64_t* ra, const uint64_t* rb, int nwords, int start) {
+    int w = start >> 6;
+    uint64_t word = obstacle_word(ra, rb, w) & (~0ULL << (start & 63));
+    
+    while (!word) {
+        w++;
+#ifdef BIT_RAY_VECTOR
+        // Skip empty stretches 128 cells at a time
+        while (w + 2 <= nwords) {
+            u64x2 va, vb = { 0, 0 };
+            memcpy(&va, ra + w, sizeof(va));
+            if (rb) {
+                memcpy(&vb, rb + w, sizeof(vb));
+            }
+            u64x2 v = va | vb;
+            if (v[0] | v[1]) {
+                break;
+            }
+            w += 2;
+        }
+#endif
+        if (w >= nwords) {
+            return -1;
+        }
+        word = obstacle_word(ra, rb, w);
+    }
+    return (w << 6) + __builtin_ctzll(word);
+}
+
+// Function to find the last set bit at or before start, or -1
+static int scan_backward(const uint64_t* ra, const uint64_t* rb, int start) {
+    int w = start >> 6;
+    int shift = 63 - (start & 63);
+    uint64_t word = (obstacle_word(ra, rb, w) << shift) >> shift;
+    
+    while (!word) {
+        w--;
+#ifdef BIT_RAY_VECTOR
+        while (w - 1 >= 0) {
+            u64x2 va, vb = { 0, 0 };
+            memcpy(&va, ra + w - 1, sizeof(va));
+            if (rb) {
+                memcpy(&vb, rb + w - 1, sizeof(vb));
+            }
+            u64x2 v = va | vb;
+            if (v[0] | v[1]) {
+                break;
+            }
+            w -= 2;
+        }
+#endif
+        if (w < 0) {
+            return -1;
+        }
+        word = obstacle_word(ra, rb, w);
+    }
+    return (w << 6) + 63 - __builtin_clzll(word);
+}
+
+// Function to count the clear cells after start along a row of a (or of a | b), up to limit.
+// Rays along the board's rows use the row layers; vertical rays use the column layers.
+int bit_ray(const BitLayer* a, const BitLayer* b, int row, int start, int forward, int limit) {
+    const uint64_t* ra = a->bits + (size_t)row * a->stride;
+    const uint64_t* rb = b ? b->bits + (size_t)row * b->stride : NULL;
+    int free_cells;
+    
+    if (forward) {
+        if (start + 1 >= a->width) {
+            return 0;
+        }
+        int hit = scan_forward(ra, rb, a->stride, start + 1);
+        free_cells = (hit < 0 || hit >= a->width ? a->width : hit) - start - 1;
+    } else {
+        if (start <= 0) {
+            return 0;
+        }
+        int hit = scan_backward(ra, rb, start - 1);
+        free_cells = start - 1 - hit; // hit is -1 when the ray reaches the edge
+    }
+    return free_cells < limit ? free_cells : limit;
+}
@@ -0,0 +1,43 @@
+#ifndef TANK_BITBOARD_H
+#define TANK_BITBOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Words needed for n bits
+#define BIT_WORDS(n) (((size_t)(n) + 63) / 64)
+
+// One bit per cell, rows padded to whole 64-bit words so a row can be scanned word by word.
+// A layer kept "by column" is the transpose: its rows are the board's columns.
+typedef struct {
+    int width, height; // Bits per row, number of rows
+    int stride; // 64-bit words per row
+    uint64_t* bits;
+} BitLayer;
+
+int bit_layer_alloc(BitLayer* l, int width, int height);
+void bit_layer_free(BitLayer* l);
+void bit_layer_attach(BitLayer* l, int width, int height, uint64_t* bits);
+int bit_ray(const BitLayer* a, const BitLayer* b, int row, int start, int forward, int limit);
+
+// Function to test the bit at (x, y)
+static inline int bit_test(const BitLayer* l, int x, int y) {
+    return (l->bits[(size_t)y * l->stride + (x >> 6)] >> (x & 63)) & 1;
+}
+
+// Function to set the bit at (x, y)
+static inline void bit_set(BitLayer* l, int x, int y) {
+    l->bits[(size_t)y * l->stride + (x >> 6)] |= 1ULL << (x & 63);
+}
+
+// Function to clear the bit at (x, y)
+static inline void bit_clear(BitLayer* l, int x, int y) {
+    l->bits[(size_t)y * l->stride + (x >> 6)] &= ~(1ULL << (x & 63));
+}
+
+// Function to flip the bit at (x, y)
+static inline void bit_flip(BitLayer* l, int x, int y) {
+    l->bits[(size_t)y * l->stride + (x >> 6)] ^= 1ULL << (x & 63);
+}
+
+#endif
@@ -0,0 +1,392 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include "bot.h"
+
+_Static_assert(TANK_BOT_UP == (int)UP && TANK_BOT_RIGHT == (int)RIGHT, "bot actions start with the directions");
+_Static_assert(sizeof(Direction) == sizeof(int32_t) && sizeof(int) == sizeof(int32_t), "view fields are int32");
+_Static_assert(sizeof(EntityId) == sizeof(uint16_t), "entity ids are uint16");
+_Static_assert(TANK_BOT_UP == (int)ACTION_UP && TANK_BOT_RIGHT == (int)ACTION_RIGHT && TANK_BOT_FIRE == (int)ACTION_FIRE,
+               "bot actions are game actions");
+
+#define BOT_JOIN_NS 1000000000LL // How long closing waits for a plugin still inside act()
+
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to turn a monotonic time in nanoseconds into a timespec
+static struct timespec to_timespec(long long ns) {
+    struct timespec ts = { .tv_sec = ns / 1000000000LL, .tv_nsec = ns % 1000000000LL };
+    return ts;
+}
+
+// Function to set up the host; plugins are added with bot_load()
+int bot_host_init(BotHost* h, GameState* g, long budget_usec) {
+    memset(h, 0, sizeof(BotHost));
+    h->budget_ns = (budget_usec > 0 ? budget_usec : BOT_BUDGET_USEC) * 1000LL;
+    h->driven = calloc(g->num_tanks, sizeof(uint8_t));
+    if (!h->driven) {
+        return -1;
+    }
+    
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC); // The budget is a monotonic deadline
+    pthread_mutex_init(&h->lock, NULL);
+    pthread_cond_init(&h->work, NULL);
+    pthread_cond_init(&h->answered, &attr);
+    pthread_condattr_destroy(&attr);
+    
+    g->bot_driven = h->driven;
+    return 0;
+}
+
+// Function to point a plugin's view at the live game; only the counters change after this
+static void init_view(TankBotView* v, GameState* g) {
+    memset(v, 0, sizeof(TankBotView));
+    v->abi_version = TANK_BOT_ABI_VERSION;
+    v->size = sizeof(TankBotView);
+    v->width = g->width;
+    v->height = g->height;
+    v->num_tanks = g->num_tanks;
+    
+    v->stride = g->walls.stride;
+    v->walls = g->walls.bits;
+    v->tanks_at = g->tank_bits.bits;
+    v->shots_at = g->shot_bits.bits;
+    v->entity = g->entity;
+    
+    v->tanks = g->tanks;
+    v->tank_size = sizeof(Tank);
+    v->tank_x = offsetof(Tank, x);
+    v->tank_y = offsetof(Tank, y);
+    v->tank_health = offsetof(Tank, health);
+    v->tank_dir = offsetof(Tank, dir);
+    
+    v->projectiles = g->projectiles;
+    v->projectile_size = sizeof(Projectile);
+    v->projectile_x = offsetof(Projectile, x);
+    v->projectile_y = offsetof(Projectile, y);
+    v->projectile_dir = offsetof(Projectile, dir);
+    v->projectile_active = offsetof(Projectile, active);
+    v->projectile_owner = offsetof(Projectile, owner);
+    v->projectile_vx = offsetof(Projectile, vx);
+    v->projectile_vy = offsetof(Projectile, vy);
+}
+
+// Function to read a tank list like "2,4-7" into the plugin, every bot tank nobody drives yet when it is NULL
+static int claim_tanks(BotHost* h, GameState* g, BotPlugin* p, const char* list) {
+    p->tanks = malloc(g->num_tanks * sizeof(int));
+    if (!p->tanks) {
+        return -1;
+    }
+    
+    if (!list) {
+        for (int i = NUM_PLAYERS; i < g->num_tanks; i++) {
+            if (!h->driven[i]) {
+                p->tanks[p->num_tanks++] = i;
+                h->driven[i] = 1;
+            }
+        }
+        return 0;
+    }
+    
+    const char* s = list;
+    while (*s) {
+        char* end;
+        long first = strtol(s, &end, 10);
+        long last = first;
+        if (end == s) {
+            return -1;
+        }
+        if (*end == '-') {
+            s = end + 1;
+            last = strtol(s, &end, 10);
+            if (end == s) {
+                return -1;
+            }
+        }
+        if (first < 0 || last >= g->num_tanks || first > last) {
+            return -1;
+        }
+        for (long i = first; i <= last; i++) {
+            if (h->driven[i]) {
+                return -1; // Another plugin drives it already
+            }
+            p->tanks[p->num_tanks++] = (int)i;
+            h->driven[i] = 1;
+        }
+        s = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function run by each plugin's thread: answer every posted tick by asking the bot of each of its tanks
+static void* plugin_main(void* arg) {
+    BotPlugin* p = arg;
+    BotHost* h = p->host;
+    
+    pthread_mutex_lock(&h->lock);
+    for (;;) {
+        while (!h->stop && p->done == p->posted) {
+            pthread_cond_wait(&h->work, &h->lock);
+        }
+        if (h->stop) {
+            break;
+        }
+        unsigned long tick = p->posted;
+        pthread_mutex_unlock(&h->lock);
+        
+        long long t0 = now_ns();
+        for (int k = 0; k < p->num_tanks; k++) {
+            int tank = p->tanks[k];
+            if (TANK_BOT_TANK(&p->view, tank, health) <= 0) {
+                p->actions[k] = TANK_BOT_IDLE;
+                continue;
+            }
+            p->view.self = tank;
+            p->actions[k] = p->api->act(p->state[k], &p->view);
+            p->calls++;
+        }
+        unsigned long long ns = now_ns() - t0;
+        p->call_ns += ns;
+        if (ns > p->call_ns_max) {
+            p->call_ns_max = ns;
+        }
+        
+        pthread_mutex_lock(&h->lock);
+        p->done = tick;
+        pthread_cond_broadcast(&h->answered);
+    }
+    pthread_mutex_unlock(&h->lock);
+    return NULL;
+}
+
+// Function to load a plugin from "path[:tanks]" and start its thread
+int bot_load(BotHost* h, GameState* g, const char* spec) {
+    if (h->num_plugins == BOT_MAX_PLUGINS) {
+        fprintf(stderr, "bot: at most %d plugins\n", BOT_MAX_PLUGINS);
+        return -1;
+    }
+    BotPlugin* p = &h->plugins[h->num_plugins];
+    memset(p, 0, sizeof(BotPlugin));
+    p->host = h;
+    p->path = strdup(spec);
+    if (!p->path) {
+        return -1;
+    }
+    
+    // A tank list after the last ':' (paths with a ':' of their own still load with a list given)
+    char* list = strrchr(p->path, ':');
+    if (list && strspn(list + 1, "0123456789,-") == strlen(list + 1)) {
+        *list++ = '\0';
+    } else {
+        list = NULL;
+    }
+    
+    p->handle = dlopen(p->path, RTLD_NOW | RTLD_LOCAL);
+    if (!p->handle) {
+        fprintf(stderr, "bot: %s\n", dlerror());
+        goto fail;
+    }
+    TankBotEntry entry = (TankBotEntry)dlsym(p->handle, TANK_BOT_ENTRY);
+    p->api = entry ? entry() : NULL;
+    if (!p->api || !p->api->act) {
+        fprintf(stderr, "bot: %s has no %s()\n", p->path, TANK_BOT_ENTRY);
+        goto fail;
+    }
+    if (p->api->abi_version != TANK_BOT_ABI_VERSION) {
+        fprintf(stderr, "bot: %s is built for ABI %u, the game has %d\n", p->path, p->api->abi_version, TANK_BOT_ABI_VERSION);
+        goto fail;
+    }
+    if (claim_tanks(h, g, p, list) < 0 || p->num_tanks == 0) {
+        fprintf(stderr, "bot: %s: no tanks to drive in '%s' (0 to %d, each by one plugin)\n",
+                p->path, list ? list : "bots", g->num_tanks - 1);
+        goto fail;
+    }
+    
+    p->state = calloc(p->num_tanks, sizeof(void*));
+    p->actions = malloc(p->num_tanks * sizeof(int));
+    if (!p->state || !p->actions) {
+        goto fail;
+    }
+    init_view(&p->view, g);
+    for (int k = 0; k < p->num_tanks; k++) {
+        p->actions[k] = TANK_BOT_IDLE;
+        if (p->api->create) {
+            p->view.self = p->tanks[k];
+            p->state[k] = p->api->create(&p->view, p->tanks[k]);
+        }
+    }
+    
+    if (pthread_create(&p->thread, NULL, plugin_main, p) != 0) {
+        goto fail;
+    }
+    p->running = 1;
+    h->num_plugins++;
+    return 0;
+    
+fail:
+    for (int k = 0; k < p->num_tanks; k++) {
+        h->driven[p->tanks[k]] = 0;
+        if (p->state && p->api->destroy) {
+            p->api->destroy(p->state[k]);
+        }
+    }
+    if (p->handle) {
+        dlclose(p->handle);
+    }
+    free(p->tanks);
+    free(p->state);
+    free(p->actions);
+    free(p->path);
+    return -1;
+}
+
+// Function to stop every plugin thread and unload the plugins.
+// A plugin still inside act() after BOT_JOIN_NS is left loaded, its code may still be running.
+void bot_host_free(BotHost* h, GameState* g) {
+    pthread_mutex_lock(&h->lock);
+    h->stop = 1;
+    pthread_cond_broadcast(&h->work);
+    pthread_mutex_unlock(&h->lock);
+    
+    for (int i = 0; i < h->num_plugins; i++) {
+        BotPlugin* p = &h->plugins[i];
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until); // pthread_timedjoin_np() waits on the realtime clock
+        until = to_timespec(until.tv_sec * 1000000000LL + until.tv_nsec + BOT_JOIN_NS);
+        if (p->running && pthread_timedjoin_np(p->thread, NULL, &until) != 0) {
+            fprintf(stderr, "bot: %s did not return from act(), left loaded\n", p->path);
+            continue;
+        }
+        for (int k = 0; k < p->num_tanks; k++) {
+            if (p->api->destroy) {
+                p->api->destroy(p->state[k]);
+            }
+        }
+        dlclose(p->handle);
+        free(p->tanks);
+        free(p->state);
+        free(p->actions);
+        free(p->path);
+    }
+    
+    if (g->bot_driven == h->driven) {
+        g->bot_driven = NULL;
+    }
+    free(h->driven);
+    h->driven = NULL;
+    h->num_plugins = 0;
+}
+
+
+// Function to ask every idle plugin for its tanks' actions and apply the answers that come within the budget.
+// The board is held still while the bots look at it; a plugin past the budget is dropped for the tick and not
+// asked again until it has returned.
+void bot_tick(BotHost* h, GameState* g) {
+    long long span = trace_begin();
+    
+    game_lock(g);
+    if (g->game_over) {
+        game_unlock(g);
+        return;
+    }
+    if (g->tick < h->last_tick) {
+        h->round++;
+    }
+    h->last_tick = g->tick;
+    
+    long long start = now_ns();
+    int asked = 0;
+    pthread_mutex_lock(&h->lock);
+    for (int i = 0; i < h->num_plugins; i++) {
+        BotPlugin* p = &h->plugins[i];
+        p->ready = 0;
+        if (p->done != p->posted) {
+            p->skipped++;
+            continue;
+        }
+        p->view.tick = g->tick;
+        p->view.round = h->round;
+        p->view.projectile_slots = g->projectile_hwm;
+        p->view.num_projectiles = g->num_projectiles;
+        p->posted++;
+        p->ready = 1; // Until the budget runs out without an answer
+        asked++;
+    }
+    if (asked) {
+        pthread_cond_broadcast(&h->work);
+    }
+    
+    struct timespec deadline = to_timespec(start + h->budget_ns);
+    int waiting = asked;
+    while (waiting) {
+        waiting = 0;
+        for (int i = 0; i < h->num_plugins; i++) {
+            waiting += h->plugins[i].ready && h->plugins[i].done != h->plugins[i].posted;
+        }
+        if (waiting && pthread_cond_timedwait(&h->answered, &h->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    for (int i = 0; i < h->num_plugins; i++) {
+        BotPlugin* p = &h->plugins[i];
+        if (p->ready && p->done != p->posted) {
+            p->ready = 0;
+            p->overruns++;
+        }
+    }
+    pthread_mutex_unlock(&h->lock);
+    game_unlock(g);
+    
+    unsigned long long waited = now_ns() - start;
+    h->ticks++;
+    h->wait_ns += waited;
+    if (waited > h->wait_ns_max) {
+        h->wait_ns_max = waited;
+    }
+    
+    // Plugins that answered are idle until the next post, so their actions hold still.
+    // They go through the tanks' input state at the rates a held key gets, under one hold of board_mutex.
+    game_lock(g);
+    for (int i = 0; i < h->num_plugins; i++) {
+        BotPlugin* p = &h->plugins[i];
+        for (int k = 0; p->ready && k < p->num_tanks; k++) {
+            int action = p->actions[k];
+            if (action >= TANK_BOT_UP && action <= TANK_BOT_FIRE) {
+                tank_drive_locked(g, p->tanks[k], (Action)action);
+            }
+        }
+    }
+    game_unlock(g);
+    trace_end("bots", span);
+}
+
+// Function to print what every plugin cost
+void bot_print_stats(BotHost* h, FILE* out) {
+    if (h->ticks == 0) {
+        return;
+    }
+    for (int i = 0; i < h->num_plugins; i++) {
+        BotPlugin* p = &h->plugins[i];
+        fprintf(out, "bot %s (%s): %d tanks, %lu calls, %.1f us/tick (max %.1f), %lu overruns, %lu ticks skipped\n",
+                p->api->name ? p->api->name : "?", p->path, p->num_tanks, p->calls,
+                p->posted ? p->call_ns / 1000.0 / p->posted : 0.0, p->call_ns_max / 1000.0, p->overruns, p->skipped);
+    }
+    fprintf(out, "bots: %lu ticks, waited %.1f us/tick (max %.1f) within a %.1f us budget\n",
+            h->ticks, h->wait_ns / 1000.0 / h->ticks, h->wait_ns_max / 1000.0, h->budget_ns / 1000.0);
+}
@@ -0,0 +1,60 @@
+#ifndef TANK_BOT_HOST_H
+#define TANK_BOT_HOST_H
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "game.h"
+#include "tank-bot.h"
+
+#define BOT_MAX_PLUGINS 8
+#define BOT_BUDGET_USEC 2000 // Default time every plugin gets per tick for all its tanks
+
+// One loaded plugin and the tanks it drives. Its act() calls run on a thread of its own.
+typedef struct {
+    struct BotHost* host;
+    char* path;
+    void* handle; // dlopen() handle
+    const TankBotPlugin* api;
+    int* tanks; // Tanks this plugin drives
+    void** state; // create() result for each of them
+    int* actions; // Latest act() result for each of them
+    int num_tanks;
+    TankBotView view; // The plugin thread's own copy, self differs per call
+    pthread_t thread;
+    int running;
+    int ready; // Answered within the budget this tick, actions are applied
+    unsigned long posted, done; // Ticks handed to the thread and answered, under BotHost.lock
+
+    unsigned long calls; // act() calls
+    unsigned long overruns; // Ticks the plugin did not answer within the budget, its actions dropped
+    unsigned long skipped; // Ticks it was not asked at all, still busy with an overrun
+    unsigned long long call_ns, call_ns_max; // Time of one tick's calls for all its tanks
+} BotPlugin;
+
+// Shared-object bots. Every tick each idle plugin is handed a view of the board; the game waits for the
+// answers until the budget runs out and applies those that came in through move_tank() and fire_projectile().
+typedef struct BotHost {
+    BotPlugin plugins[BOT_MAX_PLUGINS];
+    int num_plugins;
+    long long budget_ns;
+    uint8_t* driven; // Per tank, 1 when a plugin drives it; g->bot_driven points here
+    uint32_t round;
+    unsigned long last_tick;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work; // A tick was posted, or stop
+    pthread_cond_t answered; // A plugin finished its tick
+    int stop;
+
+    unsigned long ticks;
+    unsigned long long wait_ns, wait_ns_max; // Time the game spent waiting for answers
+} BotHost;
+
+int bot_host_init(BotHost* h, GameState* g, long budget_usec);
+int bot_load(BotHost* h, GameState* g, const char* spec);
+void bot_host_free(BotHost* h, GameState* g);
+void bot_tick(BotHost* h, GameState* g);
+void bot_print_stats(BotHost* h, FILE* out);
+
+#endif
@@ -0,0 +1,627 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+#include "telemetry.h"
+
+// Bytes each record takes in the payload
+#define SCALAR_BYTES (2 * 8 + 6 * 4 + 4 * 8 + NUM_PLAYERS * 2 * 4 + 3 * 4)
+#define TANK_BYTES (7 * 4 + 4 * 8 + 2 * 4)
+#define PROJECTILE_BYTES (10 * 4)
+
+// Write or read position in a buffer; bad is set once a read or write would run past the end
+typedef struct {
+    unsigned char* p;
+    unsigned char* end;
+    int bad;
+} Cursor;
+
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to append raw bytes
+static void put(Cursor* c, const void* v, size_t n) {
+    if (c->bad || (size_t)(c->end - c->p) < n) {
+        c->bad = 1;
+        return;
+    }
+    memcpy(c->p, v, n);
+    c->p += n;
+}
+
+// Function to append a 32-bit value
+static void put32(Cursor* c, int32_t v) {
+    put(c, &v, sizeof(v));
+}
+
+// Function to append a 64-bit value
+static void put64(Cursor* c, uint64_t v) {
+    put(c, &v, sizeof(v));
+}
+
+// Function to take raw bytes
+static void get(Cursor* c, void* v, size_t n) {
+    if (c->bad || (size_t)(c->end - c->p) < n) {
+        c->bad = 1;
+        memset(v, 0, n);
+        return;
+    }
+    memcpy(v, c->p, n);
+    c->p += n;
+}
+
+// Function to take a 32-bit value
+static int32_t get32(Cursor* c) {
+    int32_t v;
+    get(c, &v, sizeof(v));
+    return v;
+}
+
+// Function to take a 64-bit value
+static uint64_t get64(Cursor* c) {
+    uint64_t v;
+    get(c, &v, sizeof(v));
+    return v;
+}
+
+// Function to hash a payload: FNV-1a taken a 64-bit word at a time, the tail a byte at a time
+static uint64_t checksum(const unsigned char* p, size_t n) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        h ^= word;
+        h *= 0x100000001B3ULL;
+    }
+    for (; i < n; i++) {
+        h ^= p[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+// Function to get the bytes of the wall layer, stored only for generated boards
+static size_t wall_bytes(GameState* g) {
+    return g->map_base ? 0 : (size_t)g->walls.stride * g->height * sizeof(uint64_t);
+}
+
+// Function to write the game into a buffer (caller holds board_mutex), returns the bytes used
+static size_t serialize(Checkpoint* c, GameState* g, unsigned char* buf) {
+    CheckpointHeader hdr;
+    size_t path_len = c->map_path ? strlen(c->map_path) : 0;
+    Cursor w = { buf + sizeof(hdr) + path_len, buf + c->cap, 0 };
+    unsigned char* payload = w.p;
+    
+    put(&w, g->walls.bits, wall_bytes(g));
+    
+    // Round state, RNG included so the rest of the round plays out as it would have
+    put64(&w, g->tick);
+    put64(&w, g->projectile_steps);
+    put32(&w, g->move_ticks);
+    put32(&w, g->fire_ticks);
+    put32(&w, g->game_over);
+    put32(&w, g->winner);
+    put32(&w, g->tanks_alive);
+    put32(&w, g->projectile_speed);
+    for (int i = 0; i < 4; i++) {
+        put64(&w, g->rng.s[i]);
+    }
+    for (int i = 0; i < NUM_PLAYERS; i++) {
+        put32(&w, g->spawn_x[i]);
+        put32(&w, g->spawn_y[i]);
+    }
+    
+    for (int i = 0; i < g->num_tanks; i++) {
+        Tank* t = &g->tanks[i];
+        put32(&w, t->symbol);
+        put32(&w, t->x);
+        put32(&w, t->y);
+        put32(&w, t->health);
+        put32(&w, t->dir);
+        put32(&w, t->input.held_dir);
+        put32(&w, t->input.fire_held);
+        put64(&w, t->input.dir_seen);
+        put64(&w, t->input.fire_seen);
+        put64(&w, t->input.next_move);
+        put64(&w, t->input.next_fire);
+        put32(&w, (int32_t)t->input.keys_down);
+        put32(&w, t->shot_speed);
+    }
+    
+    // The pool as it is, so handles and slot reuse carry on unchanged
+    put32(&w, g->projectile_hwm);
+    put32(&w, g->num_free);
+    put32(&w, g->num_projectiles);
+    for (int i = 0; i < g->projectile_hwm; i++) {
+        Projectile* p = &g->projectiles[i];
+        put32(&w, p->x);
+        put32(&w, p->y);
+        put32(&w, p->fx);
+        put32(&w, p->fy);
+        put32(&w, p->vx);
+        put32(&w, p->vy);
+        put32(&w, p->dir);
+        put32(&w, p->active);
+        put32(&w, p->owner);
+        put32(&w, p->generation);
+    }
+    put(&w, g->free_slots, g->num_free * sizeof(uint16_t));
+    
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CHECKPOINT_MAGIC, 4);
+    hdr.version = CHECKPOINT_VERSION;
+    hdr.header_size = sizeof(hdr);
+    hdr.width = g->width;
+    hdr.height = g->height;
+    hdr.num_tanks = g->num_tanks;
+    hdr.max_projectiles = g->max_projectiles;
+    hdr.map_path_len = path_len;
+    hdr.flags = g->map_base ? 0 : CHECKPOINT_WALLS;
+    hdr.payload_size = w.p - payload;
+    hdr.checksum = checksum(payload, hdr.payload_size);
+    memcpy(buf, &hdr, sizeof(hdr));
+    if (path_len) {
+        memcpy(buf + sizeof(hdr), c->map_path, path_len);
+    }
+    return w.bad ? 0 : (size_t)(w.p - buf);
+}
+
+// Function to write a file and fsync it and its directory; the rename is what makes it visible
+static int write_file(Checkpoint* c, const unsigned char* data, size_t len) {
+    int fd = open(c->tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, data + done, len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            close(fd);
+            unlink(c->tmp_path);
+            return -1;
+        }
+        done += n;
+    }
+    if (fsync(fd) < 0 || close(fd) < 0 || rename(c->tmp_path, c->path) < 0) {
+        unlink(c->tmp_path);
+        return -1;
+    }
+    
+    // The rename itself survives a power cut once the directory is synced
+    char* slash = strrchr(c->path, '/');
+    char dir[4096];
+    snprintf(dir, sizeof(dir), "%.*s", slash ? (int)(slash - c->path) + 1 : 1, slash ? c->path : ".");
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    return 0;
+}
+
+// Function run by the writer thread: write the newest checkpoint handed over, until stopped with nothing left
+static void* writer_thread(void* arg) {
+    Checkpoint* c = arg;
+    
+    for (;;) {
+        pthread_mutex_lock(&c->lock);
+        while (!c->has_pending && !c->stop) {
+            pthread_cond_wait(&c->wake, &c->lock);
+        }
+        if (!c->has_pending) {
+            pthread_mutex_unlock(&c->lock);
+            break;
+        }
+        CheckpointBuf b = c->pending;
+        c->pending = c->write_buf;
+        c->write_buf = b;
+        c->has_pending = 0;
+        pthread_mutex_unlock(&c->lock);
+        
+        long long t0 = now_ns();
+        int rc = b.len ? write_file(c, b.data, b.len) : (unlink(c->path) < 0 && errno != ENOENT ? -1 : 0);
+        c->write_ns += now_ns() - t0;
+        c->written += rc == 0 && b.len;
+        c->failed += rc < 0;
+        c->bytes += rc == 0 ? b.len : 0;
+    }
+    return NULL;
+}
+
+// Function to set up checkpoints of a game to path every interval ticks and start the writer thread
+int checkpoint_open(Checkpoint* c, GameState* g, const char* path, const char* map_path, int interval) {
+    memset(c, 0, sizeof(Checkpoint));
+    c->interval = interval > 0 ? interval : CHECKPOINT_TICKS;
+    c->map_path = map_path;
+    c->cap = sizeof(CheckpointHeader) + (map_path ? strlen(map_path) : 0) + wall_bytes(g) + SCALAR_BYTES +
+             (size_t)g->num_tanks * TANK_BYTES + (size_t)g->max_projectiles * (PROJECTILE_BYTES + sizeof(uint16_t));
+    c->path = strdup(path);
+    c->tmp_path = malloc(strlen(path) + 5);
+    c->game_buf.data = malloc(c->cap);
+    c->pending.data = malloc(c->cap);
+    c->write_buf.data = malloc(c->cap);
+    if (!c->path || !c->tmp_path || !c->game_buf.data || !c->pending.data || !c->write_buf.data) {
+        checkpoint_close(c);
+        return -1;
+    }
+    sprintf(c->tmp_path, "%s.tmp", path);
+    
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->wake, NULL);
+    if (pthread_create(&c->thread, NULL, writer_thread, c) != 0) {
+        pthread_mutex_destroy(&c->lock);
+        pthread_cond_destroy(&c->wake);
+        checkpoint_close(c);
+        return -1;
+    }
+    c->running = 1;
+    return 0;
+}
+
+// Function to let the writer finish what was handed over and release everything
+void checkpoint_close(Checkpoint* c) {
+    if (c->running) {
+        pthread_mutex_lock(&c->lock);
+        c->stop = 1;
+        pthread_cond_signal(&c->wake);
+        pthread_mutex_unlock(&c->lock);
+        pthread_join(c->thread, NULL);
+        pthread_mutex_destroy(&c->lock);
+        pthread_cond_destroy(&c->wake);
+        c->running = 0;
+    }
+    free(c->path);
+    free(c->tmp_path);
+    free(c->game_buf.data);
+    free(c->pending.data);
+    free(c->write_buf.data);
+    c->path = c->tmp_path = NULL;
+    c->game_buf.data = c->pending.data = c->write_buf.data = NULL;
+}
+
+// Function to hand the game thread's buffer to the writer; one still waiting is replaced by the newer one
+static void hand_over(Checkpoint* c) {
+    pthread_mutex_lock(&c->lock);
+    CheckpointBuf b = c->pending;
+    c->pending = c->game_buf;
+    c->game_buf = b;
+    c->superseded += c->has_pending;
+    c->has_pending = 1;
+    pthread_cond_signal(&c->wake);
+    pthread_mutex_unlock(&c->lock);
+}
+
+// Function to checkpoint the game now
+void checkpoint_take(Checkpoint* c, GameState* g) {
+    long long t0 = now_ns();
+    
+    game_lock(g);
+    c->game_buf.len = serialize(c, g, c->game_buf.data);
+    game_unlock(g);
+    c->last_tick = g->tick;
+    if (c->game_buf.len == 0) {
+        return; // Cannot happen with the buffer sized by checkpoint_open()
+    }
+    
+    // The hand-over is a signal to the writer, which on one CPU may run straight away; it is not counted
+    unsigned long long ns = now_ns() - t0;
+    hand_over(c);
+    c->taken++;
+    c->serialize_ns += ns;
+    if (ns > c->serialize_ns_max) {
+        c->serialize_ns_max = ns;
+    }
+}
+
+// Function to call after every tick: checkpoints once every interval ticks, and early in a new round
+void checkpoint_tick(Checkpoint* c, GameState* g) {
+    c->ticks++;
+    if (g->tick < c->last_tick || g->tick - c->last_tick >= (unsigned long)c->interval) {
+        checkpoint_take(c, g);
+    }
+}
+
+// Function to remove the checkpoint, once the round it holds is over or the player quit
+void checkpoint_discard(Checkpoint* c) {
+    c->game_buf.len = 0;
+    c->last_tick = 0;
+    hand_over(c);
+}
+
+// Function to tell whether the checkpoint has a wall at a cell: its own wall words on a generated board, else the map's
+static int saved_wall(GameState* g, const unsigned char* wall_words, size_t walls, int x, int y) {
+    uint64_t word;
+    
+    if (!walls) {
+        return WALL_AT(g, x, y);
+    }
+    memcpy(&word, wall_words + ((size_t)y * g->walls.stride + (x >> 6)) * sizeof(uint64_t), sizeof(word));
+    return (word >> (x & 63)) & 1;
+}
+
+// Function to tell whether two live tanks in the tank records share a cell (positions already checked), -1 if out of
+// memory. The game's own tank layer still holds the board being replaced, so the records get a layer of their own.
+static int tanks_overlap(GameState* g, Cursor r) {
+    BitLayer seen;
+    int overlap = 0;
+    
+    if (bit_layer_alloc(&seen, g->width, g->height) < 0) {
+        return -1;
+    }
+    for (int i = 0; i < g->num_tanks && !overlap; i++) {
+        get32(&r); // Symbol
+        int x = get32(&r);
+        int y = get32(&r);
+        int health = get32(&r);
+        r.p += TANK_BYTES - 4 * 4;
+        if (health > 0) {
+            overlap = bit_test(&seen, x, y);
+            bit_set(&seen, x, y);
+        }
+    }
+    bit_layer_free(&seen);
+    return overlap;
+}
+
+// Function to read the payload, checking every value against the board; writes the game only when apply is set.
+// Returns 0 if the payload describes a valid game.
+static int parse(Cursor* r, GameState* g, int apply) {
+    size_t walls = wall_bytes(g);
+    if ((size_t)(r->end - r->p) < walls) {
+        return -1;
+    }
+    const unsigned char* wall_words = r->p;
+    r->p += walls;
+    
+    unsigned long tick = get64(r);
+    unsigned long steps = get64(r);
+    int move_ticks = get32(r);
+    int fire_ticks = get32(r);
+    int game_over = get32(r);
+    int winner = get32(r);
+    int tanks_alive = get32(r);
+    int projectile_speed = get32(r);
+    Rng rng;
+    for (int i = 0; i < 4; i++) {
+        rng.s[i] = get64(r);
+    }
+    int spawn[NUM_PLAYERS][2];
+    for (int i = 0; i < NUM_PLAYERS; i++) {
+        spawn[i][0] = get32(r);
+        spawn[i][1] = get32(r);
+    }
+    if (r->bad || winner < -1 || winner >= g->num_tanks || projectile_speed < 1 ||
+        projectile_speed > PROJECTILE_MAX_SPEED) {
+        return -1;
+    }
+    
+    if (apply) {
+        // The players' symbols lead their tank records; setting them up binds the keys
+        Cursor peek = *r;
+        char p1 = (char)get32(&peek);
+        peek.p += TANK_BYTES - 4;
+        char p2 = (char)get32(&peek);
+        setup_tanks(g, p1, p2);
+        
+        // Empty board, then the walls of a generated board
+        size_t words = (size_t)g->tank_bits.stride * g->height;
+        memset(g->tank_bits.bits, 0, words * sizeof(uint64_t));
+        memset(g->tank_bits_col.bits, 0, (size_t)g->tank_bits_col.stride * g->width * sizeof(uint64_t));
+        memset(g->shot_bits.bits, 0, (size_t)g->shot_bits.stride * g->height * sizeof(uint64_t));
+        memset(g->entity, 0, (size_t)g->width * g->height * sizeof(EntityId));
+        if (walls) {
+            memset(g->walls.bits, 0, walls);
+            memset(g->walls_col.bits, 0, (size_t)g->walls_col.stride * g->width * sizeof(uint64_t));
+            for (int y = 0; y < g->height; y++) {
+                for (int x = 0; x < g->width; x++) {
+                    if (saved_wall(g, wall_words, walls, x, y)) {
+                        set_wall(g, x, y);
+                    }
+                }
+            }
+        }
+        
+        g->tick = tick;
+        g->projectile_steps = steps;
+        g->move_ticks = move_ticks;
+        g->fire_ticks = fire_ticks;
+        g->game_over = game_over;
+        g->winner = winner;
+        g->tanks_alive = tanks_alive;
+        g->projectile_speed = projectile_speed;
+        g->rng = rng;
+        for (int i = 0; i < NUM_PLAYERS; i++) {
+            g->spawn_x[i] = spawn[i][0];
+            g->spawn_y[i] = spawn[i][1];
+        }
+    }
+    
+    int alive = 0;
+    Cursor tank_records = *r;
+    for (int i = 0; i < g->num_tanks; i++) {
+        Tank t;
+        memset(&t, 0, sizeof(t));
+        t.symbol = (char)get32(r);
+        t.x = get32(r);
+        t.y = get32(r);
+        t.health = get32(r);
+        t.dir = (Direction)get32(r);
+        t.input.held_dir = get32(r);
+        t.input.fire_held = get32(r);
+        t.input.dir_seen = get64(r);
+        t.input.fire_seen = get64(r);
+        t.input.next_move = get64(r);
+        t.input.next_fire = get64(r);
+        t.input.keys_down = (unsigned int)get32(r);
+        t.shot_speed = get32(r);
+        if (r->bad || t.dir > RIGHT || t.input.held_dir < -1 || t.input.held_dir > RIGHT || t.shot_speed < 0 ||
+            t.shot_speed > PROJECTILE_MAX_SPEED) {
+            return -1;
+        }
+        if (t.health > 0) {
+            if (t.x < 0 || t.x >= g->width || t.y < 0 || t.y >= g->height ||
+                saved_wall(g, wall_words, walls, t.x, t.y)) {
+                return -1;
+            }
+            alive++;
+        }
+        if (apply) {
+            Tank* tank = &g->tanks[i];
+            tank->symbol = t.symbol;
+            tank->x = t.x;
+            tank->y = t.y;
+            tank->health = t.health;
+            tank->dir = t.dir;
+            tank->input = t.input;
+            tank->shot_speed = t.shot_speed;
+            if (t.health > 0) {
+                bit_set(&g->tank_bits, t.x, t.y);
+                bit_set(&g->tank_bits_col, t.y, t.x);
+                ENTITY(g, t.x, t.y) = TANK_ENTITY(i);
+            }
+        }
+    }
+    if (alive != tanks_alive || (!apply && tanks_overlap(g, tank_records) != 0)) {
+        return -1;
+    }
+    
+    int hwm = get32(r);
+    int num_free = get32(r);
+    int num_projectiles = get32(r);
+    if (r->bad || hwm < 0 || hwm > g->max_projectiles || num_free < 0 || num_free > hwm ||
+        num_projectiles != hwm - num_free) {
+        return -1;
+    }
+    if (apply) {
+        memset(g->active_slots, 0, (size_t)(g->max_projectiles + 63) / 64 * sizeof(uint64_t));
+    }
+    for (int i = 0; i < hwm; i++) {
+        Projectile p;
+        p.x = get32(r);
+        p.y = get32(r);
+        p.fx = get32(r);
+        p.fy = get32(r);
+        p.vx = get32(r);
+        p.vy = get32(r);
+        p.dir = (Direction)get32(r);
+        p.active = get32(r);
+        p.owner = get32(r);
+        p.generation = (uint16_t)get32(r);
+        p.fired = tick; // Not checkpointed, a restored shot's lifetime counts from the restore
+        if (r->bad || (p.active && (p.x < 0 || p.x >= g->width || p.y < 0 || p.y >= g->height ||
+                                    p.dir > RIGHT || p.owner < 0 || p.owner >= g->num_tanks ||
+                                    p.fx >> FIX_SHIFT != p.x || p.fy >> FIX_SHIFT != p.y ||
+                                    abs(p.vx) > PROJECTILE_MAX_SPEED || abs(p.vy) > PROJECTILE_MAX_SPEED ||
+                                    (p.vx == 0 && p.vy == 0)))) {
+            return -1;
+        }
+        if (apply) {
+            g->projectiles[i] = p;
+            if (p.active) {
+                bit_set(&g->shot_bits, p.x, p.y);
+                g->active_slots[i / 64] |= 1ULL << (i % 64);
+            }
+        }
+    }
+    for (int i = 0; i < num_free; i++) {
+        uint16_t slot;
+        get(r, &slot, sizeof(slot));
+        if (r->bad || slot >= hwm) {
+            return -1;
+        }
+        if (apply) {
+            g->free_slots[i] = slot;
+        }
+    }
+    if (apply) {
+        g->projectile_hwm = hwm;
+        g->num_free = num_free;
+        g->num_projectiles = num_projectiles;
+    }
+    return r->p == r->end ? 0 : -1;
+}
+
+// Function to resume the game from the checkpoint, if there is one for this board.
+// Returns 0 when the game was restored; anything else leaves the game as it was.
+int checkpoint_restore(Checkpoint* c, GameState* g) {
+    long long t0 = now_ns();
+    CheckpointHeader hdr;
+    struct stat st;
+    size_t path_len = c->map_path ? strlen(c->map_path) : 0;
+    
+    int fd = open(c->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(hdr) || (size_t)st.st_size > c->cap) {
+        close(fd);
+        return -1;
+    }
+    unsigned char* buf = c->write_buf.data; // Idle until the first checkpoint is handed over
+    ssize_t n = read(fd, buf, st.st_size);
+    close(fd);
+    if (n != st.st_size) {
+        return -1;
+    }
+    
+    // Same board, same pool, same map, and a payload that is all there
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (memcmp(hdr.magic, CHECKPOINT_MAGIC, 4) != 0 || hdr.version != CHECKPOINT_VERSION ||
+        hdr.header_size != sizeof(hdr) || hdr.width != (uint32_t)g->width || hdr.height != (uint32_t)g->height ||
+        hdr.num_tanks != g->num_tanks || hdr.max_projectiles != g->max_projectiles ||
+        hdr.flags != (g->map_base ? 0 : CHECKPOINT_WALLS) || hdr.map_path_len != path_len ||
+        memcmp(buf + sizeof(hdr), c->map_path ? c->map_path : "", path_len) != 0 ||
+        sizeof(hdr) + path_len + hdr.payload_size != (size_t)n) {
+        return -1;
+    }
+    unsigned char* payload = buf + sizeof(hdr) + path_len;
+    if (checksum(payload, hdr.payload_size) != hdr.checksum) {
+        return -1;
+    }
+    
+    // Check everything before touching the game, then read it again for real
+    Cursor check = { payload, payload + hdr.payload_size, 0 };
+    if (parse(&check, g, 0) < 0) {
+        return -1;
+    }
+    Cursor r = { payload, payload + hdr.payload_size, 0 };
+    game_lock(g);
+    parse(&r, g, 1);
+    game_unlock(g);
+    if (g->telemetry) {
+        // The round carries on under a new match number, its start is in the run that wrote the checkpoint
+        telemetry_record(g->telemetry, TELEMETRY_ROUND, g->match, g->tick, g->num_tanks, TELEMETRY_ROUND_RESUMED, 0);
+    }
+    c->last_tick = g->tick;
+    c->restore_ns = now_ns() - t0;
+    return 0;
+}
+
+// Function to print what the checkpoints cost
+void checkpoint_print_stats(Checkpoint* c, FILE* out) {
+    if (c->restore_ns) {
+        fprintf(out, "checkpoint: round restored in %.3f ms\n", c->restore_ns / 1e6);
+    }
+    if (c->taken == 0) {
+        return;
+    }
+    fprintf(out, "checkpoint: %lu taken, serialize %.1f us avg (max %.1f us), %.3f us per tick; "
+            "%lu written (%lu superseded, %lu failed), %.0f bytes, write %.2f ms avg\n",
+            c->taken, c->serialize_ns / 1000.0 / c->taken, c->serialize_ns_max / 1000.0,
+            c->ticks ? c->serialize_ns / 1000.0 / c->ticks : 0.0,
+            c->written, c->superseded, c->failed, c->written ? (double)c->bytes / c->written : 0.0,
+            c->written ? c->write_ns / 1e6 / c->written : 0.0);
+}
@@ -0,0 +1,76 @@
+#ifndef TANK_CHECKPOINT_H
+#define TANK_CHECKPOINT_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "game.h"
+
+#define CHECKPOINT_MAGIC "TCKP"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_TICKS TICKS_PER_SEC // Ticks between checkpoints
+#define CHECKPOINT_WALLS 1 // Header flag: the walls are in the payload (generated board)
+
+// On-disk header (host byte order), followed by map_path_len bytes of map path and then the payload
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t header_size; // Offset of the map path
+    uint32_t width, height;
+    uint16_t num_tanks;
+    uint16_t max_projectiles;
+    uint16_t map_path_len; // 0 when the board was generated
+    uint16_t flags;
+    uint32_t payload_size;
+    uint64_t checksum; // FNV-1a of the payload
+} CheckpointHeader;
+
+// One serialized checkpoint; len 0 asks the writer to remove the file instead
+typedef struct {
+    unsigned char* data;
+    size_t len;
+} CheckpointBuf;
+
+// Periodic checkpoints of a running game. The game thread serializes under board_mutex into a buffer of
+// its own; a writer thread takes the newest one and writes it to a temporary file renamed over the checkpoint.
+typedef struct Checkpoint {
+    char* path;
+    char* tmp_path;
+    const char* map_path;
+    size_t cap; // Size of every buffer, enough for the largest state of this board
+    int interval;
+    unsigned long last_tick;
+    pthread_t thread;
+    int running;
+
+    pthread_mutex_t lock; // Guards pending, has_pending and stop
+    pthread_cond_t wake;
+    CheckpointBuf game_buf; // Game thread only
+    CheckpointBuf pending;
+    int has_pending;
+    int stop;
+    CheckpointBuf write_buf; // Writer thread only
+
+    // Game thread
+    unsigned long taken;
+    unsigned long superseded; // Replaced before the writer got to them
+    unsigned long long serialize_ns, serialize_ns_max;
+    unsigned long long ticks; // Ticks seen, for the cost per tick
+    long long restore_ns; // Time the startup restore took, 0 if nothing was restored
+
+    // Writer thread
+    unsigned long written, failed;
+    unsigned long long write_ns, bytes;
+} Checkpoint;
+
+int checkpoint_open(Checkpoint* c, GameState* g, const char* path, const char* map_path, int interval);
+void checkpoint_close(Checkpoint* c);
+void checkpoint_tick(Checkpoint* c, GameState* g);
+void checkpoint_take(Checkpoint* c, GameState* g);
+void checkpoint_discard(Checkpoint* c);
+int checkpoint_restore(Checkpoint* c, GameState* g);
+void checkpoint_print_stats(Checkpoint* c, FILE* out);
+
+#endif
@@ -0,0 +1,239 @@
+#include <ncurses.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "net.h"
+#include "render.h"
+
+#define LATENCY_SAMPLES 65536 // Kept for the percentiles printed on exit
+
+// Client side network statistics
+typedef struct {
+    long long connected_ns;
+    unsigned long long bytes_received;
+    unsigned long long bytes_sent;
+    unsigned long snapshots;
+    unsigned long boards;
+    unsigned long inputs;
+    unsigned long latency_count; // Inputs whose effect came back and was drawn
+    unsigned long long latency_ns_total;
+    unsigned long latency_samples[LATENCY_SAMPLES];
+} ClientStats;
+
+static GameState mirror; // Local copy of the server's game, only ever drawn
+static ClientStats client_stats;
+
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to send one action for our tank, stamped so the server can echo it back
+static void send_input(int fd, NetBuf* out, Action action) {
+    uint64_t sent = now_ns();
+    unsigned char a = (unsigned char)action;
+    size_t start = net_begin_frame(out, MSG_INPUT);
+    
+    netbuf_put(out, &a, 1);
+    netbuf_put(out, &sent, sizeof(sent));
+    net_end_frame(out, start);
+    client_stats.bytes_sent += out->len - start;
+    client_stats.inputs++;
+    net_flush(fd, out);
+}
+
+// Function to apply every complete frame received, returns the newest input echo or -1 if the stream is broken
+static long long apply_frames(NetBuf* in, int* you, int* new_board) {
+    size_t offset = 0;
+    MsgType type;
+    NetReader r;
+    long long echo = 0;
+    int found;
+    
+    while ((found = net_next_frame(in, &offset, &type, &r)) > 0) {
+        if (type == MSG_BOARD) {
+            if (net_apply_board(&mirror, &r, you) < 0) {
+                return -1;
+            }
+            *new_board = 1;
+            client_stats.boards++;
+        } else if (type == MSG_SNAPSHOT && mirror.entity) {
+            uint64_t sent = net_get_varint(&r);
+            if (net_apply_snapshot(&mirror, &r) < 0) {
+                return -1;
+            }
+            if (sent > (uint64_t)echo) {
+                echo = (long long)sent;
+            }
+            client_stats.snapshots++;
+        }
+    }
+    netbuf_consume(in, offset);
+    return found < 0 ? -1 : echo;
+}
+
+// Function to draw the round result over the board until the server starts the next round
+static void draw_result() {
+    int w = mirror.width < COLS ? mirror.width : COLS;
+    int h = mirror.height < LINES ? mirror.height : LINES;
+    
+    if (mirror.winner >= 0 && mirror.winner < mirror.num_tanks) {
+        int color = tank_color_pair(mirror.winner);
+        attron(COLOR_PAIR(color) | A_BOLD);
+        mvprintw(h / 2, (w - 25) / 2, "Jucatorul %c a castigat!", mirror.tanks[mirror.winner].symbol);
+        attroff(COLOR_PAIR(color) | A_BOLD);
+    } else {
+        mvprintw(h / 2, (w - 10) / 2, "Joc incheiat!");
+    }
+    refresh();
+}
+
+// Function to play on a server: keys go out as actions, snapshots come back and are drawn locally
+int run_client(const char* addr) {
+    NetBuf in = { 0 }, out = { 0 };
+    int you = -1;
+    int rendering = 0;
+    
+    int fd = net_connect(addr);
+    if (fd < 0) {
+        return -1;
+    }
+    client_stats.connected_ns = now_ns();
+    
+    struct pollfd fds[2] = {
+        { .fd = STDIN_FILENO, .events = POLLIN },
+        { .fd = fd, .events = POLLIN },
+    };
+    nodelay(stdscr, TRUE);
+    int rc = 0;
+    
+    while (1) {
+        fds[1].events = POLLIN | (out.len ? POLLOUT : 0);
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            rc = -1;
+            break;
+        }
+        
+        // Both players' key sets drive our own tank
+        if (fds[0].revents & (POLLHUP | POLLERR)) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            long long span = trace_begin();
+            int ch;
+            int quit = 0;
+            while ((ch = getch()) != ERR) {
+                if (ch == 'q') {
+                    quit = 1;
+                } else if (you >= 0 && mirror.entity && ch < KEY_MAP_SIZE && mirror.key_tank[ch] >= 0) {
+                    send_input(fd, &out, (Action)mirror.key_action[ch]);
+                }
+            }
+            trace_end("input", span);
+            if (quit) {
+                break;
+            }
+        }
+        
+        if (fds[1].revents & POLLOUT) {
+            net_flush(fd, &out);
+        }
+        if (!(fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            continue;
+        }
+        
+        size_t before = in.len;
+        long long span = trace_begin();
+        int closed = net_receive(fd, &in) < 0;
+        client_stats.bytes_received += in.len - before;
+        
+        int new_board = 0;
+        long long echo = apply_frames(&in, &you, &new_board);
+        trace_end("snapshot apply", span);
+        if (echo < 0) {
+            rc = -1;
+            break;
+        }
+        
+        if (new_board) {
+            // Board size or tank count may differ from the last round
+            if (rendering) {
+                render_free();
+            }
+            if (render_init(&mirror) < 0) {
+                rc = -1;
+                break;
+            }
+            rendering = 1;
+            clear();
+            render_invalidate();
+        }
+        if (rendering) {
+            render_game(&mirror);
+            if (mirror.game_over) {
+                draw_result();
+            }
+        }
+        
+        // End-to-end latency: key sent, server applied it, its snapshot arrived and is on screen
+        if (echo > 0) {
+            unsigned long ns = now_ns() - echo;
+            client_stats.latency_samples[client_stats.latency_count % LATENCY_SAMPLES] = ns;
+            client_stats.latency_count++;
+            client_stats.latency_ns_total += ns;
+        }
+        
+        if (closed) {
+            rc = -1; // Server went away
+            break;
+        }
+    }
+    
+    close(fd);
+    netbuf_free(&in);
+    netbuf_free(&out);
+    if (rendering) {
+        render_free();
+    }
+    if (mirror.entity) {
+        game_free(&mirror);
+    }
+    return rc;
+}
+
+// Function to compare latency samples for qsort
+static int cmp_ul(const void* a, const void* b) {
+    unsigned long x = *(const unsigned long*)a;
+    unsigned long y = *(const unsigned long*)b;
+    return (x > y) - (x < y);
+}
+
+// Function to print bandwidth and latency once the terminal is released
+void print_client_stats(FILE* out) {
+    ClientStats* s = &client_stats;
+    double secs = (now_ns() - s->connected_ns) / 1e9;
+    
+    fprintf(out, "net: %.1f s, received %llu bytes (%.0f B/s) in %lu snapshots and %lu boards, sent %lu inputs (%llu bytes)\n",
+            secs, s->bytes_received, secs > 0 ? s->bytes_received / secs : 0.0,
+            s->snapshots, s->boards, s->inputs, s->bytes_sent);
+    
+    unsigned long n = s->latency_count < LATENCY_SAMPLES ? s->latency_count : LATENCY_SAMPLES;
+    if (n == 0) {
+        return;
+    }
+    qsort(s->latency_samples, n, sizeof(unsigned long), cmp_ul);
+    fprintf(out, "net: input-to-screen %.1f us avg, p50 %.1f us, p99 %.1f us, max %.1f us over %lu inputs\n",
+            s->latency_ns_total / 1000.0 / s->latency_count,
+            s->latency_samples[n / 2] / 1000.0,
+            s->latency_samples[(unsigned long)(n * 0.99)] / 1000.0,
+            s->latency_samples[n - 1] / 1000.0, s->latency_count);
+}
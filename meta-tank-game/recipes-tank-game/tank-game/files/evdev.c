@@ -0,0 +1,299 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+
+#include "evdev.h"
+
+#define LONG_BITS (8 * sizeof(long))
+
+// Characters the game binds, by key code (US layout)
+static const char key_chars[KEY_CNT] = {
+    [KEY_A] = 'a', [KEY_B] = 'b', [KEY_C] = 'c', [KEY_D] = 'd', [KEY_E] = 'e', [KEY_F] = 'f',
+    [KEY_G] = 'g', [KEY_H] = 'h', [KEY_I] = 'i', [KEY_J] = 'j', [KEY_K] = 'k', [KEY_L] = 'l',
+    [KEY_M] = 'm', [KEY_N] = 'n', [KEY_O] = 'o', [KEY_P] = 'p', [KEY_Q] = 'q', [KEY_R] = 'r',
+    [KEY_S] = 's', [KEY_T] = 't', [KEY_U] = 'u', [KEY_V] = 'v', [KEY_W] = 'w', [KEY_X] = 'x',
+    [KEY_Y] = 'y', [KEY_Z] = 'z',
+    [KEY_1] = '1', [KEY_2] = '2', [KEY_3] = '3', [KEY_4] = '4', [KEY_5] = '5',
+    [KEY_6] = '6', [KEY_7] = '7', [KEY_8] = '8', [KEY_9] = '9', [KEY_0] = '0',
+    [KEY_SPACE] = ' ', [KEY_ENTER] = '\n', [KEY_MINUS] = '-', [KEY_EQUAL] = '=',
+    [KEY_COMMA] = ',', [KEY_DOT] = '.', [KEY_SLASH] = '/', [KEY_SEMICOLON] = ';',
+};
+
+// Function to read a clock in nanoseconds
+static long long clock_ns(int clock_id) {
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to read an event's kernel timestamp in nanoseconds
+static long long event_ns(const struct input_event* e) {
+    return (long long)e->input_event_sec * 1000000000LL + (long long)e->input_event_usec * 1000;
+}
+
+// Function to test a bit of a kernel bitmap (an array of longs)
+static int kernel_bit(const unsigned long* bits, int i) {
+    return (bits[i / LONG_BITS] >> (i % LONG_BITS)) & 1;
+}
+
+// Function to reset the state to no devices and no keys down
+static void evdev_reset(Evdev* ev) {
+    memset(ev, 0, sizeof(Evdev));
+    ev->clock_id = CLOCK_MONOTONIC;
+    ev->timer_fd = -1;
+}
+
+// Function to record a key change and pass it to the tank it is bound to; t is when it happened
+static void key_event(Evdev* ev, GameState* g, int code, int down, long long t) {
+    if (code < 0 || code >= KEY_CNT || (int)((ev->down[code >> 6] >> (code & 63)) & 1) == (down != 0)) {
+        return; // Not a key, or no change
+    }
+    if (down) {
+        ev->down[code >> 6] |= 1ULL << (code & 63);
+    } else {
+        ev->down[code >> 6] &= ~(1ULL << (code & 63));
+    }
+    ev->stamp[code] = t;
+    
+    unsigned char ch = (unsigned char)key_chars[code];
+    if (ch && g->key_tank[ch] >= 0) {
+        tank_key(g, g->key_tank[ch], (Action)g->key_action[ch], down);
+    }
+    
+    long long late = clock_ns(ev->clock_id) - t;
+    ev->events++;
+    ev->latency_total += late > 0 ? late : 0;
+    if (late > 0 && (unsigned long long)late > ev->latency_max) {
+        ev->latency_max = late;
+    }
+}
+
+// Function to open one device if it is a keyboard, returns 0 on success
+static int open_device(Evdev* ev, const char* path) {
+    unsigned long keys[KEY_CNT / LONG_BITS + 1];
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    // Something with letters and a space bar, mice and power buttons report keys too
+    memset(keys, 0, sizeof(keys));
+    if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0 || !kernel_bit(keys, KEY_A) || !kernel_bit(keys, KEY_SPACE)) {
+        close(fd);
+        return -1;
+    }
+    
+    // Monotonic stamps compare with the game's clock; older kernels stamp with the wall clock
+    int clock_id = CLOCK_MONOTONIC;
+    if (ioctl(fd, EVIOCSCLOCKID, &clock_id) < 0) {
+        ev->clock_id = CLOCK_REALTIME;
+    }
+    
+    // Keys already down when the game starts are down, but they were never pressed for it
+    memset(keys, 0, sizeof(keys));
+    if (ioctl(fd, EVIOCGKEY(sizeof(keys)), keys) == 0) {
+        for (int code = 0; code < KEY_CNT; code++) {
+            if (kernel_bit(keys, code)) {
+                ev->down[code >> 6] |= 1ULL << (code & 63);
+            }
+        }
+    }
+    ev->fds[ev->num_fds++] = fd;
+    return 0;
+}
+
+// Function to open keyboards: a comma-separated list of event devices, or "auto" for every keyboard found.
+// Returns the number of devices opened, -1 if none.
+int evdev_open(Evdev* ev, const char* devices) {
+    char path[256];
+    
+    evdev_reset(ev);
+    if (strcmp(devices, "auto") == 0) {
+        for (int i = 0; i < EVDEV_SCAN && ev->num_fds < EVDEV_MAX_DEVICES; i++) {
+            snprintf(path, sizeof(path), "/dev/input/event%d", i);
+            open_device(ev, path);
+        }
+    } else {
+        for (const char* p = devices; *p && ev->num_fds < EVDEV_MAX_DEVICES; ) {
+            size_t n = strcspn(p, ",");
+            snprintf(path, sizeof(path), "%.*s", (int)n, p);
+            if (open_device(ev, path) < 0) {
+                evdev_close(ev);
+                return -1; // A device asked for by name has to be there
+            }
+            p += n;
+            p += (*p == ',');
+        }
+    }
+    return ev->num_fds > 0 ? ev->num_fds : -1;
+}
+
+// Function to read the next event of a capture, returns 0 at the end
+static int read_capture(Evdev* ev) {
+    ev->have_next = fread(&ev->next, sizeof(ev->next), 1, ev->replay) == 1;
+    return ev->have_next;
+}
+
+// Function to arm the replay timer for the event read ahead, or disarm it at the end of the capture
+static void arm_replay(Evdev* ev) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (ev->have_next) {
+        long long due = ev->replay_base + event_ns(&ev->next) - ev->capture_base;
+        its.it_value.tv_sec = due / 1000000000LL;
+        its.it_value.tv_nsec = due % 1000000000LL;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+            its.it_value.tv_nsec = 1; // Zero would disarm
+        }
+    }
+    timerfd_settime(ev->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+// Function to replay a captured event stream (cat /dev/input/eventN > file) with its original timing
+int evdev_open_replay(Evdev* ev, const char* path) {
+    evdev_reset(ev);
+    ev->replay = fopen(path, "rb");
+    if (!ev->replay) {
+        return -1;
+    }
+    ev->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (ev->timer_fd < 0 || !read_capture(ev)) {
+        evdev_close(ev);
+        return -1;
+    }
+    ev->capture_base = event_ns(&ev->next);
+    return 0; // The capture's clock starts when the game first polls for keys
+}
+
+// Function to close the devices or the capture
+void evdev_close(Evdev* ev) {
+    for (int i = 0; i < ev->num_fds; i++) {
+        close(ev->fds[i]);
+    }
+    ev->num_fds = 0;
+    if (ev->replay) {
+        fclose(ev->replay);
+        ev->replay = NULL;
+    }
+    if (ev->timer_fd >= 0) {
+        close(ev->timer_fd);
+        ev->timer_fd = -1;
+    }
+}
+
+// Function to fill in the descriptors the game loop polls for key events, returns how many
+int evdev_pollfds(Evdev* ev, struct pollfd* fds, int max) {
+    int n = 0;
+    
+    if (ev->replay && ev->replay_base == 0) {
+        ev->replay_base = clock_ns(CLOCK_MONOTONIC);
+        arm_replay(ev);
+    }
+    if (ev->timer_fd >= 0 && n < max) {
+        fds[n++] = (struct pollfd){ .fd = ev->timer_fd, .events = POLLIN };
+    }
+    for (int i = 0; i < ev->num_fds && n < max; i++) {
+        fds[n++] = (struct pollfd){ .fd = ev->fds[i], .events = POLLIN };
+    }
+    return n;
+}
+
+// Function to read the whole key state back after the kernel dropped events, applying what changed
+static void resync(Evdev* ev, GameState* g, int fd) {
+    unsigned long keys[KEY_CNT / LONG_BITS + 1];
+    
+    memset(keys, 0, sizeof(keys));
+    if (ioctl(fd, EVIOCGKEY(sizeof(keys)), keys) < 0) {
+        return;
+    }
+    long long now = clock_ns(ev->clock_id);
+    for (int code = 0; code < KEY_CNT; code++) {
+        key_event(ev, g, code, kernel_bit(keys, code), now);
+    }
+    ev->resyncs++;
+}
+
+// Function to deliver the capture's events whose time has come
+static int read_replay(Evdev* ev, GameState* g) {
+    uint64_t expirations;
+    unsigned long before = ev->events;
+    long long now = clock_ns(CLOCK_MONOTONIC);
+    
+    if (read(ev->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        return -1;
+    }
+    while (ev->have_next && ev->replay_base + event_ns(&ev->next) - ev->capture_base <= now) {
+        struct input_event* e = &ev->next;
+        if (e->type == EV_KEY && e->value == 2) {
+            ev->repeats++;
+        } else if (e->type == EV_KEY) {
+            key_event(ev, g, e->code, e->value, ev->replay_base + event_ns(e) - ev->capture_base);
+        }
+        read_capture(ev);
+    }
+    arm_replay(ev);
+    return (int)(ev->events - before);
+}
+
+// Function to apply every pending key event, returns how many changed a key (-1 once no device is left)
+int evdev_read(Evdev* ev, GameState* g) {
+    struct input_event batch[EVDEV_BATCH];
+    unsigned long before = ev->events;
+    
+    if (ev->replay) {
+        return read_replay(ev, g);
+    }
+    for (int i = 0; i < ev->num_fds; i++) {
+        int dropped = 0;
+        ssize_t n;
+        while ((n = read(ev->fds[i], batch, sizeof(batch))) > 0) {
+            for (size_t k = 0; k < (size_t)n / sizeof(batch[0]); k++) {
+                struct input_event* e = &batch[k];
+                if (e->type == EV_SYN && e->code == SYN_DROPPED) {
+                    dropped = 1; // Everything up to the next report is unreliable
+                } else if (e->type == EV_SYN && e->code == SYN_REPORT && dropped) {
+                    resync(ev, g, ev->fds[i]);
+                    dropped = 0;
+                } else if (dropped) {
+                    continue;
+                } else if (e->type == EV_KEY && e->value == 2) {
+                    ev->repeats++;
+                } else if (e->type == EV_KEY) {
+                    key_event(ev, g, e->code, e->value, event_ns(e));
+                }
+            }
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            // Unplugged: forget the device and let go of every key, no key-up will come for them
+            close(ev->fds[i]);
+            ev->fds[i--] = ev->fds[--ev->num_fds];
+            long long now = clock_ns(ev->clock_id);
+            for (int code = 0; code < KEY_CNT; code++) {
+                key_event(ev, g, code, 0, now);
+            }
+        }
+    }
+    if (ev->num_fds == 0) {
+        return -1;
+    }
+    return (int)(ev->events - before);
+}
+
+// Function to tell whether a key is down
+int evdev_key_down(Evdev* ev, int code) {
+    return code >= 0 && code < KEY_CNT && ((ev->down[code >> 6] >> (code & 63)) & 1);
+}
+
+// Function to print what the backend saw
+void evdev_print_stats(Evdev* ev, FILE* out) {
+    if (ev->events == 0) {
+        return;
+    }
+    fprintf(out, "evdev: %lu key events, event-to-game %.1f us avg (max %.1f us), %lu repeats skipped, %lu resyncs\n",
+            ev->events, ev->latency_total / 1000.0 / ev->events, ev->latency_max / 1000.0,
+            ev->repeats, ev->resyncs);
+}
@@ -0,0 +1,47 @@
+#ifndef TANK_EVDEV_H
+#define TANK_EVDEV_H
+
+#include <linux/input.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "game.h"
+
+#define EVDEV_MAX_DEVICES 8
+#define EVDEV_SCAN 32 // /dev/input/event0 to event31 are tried for "auto"
+#define EVDEV_BATCH 64 // Events read per read()
+
+// Keyboard state read straight from the kernel's input devices, or from a captured event stream.
+// Every key has a down bit and the kernel time of its last change, so any number of keys can be held at once.
+typedef struct {
+    int fds[EVDEV_MAX_DEVICES];
+    int num_fds;
+    uint64_t down[BIT_WORDS(KEY_CNT)];
+    long long stamp[KEY_CNT]; // Time of each key's last change, ns on the clock below
+    int clock_id; // Clock the events are stamped with: CLOCK_MONOTONIC when the kernel agrees
+
+    // Replay of a captured stream: each event is delivered when its offset from the first one comes round
+    FILE* replay; // Capture file (raw struct input_event records), NULL when reading devices
+    int timer_fd; // timerfd armed for the next event's time
+    struct input_event next; // Read ahead, not delivered yet
+    int have_next;
+    long long replay_base; // Monotonic time the capture's first event maps to
+    long long capture_base; // Capture time of the first event
+
+    unsigned long events; // Key events applied
+    unsigned long repeats; // Autorepeat events skipped, held keys need none
+    unsigned long resyncs; // Times the kernel dropped events and the state was read back
+    unsigned long long latency_total; // Event time to applied, ns
+    unsigned long long latency_max;
+} Evdev;
+
+int evdev_open(Evdev* ev, const char* devices);
+int evdev_open_replay(Evdev* ev, const char* path);
+void evdev_close(Evdev* ev);
+int evdev_pollfds(Evdev* ev, struct pollfd* fds, int max);
+int evdev_read(Evdev* ev, GameState* g);
+int evdev_key_down(Evdev* ev, int code);
+void evdev_print_stats(Evdev* ev, FILE* out);
+
+#endif
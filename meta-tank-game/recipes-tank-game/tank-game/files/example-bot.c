@@ -0,0 +1,99 @@
+// Example bot plugin: fires along any row or column with an enemy in sight, otherwise wanders.
+// Build with `make bot-example` and load with tank-game -b 4 -B ./tank-bot-example.so
+#include <stdlib.h>
+
+#include "tank-bot.h"
+
+static const int dir_dx[4] = { 0, 0, -1, 1 }; // Indexed by TANK_BOT_UP..TANK_BOT_RIGHT
+static const int dir_dy[4] = { -1, 1, 0, 0 };
+
+// One tank's bot
+typedef struct {
+    uint64_t rng;
+    int heading; // Direction it wanders in
+    uint32_t round;
+} ExampleBot;
+
+// Function to step the bot's xorshift generator
+static uint32_t next_random(ExampleBot* b) {
+    b->rng ^= b->rng << 13;
+    b->rng ^= b->rng >> 7;
+    b->rng ^= b->rng << 17;
+    return (uint32_t)(b->rng >> 32);
+}
+
+// Function to make one tank's bot
+static void* example_create(const TankBotView* view, int tank) {
+    ExampleBot* b = calloc(1, sizeof(ExampleBot));
+    if (b) {
+        b->rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(tank + 1);
+        b->heading = tank % 4;
+        b->round = view->round;
+    }
+    return b;
+}
+
+// Function to tell whether a cell can be walked into
+static int open_cell(const TankBotView* v, int x, int y) {
+    return x >= 0 && y >= 0 && x < v->width && y < v->height &&
+           !tank_bot_cell(v, v->walls, x, y) && !tank_bot_cell(v, v->tanks_at, x, y);
+}
+
+// Function to find a direction with another tank in sight before the first wall, -1 if there is none
+static int enemy_in_sight(const TankBotView* v, int x, int y) {
+    for (int d = 0; d < 4; d++) {
+        int cx = x + dir_dx[d], cy = y + dir_dy[d];
+        while (cx >= 0 && cy >= 0 && cx < v->width && cy < v->height && !tank_bot_cell(v, v->walls, cx, cy)) {
+            if (tank_bot_cell(v, v->tanks_at, cx, cy)) {
+                return d;
+            }
+            cx += dir_dx[d];
+            cy += dir_dy[d];
+        }
+    }
+    return -1;
+}
+
+// Function to pick this tick's action
+static int example_act(void* state, const TankBotView* v) {
+    ExampleBot* b = state;
+    int x = TANK_BOT_TANK(v, v->self, x);
+    int y = TANK_BOT_TANK(v, v->self, y);
+    
+    if (!b) {
+        return TANK_BOT_IDLE;
+    }
+    if (b->round != v->round) {
+        b->round = v->round;
+        b->heading = next_random(b) % 4;
+    }
+    
+    int aim = enemy_in_sight(v, x, y);
+    if (aim >= 0) {
+        // Face it first, which also steps towards it when the next cell is free
+        return TANK_BOT_TANK(v, v->self, dir) == aim ? TANK_BOT_FIRE : aim;
+    }
+    
+    if (!open_cell(v, x + dir_dx[b->heading], y + dir_dy[b->heading]) || next_random(b) % 16 == 0) {
+        b->heading = next_random(b) % 4;
+    }
+    return b->heading;
+}
+
+// Function to free one tank's bot
+static void example_destroy(void* state) {
+    free(state);
+}
+
+static const TankBotPlugin example_plugin = {
+    .abi_version = TANK_BOT_ABI_VERSION,
+    .name = "example",
+    .create = example_create,
+    .act = example_act,
+    .destroy = example_destroy,
+};
+
+// Function the game looks up after dlopen()
+const TankBotPlugin* tank_bot_plugin(void) {
+    return &example_plugin;
+}
@@ -0,0 +1,1056 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+#include "map.h"
+#include "mapgen.h"
+#include "gamelog.h"
+#include "ai.h"
+#include "telemetry.h"
+
+// Function to record a match event of the round in progress when telemetry is on
+static inline void record(GameState* g, int kind, int tank, int arg, uint32_t value) {
+    if (g->telemetry) {
+        telemetry_record(g->telemetry, kind, g->match, g->tick, tank, arg, value);
+    }
+}
+
+#define SWEEP_TIME 32768 // One tick in the time units of the sweep
+#define SWEEP_NEVER UINT32_MAX // Meeting time of a projectile that meets no other
+#define HASH_MIN_BUCKETS 256
+
+// What stopped a projectile during the tick
+enum { SWEEP_FLYING, SWEEP_WALL, SWEEP_TANK, SWEEP_SHOT };
+
+// A cell a projectile is in during part of the tick, from t0 to t1
+typedef struct {
+    int32_t next; // Earlier segment of the same group, -1 at the end
+    uint16_t slot;
+    uint16_t t0, t1;
+} Segment;
+
+// The segments one tank's projectiles have in one cell. Shots of the same tank never meet, so a cell
+// crowded by one tank's shots costs a single step of the bucket walk, not one per shot.
+typedef struct {
+    int32_t cell; // y * width + x
+    int32_t owner;
+    int32_t first; // Latest segment, -1 for none
+    int32_t next; // Earlier group in the same hash bucket, -1 at the end
+} Group;
+
+// Where a projectile's sweep ended
+typedef struct {
+    uint8_t stop; // SWEEP_*
+    int32_t x, y; // Cell it ends the tick in, the tank's cell when it hit one
+    int tank; // Tank hit
+    int cells; // Cells it moved into
+    uint32_t hit_t; // Earliest meeting with another tank's projectile, SWEEP_NEVER for none
+    int hit; // Slot it meets then
+} SweepEnd;
+
+// Scratch of the projectile pass, kept between ticks so it is only allocated as the pool's peak grows.
+// Cells are hashed by bucket stamp, so starting a tick never clears the table.
+typedef struct Sweep {
+    Segment* segments;
+    int num_segments, max_segments;
+    Group* groups; // Never more than segments
+    int num_groups;
+    int32_t* bucket_head;
+    uint32_t* bucket_stamp;
+    uint32_t stamp; // Buckets stamped with another value are empty
+    uint32_t mask; // Buckets - 1, a power of two
+    SweepEnd* end; // Per pool slot
+} Sweep;
+
+// Function to allocate a game of the given board size and projectile capacity
+int game_init(GameState* g, int width, int height, int max_projectiles, int num_tanks) {
+    return game_init_with_walls(g, width, height, max_projectiles, num_tanks, NULL, NULL);
+}
+
+// Function to set up a game on caller-provided wall layers, by row and by column (NULL allocates them)
+int game_init_with_walls(GameState* g, int width, int height, int max_projectiles, int num_tanks,
+                         uint64_t* walls, uint64_t* walls_col) {
+    memset(g, 0, sizeof(GameState));
+    
+    if (width < 3 || height < 3 || max_projectiles < 1 || max_projectiles > PROJECTILE_POOL_LIMIT ||
+        num_tanks < NUM_PLAYERS || num_tanks > MAX_TANKS) {
+        return -1;
+    }
+    
+    g->width = width;
+    g->height = height;
+    g->max_projectiles = max_projectiles;
+    g->num_tanks = num_tanks;
+    int failed = 0;
+    if (walls && walls_col) {
+        bit_layer_attach(&g->walls, width, height, walls);
+        bit_layer_attach(&g->walls_col, height, width, walls_col);
+    } else {
+        failed |= bit_layer_alloc(&g->walls, width, height);
+        failed |= bit_layer_alloc(&g->walls_col, height, width);
+    }
+    failed |= bit_layer_alloc(&g->tank_bits, width, height);
+    failed |= bit_layer_alloc(&g->tank_bits_col, height, width);
+    failed |= bit_layer_alloc(&g->shot_bits, width, height);
+    g->entity = calloc((size_t)width * height, sizeof(EntityId));
+    g->tanks = calloc(num_tanks, sizeof(Tank));
+    g->projectiles = calloc(max_projectiles, sizeof(Projectile));
+    g->free_slots = malloc(max_projectiles * sizeof(uint16_t));
+    g->active_slots = calloc((max_projectiles + 63) / 64, sizeof(uint64_t));
+    g->sweep = calloc(1, sizeof(Sweep));
+    if (g->sweep) {
+        g->sweep->end = calloc(max_projectiles, sizeof(SweepEnd));
+    }
+    if (failed || !g->entity || !g->tanks || !g->projectiles || !g->free_slots || !g->active_slots ||
+        !g->sweep || !g->sweep->end) {
+        if (walls && walls_col) {
+            g->walls.bits = NULL; // Not ours to free
+            g->walls_col.bits = NULL;
+        }
+        game_free(g);
+        return -1;
+    }
+    
+    // Default spawns are the top-left and bottom-right corners
+    g->spawn_x[0] = 2;
+    g->spawn_y[0] = 2;
+    g->spawn_x[1] = width - 3;
+    g->spawn_y[1] = height - 3;
+    
+    g->winner = -1;
+    set_input_rates(g, MOVE_RATE, FIRE_RATE);
+    set_projectile_speed(g, -1, PROJECTILE_SPEED);
+    pthread_mutex_init(&g->board_mutex, NULL);
+    return 0;
+}
+
+// Function to release everything game_init() allocated
+void game_free(GameState* g) {
+    if (g->entity) {
+        pthread_mutex_destroy(&g->board_mutex);
+    }
+    if (g->map_base) {
+        map_unload(g);
+    } else {
+        bit_layer_free(&g->walls);
+        bit_layer_free(&g->walls_col);
+    }
+    bit_layer_free(&g->tank_bits);
+    bit_layer_free(&g->tank_bits_col);
+    bit_layer_free(&g->shot_bits);
+    free(g->entity);
+    free(g->tanks);
+    free(g->projectiles);
+    free(g->free_slots);
+    free(g->active_slots);
+    if (g->sweep) {
+        free(g->sweep->segments);
+        free(g->sweep->groups);
+        free(g->sweep->bucket_head);
+        free(g->sweep->bucket_stamp);
+        free(g->sweep->end);
+        free(g->sweep);
+    }
+    g->entity = NULL;
+    g->tanks = NULL;
+    g->projectiles = NULL;
+    g->free_slots = NULL;
+    g->active_slots = NULL;
+    g->sweep = NULL;
+}
+
+// Function to set how fast held keys repeat, in actions per second
+void set_input_rates(GameState* g, int moves_per_sec, int shots_per_sec) {
+    g->move_ticks = moves_per_sec > 0 ? TICKS_PER_SEC / moves_per_sec : TICKS_PER_SEC;
+    g->fire_ticks = shots_per_sec > 0 ? TICKS_PER_SEC / shots_per_sec : TICKS_PER_SEC;
+    if (g->move_ticks < 1) {
+        g->move_ticks = 1;
+    }
+    if (g->fire_ticks < 1) {
+        g->fire_ticks = 1;
+    }
+}
+
+// Function to set the speed of new projectiles in cells per second: the game's default when tank is -1,
+// else that tank's own (0 goes back to the default). Speeds are capped at PROJECTILE_MAX_SPEED.
+void set_projectile_speed(GameState* g, int tank, int cells_per_sec) {
+    int speed = cells_per_sec * FIX_ONE / TICKS_PER_SEC;
+    if (speed > PROJECTILE_MAX_SPEED) {
+        speed = PROJECTILE_MAX_SPEED;
+    }
+    if (speed < 1 && (tank < 0 || cells_per_sec > 0)) {
+        speed = 1;
+    }
+    if (tank < 0) {
+        g->projectile_speed = speed;
+    } else if (tank < g->num_tanks) {
+        g->tanks[tank].shot_speed = cells_per_sec > 0 ? speed : 0;
+    }
+}
+
+// Function to bind every tank's keys in the key lookup table
+static void bind_keys(GameState* g) {
+    memset(g->key_tank, 0xFF, sizeof(g->key_tank)); // -1: unbound
+    for (int i = 0; i < g->num_tanks; i++) {
+        Tank* tank = &g->tanks[i];
+        const char keys[NUM_ACTIONS] = { tank->up_key, tank->down_key, tank->left_key, tank->right_key, tank->fire_key };
+        for (int a = 0; a < NUM_ACTIONS; a++) {
+            unsigned char key = (unsigned char)keys[a];
+            if (key != 0) {
+                g->key_tank[key] = (int16_t)i;
+                g->key_action[key] = (uint8_t)a;
+            }
+        }
+    }
+}
+
+// Function to assign symbols and the default controls to the players, bots get digits and no keys
+void setup_tanks(GameState* g, char p1_char, char p2_char) {
+    g->tanks[0].symbol = p1_char;
+    g->tanks[0].up_key = 'w';
+    g->tanks[0].down_key = 's';
+    g->tanks[0].left_key = 'a';
+    g->tanks[0].right_key = 'd';
+    g->tanks[0].fire_key = ' '; // Space
+    g->tanks[0].health = MAX_HEALTH;
+    g->tanks[0].dir = RIGHT;
+    
+    g->tanks[1].symbol = p2_char;
+    g->tanks[1].up_key = 'i';
+    g->tanks[1].down_key = 'k';
+    g->tanks[1].left_key = 'j';
+    g->tanks[1].right_key = 'l';
+    g->tanks[1].fire_key = 'm';
+    g->tanks[1].health = MAX_HEALTH;
+    g->tanks[1].dir = LEFT;
+    
+    for (int i = NUM_PLAYERS; i < g->num_tanks; i++) {
+        int shot_speed = g->tanks[i].shot_speed; // Set for the whole game, not per round
+        memset(&g->tanks[i], 0, sizeof(Tank));
+        g->tanks[i].shot_speed = shot_speed;
+        g->tanks[i].symbol = '0' + i % 10;
+        g->tanks[i].health = MAX_HEALTH;
+        g->tanks[i].dir = (Direction)(i % 4);
+    }
+    
+    bind_keys(g);
+}
+
+// Function to add a wall to both wall layers (caller holds board_mutex or owns the game)
+void set_wall(GameState* g, int x, int y) {
+    bit_set(&g->walls, x, y);
+    bit_set(&g->walls_col, y, x);
+}
+
+// Function to initialize the board with walls
+void init_board(GameState* g, unsigned int seed) {
+    MapGenParams params;
+    map_gen_defaults(&params, seed);
+    
+    game_lock(g);
+    
+    // Scattered walls like a simple maze; the spawns are always joined and closed-off pockets filled in
+    map_generate(g, &params, NULL);
+    
+    // Bot spawns continue from the round seed
+    rng_seed(&g->rng, seed);
+    
+    game_unlock(g);
+}
+
+// Function to put a tank on a cell in the tank layers and the entity layer (caller holds board_mutex)
+static void put_tank(GameState* g, int i, int x, int y) {
+    g->tanks[i].x = x;
+    g->tanks[i].y = y;
+    bit_set(&g->tank_bits, x, y);
+    bit_set(&g->tank_bits_col, y, x);
+    ENTITY(g, x, y) = TANK_ENTITY(i);
+}
+
+// Function to take whatever tank is on a cell off the board (caller holds board_mutex)
+static void remove_tank(GameState* g, int x, int y) {
+    bit_clear(&g->tank_bits, x, y);
+    bit_clear(&g->tank_bits_col, y, x);
+    ENTITY(g, x, y) = NO_ENTITY;
+}
+
+// Function to place tanks on the board
+void place_tanks(GameState* g) {
+    game_lock(g);
+    
+    // Players start on their spawns (top-left and bottom-right unless the map says otherwise)
+    for (int i = 0; i < NUM_PLAYERS; i++) {
+        put_tank(g, i, g->spawn_x[i], g->spawn_y[i]);
+    }
+    
+    // Bots go on random free cells, continuing the board's random sequence
+    for (int i = NUM_PLAYERS; i < g->num_tanks; i++) {
+        int x = 0, y = 0;
+        int found = 0;
+        for (int attempt = 0; attempt < 1000 && !found; attempt++) {
+            x = rng_below(&g->rng, g->width - 2) + 1;
+            y = rng_below(&g->rng, g->height - 2) + 1;
+            found = !WALL_AT(g, x, y) && !TANK_AT(g, x, y);
+        }
+        for (int c = 0; c < g->width * g->height && !found; c++) {
+            x = c % g->width;
+            y = c / g->width;
+            found = !WALL_AT(g, x, y) && !TANK_AT(g, x, y);
+        }
+        if (!found) {
+            g->tanks[i].health = 0; // Board is full, the bot sits this round out
+            continue;
+        }
+        put_tank(g, i, x, y);
+    }
+    
+    g->tanks_alive = 0;
+    for (int i = 0; i < g->num_tanks; i++) {
+        g->tanks_alive += g->tanks[i].health > 0;
+    }
+    
+    game_unlock(g);
+}
+
+// Function to reset game state for a new game
+void reset_game(GameState* g, unsigned int seed) {
+    // Reset game state variables
+    reset_projectiles(g);
+    g->tick = 0;
+    g->projectile_steps = 0;
+    g->game_over = 0;
+    g->winner = -1;
+    
+    // Reset tank health and input (positions will be reset by place_tanks)
+    for (int i = 0; i < g->num_tanks; i++) {
+        g->tanks[i].health = MAX_HEALTH;
+        memset(&g->tanks[i].input, 0, sizeof(TankInput));
+        g->tanks[i].input.held_dir = -1;
+    }
+    
+    // Take the tanks off the board, walls are never changed during a round
+    for (int i = 0; i < g->num_tanks; i++) {
+        remove_tank(g, g->tanks[i].x, g->tanks[i].y);
+    }
+    
+    // Re-initialize board and place tanks
+    if (g->map_base) {
+        rng_seed(&g->rng, seed); // Map walls are read-only, bot spawns still come from the seed
+    } else {
+        init_board(g, seed);
+    }
+    place_tanks(g);
+    if (g->ai) {
+        ai_reset(g);
+    }
+    if (g->telemetry) {
+        g->match = telemetry_match(g->telemetry);
+        record(g, TELEMETRY_ROUND, g->num_tanks, TELEMETRY_ROUND_NEW, seed);
+    }
+}
+
+// Function to tell what is drawn on a cell: a wall, a tank's symbol, a projectile or floor (caller holds board_mutex)
+char cell_glyph(GameState* g, int x, int y) {
+    if (WALL_AT(g, x, y)) {
+        return WALL_CHAR;
+    }
+    if (TANK_AT(g, x, y)) {
+        return g->tanks[ENTITY_TANK(ENTITY(g, x, y))].symbol;
+    }
+    return SHOT_AT(g, x, y) ? PROJECTILE_CHAR : ' ';
+}
+
+// Function to count the free cells from (x, y) in a direction before the first wall (or tank), up to limit.
+// Scans the row or column layers a word at a time (caller holds board_mutex).
+int line_of_fire(GameState* g, int x, int y, Direction dir, int include_tanks, int limit) {
+    switch (dir) {
+        case UP:
+        case DOWN:
+            return bit_ray(&g->walls_col, include_tanks ? &g->tank_bits_col : NULL, x, y, dir == DOWN, limit);
+        case LEFT:
+        case RIGHT:
+            return bit_ray(&g->walls, include_tanks ? &g->tank_bits : NULL, y, x, dir == RIGHT, limit);
+    }
+    return 0;
+}
+
+// Function to check if a position is free to move onto (caller holds board_mutex)
+static int position_free(GameState* g, int x, int y) {
+    if (x < 0 || x >= g->width || y < 0 || y >= g->height) {
+        return 0; // Out of bounds
+    }
+    return !WALL_AT(g, x, y) && !TANK_AT(g, x, y); // Wall or another tank
+}
+
+// Function to check if a position is valid for movement
+int is_valid_position(GameState* g, int x, int y) {
+    game_lock(g);
+    int valid = position_free(g, x, y);
+    game_unlock(g);
+    
+    return valid;
+}
+
+// Function to move a tank (caller holds board_mutex).
+// The check and the move are one step, so two tanks can never take the same cell.
+static void move_tank_locked(GameState* g, Tank* tank, Direction dir) {
+    if (tank->health <= 0) {
+        return; // Destroyed tanks stay put
+    }
+    
+    // Always update the direction for aiming
+    tank->dir = dir;
+    
+    int new_x = tank->x;
+    int new_y = tank->y;
+    
+    // Calculate new position based on direction
+    switch (dir) {
+        case UP:
+            new_y--;
+            break;
+        case DOWN:
+            new_y++;
+            break;
+        case LEFT:
+            new_x--;
+            break;
+        case RIGHT:
+            new_x++;
+            break;
+    }
+    
+    // Check if the new position is valid
+    if (position_free(g, new_x, new_y)) {
+        // Clear old position
+        remove_tank(g, tank->x, tank->y);
+        
+        // Place tank at new position
+        put_tank(g, (int)(tank - g->tanks), new_x, new_y);
+        record(g, TELEMETRY_MOVE, (int)(tank - g->tanks), dir, (uint32_t)new_x | (uint32_t)new_y << 16);
+    }
+}
+
+// Function to move a tank
+void move_tank(GameState* g, Tank* tank, Direction dir) {
+    game_lock(g);
+    move_tank_locked(g, tank, dir);
+    game_unlock(g);
+}
+
+// Function to mirror a tank of a remote game: put it on (x, y) with this health, or off the board if destroyed
+void sync_tank(GameState* g, int i, int x, int y, int health) {
+    Tank* tank = &g->tanks[i];
+    
+    game_lock(g);
+    
+    // Another tank may already have moved onto the old cell in the same update
+    if (tank->health > 0 && ENTITY(g, tank->x, tank->y) == TANK_ENTITY(i)) {
+        remove_tank(g, tank->x, tank->y);
+    }
+    tank->health = health;
+    tank->x = x;
+    tank->y = y;
+    if (health > 0) {
+        put_tank(g, i, x, y);
+    }
+    
+    game_unlock(g);
+}
+
+// Function to build a handle for a pool slot
+ProjectileHandle projectile_handle(GameState* g, int slot) {
+    return ((ProjectileHandle)g->projectiles[slot].generation << 16) | (ProjectileHandle)slot;
+}
+
+// Function to resolve a handle, returns NULL if the slot was released since
+Projectile* projectile_get(GameState* g, ProjectileHandle handle) {
+    int slot = handle & 0xFFFF;
+    if (handle == PROJECTILE_NONE || slot >= g->projectile_hwm) {
+        return NULL;
+    }
+    Projectile* proj = &g->projectiles[slot];
+    if (!proj->active || proj->generation != (uint16_t)(handle >> 16)) {
+        return NULL; // Stale handle
+    }
+    return proj;
+}
+
+// Function to empty the projectile pool (caller holds board_mutex or owns the game)
+void reset_projectiles(GameState* g) {
+    for (int i = 0; i < g->projectile_hwm; i++) {
+        g->projectiles[i].active = 0;
+        g->projectiles[i].generation++;
+    }
+    memset(g->active_slots, 0, (size_t)(g->projectile_hwm + 63) / 64 * sizeof(uint64_t));
+    g->num_free = 0;
+    g->projectile_hwm = 0;
+    g->num_projectiles = 0;
+    memset(g->shot_bits.bits, 0, (size_t)g->shot_bits.stride * g->height * sizeof(uint64_t));
+}
+
+// Function to take a free slot from the pool (caller holds board_mutex)
+static int alloc_projectile_slot(GameState* g) {
+    if (g->num_free > 0) {
+        return g->free_slots[--g->num_free];
+    }
+    if (g->projectile_hwm < g->max_projectiles) {
+        return g->projectile_hwm++;
+    }
+    return -1; // Pool exhausted
+}
+
+// Function to return a slot to the pool (caller holds board_mutex).
+// The shot layer is rebuilt by simulation_tick(), so the projectile's bit is left alone.
+static void release_projectile(GameState* g, int slot) {
+    Projectile* proj = &g->projectiles[slot];
+    
+    proj->active = 0;
+    proj->generation++; // Invalidate outstanding handles
+    g->active_slots[slot / 64] &= ~(1ULL << (slot % 64));
+    g->free_slots[g->num_free++] = (uint16_t)slot;
+    g->num_projectiles--;
+}
+
+// Function to take a tank off the board and end the round when one is left (caller holds board_mutex)
+static void destroy_tank(GameState* g, int i) {
+    Tank* tank = &g->tanks[i];
+    
+    remove_tank(g, tank->x, tank->y);
+    tank->input.held_dir = -1;
+    tank->input.fire_held = 0;
+    tank->input.keys_down = 0;
+    g->tanks_alive--;
+    
+    if (g->tanks_alive <= 1) {
+        g->game_over = 1;
+        // Set the winner to the last tank standing
+        g->winner = -1;
+        for (int j = 0; j < g->num_tanks; j++) {
+            if (g->tanks[j].health > 0) {
+                g->winner = j;
+                break;
+            }
+        }
+        record(g, TELEMETRY_ROUND_END, g->winner >= 0 ? g->winner : 0xFFFF, 0, g->tick);
+    }
+}
+
+// Function to find the cell a fixed-point coordinate is in, also for the negative ones just off the board
+static inline int fix_cell(int32_t f) {
+    return f >= 0 ? f >> FIX_SHIFT : -((-f + FIX_ONE - 1) >> FIX_SHIFT);
+}
+
+// Function to tell when during the tick a projectile leaves cell c along one axis, in sweep time.
+// Only called when it does leave: it moves on at least to the next cell by the end of the tick.
+static uint32_t leave_time(int32_t f, int32_t v, int c) {
+    int64_t distance = v > 0 ? ((int64_t)(c + 1) << FIX_SHIFT) - f : f - ((int64_t)c << FIX_SHIFT) + 1;
+    return (uint32_t)(distance * SWEEP_TIME / (v > 0 ? v : -v));
+}
+
+// Function to make room for the segments of this tick, growing the segment array and the cell hash together
+static int sweep_reserve(Sweep* s, int segments) {
+    if (segments <= s->max_segments) {
+        return 0;
+    }
+    int max = s->max_segments ? s->max_segments : HASH_MIN_BUCKETS / 2;
+    while (max < segments) {
+        max *= 2;
+    }
+    Segment* seg = realloc(s->segments, (size_t)max * sizeof(Segment));
+    if (!seg) {
+        return -1;
+    }
+    s->segments = seg;
+    Group* groups = realloc(s->groups, (size_t)max * sizeof(Group));
+    if (!groups) {
+        return -1;
+    }
+    s->groups = groups;
+    
+    // Twice as many buckets as segments keeps the chains short
+    size_t buckets = (size_t)max * 2;
+    int32_t* head = realloc(s->bucket_head, buckets * sizeof(int32_t));
+    if (!head) {
+        return -1;
+    }
+    s->bucket_head = head;
+    uint32_t* stamp = realloc(s->bucket_stamp, buckets * sizeof(uint32_t));
+    if (!stamp) {
+        return -1;
+    }
+    s->bucket_stamp = stamp;
+    memset(s->bucket_stamp, 0, buckets * sizeof(uint32_t));
+    s->stamp = 0;
+    s->mask = (uint32_t)buckets - 1;
+    s->max_segments = max;
+    return 0;
+}
+
+// Function to keep a meeting if it is the projectile's earliest, the lower slot winning a tie
+static inline void meet(SweepEnd* e, uint32_t t, int with) {
+    if (t < e->hit_t || (t == e->hit_t && with < e->hit)) {
+        e->hit_t = t;
+        e->hit = with;
+    }
+}
+
+// Function to record a projectile being in a cell from t0 to t1, checking other tanks' shots in the cell for a meeting.
+// Only each projectile's earliest meeting is kept. A segment after a projectile's meeting can never matter, so it is
+// not added, and one already passed is unlinked as the cell is walked; the walk of a cell stops once nothing in it
+// can meet this projectile earlier. A crowded cell costs about one step per segment, not one per pair.
+static void add_segment(Sweep* s, int slot, int owner, int32_t cell, uint32_t t0, uint32_t t1) {
+    SweepEnd* e = &s->end[slot];
+    if (s->num_segments == s->max_segments || e->hit_t <= t0) {
+        return; // The reserve failed and impacts are skipped this tick, or the projectile is gone by now
+    }
+    uint32_t b = ((uint32_t)cell * 0x9E3779B1u) & s->mask;
+    if (s->bucket_stamp[b] != s->stamp) {
+        s->bucket_stamp[b] = s->stamp;
+        s->bucket_head[b] = -1;
+    }
+    int32_t own = -1;
+    for (int32_t i = s->bucket_head[b]; i >= 0; i = s->groups[i].next) {
+        Group* group = &s->groups[i];
+        if (group->cell != cell) {
+            continue;
+        }
+        if (group->owner == owner) {
+            own = i;
+            continue;
+        }
+        for (int32_t* link = &group->first; *link >= 0 && e->hit_t > t0; ) {
+            Segment* other = &s->segments[*link];
+            SweepEnd* o = &s->end[other->slot];
+            if (o->hit_t <= other->t0) {
+                *link = other->next; // It met another projectile before it got here
+                continue;
+            }
+            if (other->t0 <= t1 && t0 <= other->t1) {
+                uint32_t t = other->t0 > t0 ? other->t0 : t0;
+                meet(e, t, other->slot);
+                meet(o, t, slot);
+            }
+            link = &other->next;
+        }
+    }
+    if (own < 0) {
+        own = s->num_groups++;
+        s->groups[own] = (Group){ cell, owner, -1, s->bucket_head[b] };
+        s->bucket_head[b] = own;
+    }
+    int i = s->num_segments++;
+    s->segments[i] = (Segment){ s->groups[own].first, (uint16_t)slot, (uint16_t)t0, (uint16_t)t1 };
+    s->groups[own].first = i;
+}
+
+// Function to sweep one projectile along its path for this tick (caller holds board_mutex).
+// Every cell crossed is visited in order, however fast the projectile is, so it cannot tunnel through a
+// wall or a tank; the cells it passes are hashed for projectile impacts.
+static void sweep_projectile(GameState* g, Sweep* s, int slot) {
+    Projectile* proj = &g->projectiles[slot];
+    SweepEnd* e = &s->end[slot];
+    int x = proj->x, y = proj->y;
+    int end_x = fix_cell(proj->fx + proj->vx), end_y = fix_cell(proj->fy + proj->vy);
+    uint32_t t = 0;
+    
+    e->stop = SWEEP_FLYING;
+    e->cells = 0;
+    e->hit_t = SWEEP_NEVER;
+    while (x != end_x || y != end_y) {
+        uint32_t tx = x != end_x ? leave_time(proj->fx, proj->vx, x) : UINT32_MAX;
+        uint32_t ty = y != end_y ? leave_time(proj->fy, proj->vy, y) : UINT32_MAX;
+        int nx = x, ny = y;
+        uint32_t next = tx <= ty ? tx : ty;
+        if (tx <= ty) {
+            nx += proj->vx > 0 ? 1 : -1;
+        } else {
+            ny += proj->vy > 0 ? 1 : -1;
+        }
+        add_segment(s, slot, proj->owner, y * g->width + x, t, next);
+        t = next;
+        
+        if (nx < 0 || nx >= g->width || ny < 0 || ny >= g->height || WALL_AT(g, nx, ny)) {
+            e->stop = SWEEP_WALL; // Stays in the last free cell
+            break;
+        }
+        x = nx;
+        y = ny;
+        e->cells++;
+        if (TANK_AT(g, x, y)) {
+            e->stop = SWEEP_TANK;
+            e->tank = ENTITY_TANK(ENTITY(g, x, y));
+            break;
+        }
+    }
+    if (e->stop == SWEEP_FLYING) {
+        add_segment(s, slot, proj->owner, y * g->width + x, t, SWEEP_TIME);
+    }
+    e->x = x;
+    e->y = y;
+}
+
+// Function to end a projectile where its sweep stopped it, or move it to where it got (caller holds board_mutex).
+// Two projectiles whose earliest meetings are each other destroy each other; one whose first meeting was taken
+// by an earlier one flies on.
+static void finish_projectile(GameState* g, Sweep* s, int slot) {
+    Projectile* proj = &g->projectiles[slot];
+    SweepEnd* e = &s->end[slot];
+    
+    if (e->hit_t != SWEEP_NEVER && s->end[e->hit].hit == slot) {
+        e->stop = SWEEP_SHOT;
+    }
+    g->projectile_steps += e->cells;
+    switch (e->stop) {
+        case SWEEP_FLYING:
+            proj->fx += proj->vx;
+            proj->fy += proj->vy;
+            proj->x = e->x;
+            proj->y = e->y;
+            bit_set(&g->shot_bits, proj->x, proj->y);
+            return;
+        case SWEEP_WALL:
+            record(g, TELEMETRY_PROJECTILE_END, proj->owner, TELEMETRY_END_WALL, g->tick - proj->fired);
+            break;
+        case SWEEP_SHOT:
+            record(g, TELEMETRY_PROJECTILE_END, proj->owner, TELEMETRY_END_SHOT, g->tick - proj->fired);
+            break;
+        case SWEEP_TANK: {
+            // A tank destroyed earlier this tick still stops the projectiles already on their way into it
+            int i = e->tank;
+            if (proj->owner != i && g->tanks[i].health > 0) {
+                g->tanks[i].health--;
+                record(g, TELEMETRY_HIT, i, g->tanks[i].health, proj->owner);
+                if (g->tanks[i].health <= 0) {
+                    destroy_tank(g, i);
+                }
+            }
+            record(g, TELEMETRY_PROJECTILE_END, proj->owner, TELEMETRY_END_TANK, g->tick - proj->fired);
+            break;
+        }
+    }
+    release_projectile(g, slot);
+}
+
+// Function to move every projectile in flight by one tick (caller holds board_mutex).
+// All of them are swept first, against walls and tanks as they stand; then two projectiles whose earliest meetings
+// are each other destroy each other, and last the survivors move and the rest hit what stopped them, in slot order.
+static void move_projectiles(GameState* g) {
+    Sweep* s = g->sweep;
+    int words = (g->projectile_hwm + 63) / 64;
+    
+    // Several projectiles can share a cell, so lift them all off the shot layer and put back the survivors
+    int segments = 0;
+    for (int w = 0; w < words; w++) {
+        for (uint64_t bits = g->active_slots[w]; bits; bits &= bits - 1) {
+            Projectile* proj = &g->projectiles[w * 64 + __builtin_ctzll(bits)];
+            bit_clear(&g->shot_bits, proj->x, proj->y);
+            segments += (abs(proj->vx) + abs(proj->vy)) / FIX_ONE + 3;
+        }
+    }
+    if (sweep_reserve(s, segments) < 0) {
+        s->num_segments = s->max_segments; // Out of memory: projectiles still move, without impacts
+    } else {
+        s->num_segments = 0;
+        s->num_groups = 0;
+        if (++s->stamp == 0) {
+            memset(s->bucket_stamp, 0, ((size_t)s->mask + 1) * sizeof(uint32_t));
+            s->stamp = 1;
+        }
+    }
+    
+    for (int w = 0; w < words; w++) {
+        for (uint64_t bits = g->active_slots[w]; bits; bits &= bits - 1) {
+            sweep_projectile(g, s, w * 64 + __builtin_ctzll(bits));
+        }
+    }
+    
+    // Releasing clears bits of the word being walked, so each word is copied first. Survivors go back on the
+    // shot layer as they move; a round that ends midway puts the rest back where they stand.
+    for (int w = 0; w < words && !g->game_over; w++) {
+        for (uint64_t bits = g->active_slots[w]; bits && !g->game_over; bits &= bits - 1) {
+            int slot = w * 64 + __builtin_ctzll(bits);
+            finish_projectile(g, s, slot);
+        }
+    }
+    for (int w = 0; w < words && g->game_over; w++) {
+        for (uint64_t bits = g->active_slots[w]; bits; bits &= bits - 1) {
+            Projectile* proj = &g->projectiles[w * 64 + __builtin_ctzll(bits)];
+            bit_set(&g->shot_bits, proj->x, proj->y);
+        }
+    }
+}
+
+// Function to fire a projectile (caller holds board_mutex)
+static ProjectileHandle fire_projectile_locked(GameState* g, Tank* tank) {
+    if (tank->health <= 0) {
+        return PROJECTILE_NONE;
+    }
+    
+    // Find the starting position for the projectile
+    int proj_x = tank->x;
+    int proj_y = tank->y;
+    
+    // Move the projectile one step in the tank's direction to prevent hitting the tank
+    switch (tank->dir) {
+        case UP:
+            proj_y--;
+            break;
+        case DOWN:
+            proj_y++;
+            break;
+        case LEFT:
+            proj_x--;
+            break;
+        case RIGHT:
+            proj_x++;
+            break;
+    }
+    
+    // Check if the position is valid
+    if (proj_x < 0 || proj_x >= g->width || proj_y < 0 || proj_y >= g->height ||
+        WALL_AT(g, proj_x, proj_y) || TANK_AT(g, proj_x, proj_y)) {
+        return PROJECTILE_NONE; // Can't fire
+    }
+    
+    int slot = alloc_projectile_slot(g);
+    if (slot < 0) {
+        return PROJECTILE_NONE; // Too many projectiles
+    }
+    
+    // Create a new projectile
+    Projectile* proj = &g->projectiles[slot];
+    proj->x = proj_x;
+    proj->y = proj_y;
+    proj->dir = tank->dir;
+    proj->active = 1;
+    proj->owner = (int)(tank - g->tanks);
+    proj->fired = g->tick;
+    g->active_slots[slot / 64] |= 1ULL << (slot % 64);
+    g->num_projectiles++;
+    
+    // It enters its cell from the tank's side, so it crosses a cell every FIX_ONE / speed ticks whichever way it flies
+    int speed = tank->shot_speed ? tank->shot_speed : g->projectile_speed;
+    proj->fx = (proj_x << FIX_SHIFT) + FIX_ONE / 2;
+    proj->fy = (proj_y << FIX_SHIFT) + FIX_ONE / 2;
+    proj->vx = proj->vy = 0;
+    switch (tank->dir) {
+        case UP:
+            proj->fy = (proj_y << FIX_SHIFT) + FIX_ONE - 1;
+            proj->vy = -speed;
+            break;
+        case DOWN:
+            proj->fy = proj_y << FIX_SHIFT;
+            proj->vy = speed;
+            break;
+        case LEFT:
+            proj->fx = (proj_x << FIX_SHIFT) + FIX_ONE - 1;
+            proj->vx = -speed;
+            break;
+        case RIGHT:
+            proj->fx = proj_x << FIX_SHIFT;
+            proj->vx = speed;
+            break;
+    }
+    record(g, TELEMETRY_SHOT, proj->owner, proj->dir, (uint32_t)proj_x | (uint32_t)proj_y << 16);
+    
+    // Place projectile on board
+    bit_set(&g->shot_bits, proj->x, proj->y);
+    
+    return projectile_handle(g, slot);
+}
+
+// Function to fire a projectile
+ProjectileHandle fire_projectile(GameState* g, Tank* tank) {
+    game_lock(g);
+    ProjectileHandle handle = fire_projectile_locked(g, tank);
+    game_unlock(g);
+    
+    return handle;
+}
+
+// Function to act on held keys once per tick, releasing keys whose repeats stopped.
+// Keys may arrive from other threads, so the whole pass is made under one hold of board_mutex.
+static void apply_held_input(GameState* g) {
+    game_lock(g);
+    for (int i = 0; i < g->num_tanks; i++) {
+        Tank* tank = &g->tanks[i];
+        TankInput* in = &tank->input;
+        
+        if (in->held_dir >= 0) {
+            if (g->tick - in->dir_seen > HOLD_TICKS && !(in->keys_down >> in->held_dir & 1)) {
+                in->held_dir = -1; // No repeat arrived, treat the key as released
+            } else if (g->tick >= in->next_move) {
+                move_tank_locked(g, tank, (Direction)in->held_dir);
+                in->next_move = g->tick + g->move_ticks;
+            }
+        }
+        
+        if (in->fire_held) {
+            if (g->tick - in->fire_seen > HOLD_TICKS && !(in->keys_down >> ACTION_FIRE & 1)) {
+                in->fire_held = 0;
+            } else if (g->tick >= in->next_fire) {
+                fire_projectile_locked(g, tank);
+                in->next_fire = g->tick + g->fire_ticks;
+            }
+        }
+    }
+    game_unlock(g);
+}
+
+// Function to run one fixed-timestep simulation tick
+void simulation_tick(GameState* g) {
+    long long start = perf_start();
+    long long span = trace_begin();
+    long long timed = g->telemetry ? perf_clock() : 0;
+    
+    // Key presses from other threads read the tick under board_mutex
+    game_lock(g);
+    g->tick++;
+    game_unlock(g);
+    
+    // AI tanks decide first, then both players act in the same tick, whatever order their keys arrived in
+    if (g->ai) {
+        ai_tick(g);
+    }
+    apply_held_input(g);
+    
+    game_lock(g);
+    
+    // Projectiles move every tick, each at its own speed
+    if (g->num_projectiles > 0) {
+        move_projectiles(g);
+    }
+    
+    int in_flight = g->num_projectiles;
+    game_unlock(g);
+    perf_sample(PERF_PROJECTILES, in_flight);
+    perf_end(PERF_TICK, start);
+    trace_end("tick", span);
+    if (g->telemetry) {
+        record(g, TELEMETRY_TICK, in_flight < 0xFFFF ? in_flight : 0xFFFF, 0, (uint32_t)(perf_clock() - timed));
+    }
+}
+
+// Function to record a key into its tank's input state, acting at once if the rate allows
+static void press_direction(GameState* g, Tank* tank, Direction dir) {
+    TankInput* in = &tank->input;
+    
+    game_lock(g);
+    in->held_dir = dir;
+    in->dir_seen = g->tick;
+    if (g->tick >= in->next_move) {
+        move_tank_locked(g, tank, dir);
+        in->next_move = g->tick + g->move_ticks;
+    }
+    game_unlock(g);
+}
+
+// Function to record a fire key, firing at once if the rate allows
+static void press_fire(GameState* g, Tank* tank) {
+    TankInput* in = &tank->input;
+    
+    game_lock(g);
+    in->fire_held = 1;
+    in->fire_seen = g->tick;
+    if (g->tick >= in->next_fire) {
+        fire_projectile_locked(g, tank);
+        in->next_fire = g->tick + g->fire_ticks;
+    }
+    game_unlock(g);
+}
+
+// Function to carry out one decision of a program-driven tank, at the rates a held key gets (caller holds board_mutex)
+void tank_drive_locked(GameState* g, int tank, Action action) {
+    Tank* t = &g->tanks[tank];
+    TankInput* in = &t->input;
+    
+    if (t->health <= 0 || g->game_over) {
+        return;
+    }
+    if (action == ACTION_FIRE) {
+        if (g->tick >= in->next_fire) {
+            fire_projectile_locked(g, t);
+            in->next_fire = g->tick + g->fire_ticks;
+        }
+    } else if (g->tick >= in->next_move) {
+        move_tank_locked(g, t, (Direction)action);
+        in->next_move = g->tick + g->move_ticks;
+    }
+}
+
+// Function to press the key of an action
+static void press(GameState* g, int tank, Action action) {
+    if (action == ACTION_FIRE) {
+        press_fire(g, &g->tanks[tank]);
+    } else {
+        press_direction(g, &g->tanks[tank], (Direction)action);
+    }
+}
+
+// Function to apply one action to a tank through its input state
+void tank_action(GameState* g, int tank, Action action) {
+    if (tank < 0 || tank >= g->num_tanks) {
+        return;
+    }
+    if (g->log) {
+        log_action(g->log, g->tick, tank, action);
+    }
+    press(g, tank, action);
+}
+
+// Function to apply a key going down or up, from a backend that sees real key state.
+// A key that is down stays held without repeats; releasing the held direction falls back to another one still down.
+void tank_key(GameState* g, int tank, Action action, int down) {
+    if (tank < 0 || tank >= g->num_tanks || action >= NUM_ACTIONS) {
+        return;
+    }
+    if (g->log) {
+        log_key(g->log, g->tick, tank, action, down);
+    }
+    TankInput* in = &g->tanks[tank].input;
+    
+    game_lock(g);
+    if (down) {
+        in->keys_down |= 1u << action;
+    } else {
+        in->keys_down &= ~(1u << action);
+        if (action == ACTION_FIRE) {
+            in->fire_held = 0;
+        } else if (in->held_dir == (int)action) {
+            in->held_dir = -1;
+            for (int d = UP; d <= RIGHT && g->tanks[tank].health > 0; d++) {
+                if (in->keys_down >> d & 1) {
+                    in->held_dir = d;
+                    break;
+                }
+            }
+        }
+    }
+    game_unlock(g);
+    
+    if (down) {
+        press(g, tank, action);
+    }
+}
+
+// Function to handle keyboard input (auto-repeat only refreshes the held state)
+void handle_input(GameState* g, int ch) {
+    if (ch < 0 || ch >= KEY_MAP_SIZE || g->key_tank[ch] < 0) {
+        return; // Not bound to any tank
+    }
+    tank_action(g, g->key_tank[ch], (Action)g->key_action[ch]);
+}
+
+// Function to tell whether ticks are needed (projectiles in flight, keys held, AI or plugin tanks playing)
+int simulation_active(GameState* g) {
+    if (g->num_projectiles > 0 || g->ai || g->bot_driven) {
+        return 1;
+    }
+    for (int i = 0; i < g->num_tanks; i++) {
+        if (g->tanks[i].input.held_dir >= 0 || g->tanks[i].input.fire_held) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+#ifndef TANK_GAME_H
+#define TANK_GAME_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "rng.h"
+#include "perf.h"
+#include "trace.h"
+
+// Constants
+#define NUM_PLAYERS 2 // Keyboard-controlled tanks, always the first ones
+#define MAX_TANKS 1024 // Upper bound for extra (bot) tanks
+#define MAX_PROJECTILES 1024 // Default pool size
+#define BOARD_HEIGHT 20 // Default board size
+#define BOARD_WIDTH 60
+#define WALL_CHAR '#'
+#define PROJECTILE_CHAR '.'
+#define MAX_HEALTH 10
+#define TICK_USEC 50000 // fixed simulation timestep
+#define TICKS_PER_SEC (1000000 / TICK_USEC)
+#define FIX_SHIFT 8 // Projectile positions and velocities are fixed-point, in 1/256 of a cell
+#define FIX_ONE (1 << FIX_SHIFT)
+#define PROJECTILE_SPEED 10 // default cells per second
+#define PROJECTILE_MAX_SPEED (8 * FIX_ONE) // fastest shot in fixed-point cells per tick, bounds the cells swept per tick
+#define MOVE_RATE 10 // default moves per second while a direction is held
+#define FIRE_RATE 5 // default shots per second while fire is held
+#define HOLD_TICKS 3 // a key counts as held until this many ticks pass without a repeat
+
+// Direction enum
+typedef enum {
+    UP, DOWN, LEFT, RIGHT
+} Direction;
+
+// Tank actions, the first four share their values with Direction
+typedef enum {
+    ACTION_UP, ACTION_DOWN, ACTION_LEFT, ACTION_RIGHT, ACTION_FIRE, NUM_ACTIONS
+} Action;
+
+// Per-tank input state, coalesced from however many keys arrived between ticks
+typedef struct {
+    int held_dir; // Direction being held, -1 if none
+    int fire_held;
+    unsigned long dir_seen, fire_seen; // Tick of the last key seen for each
+    unsigned long next_move, next_fire; // Earliest tick the next action may happen
+    unsigned int keys_down; // Bit per Action whose key is down by real key state (evdev), held without repeats
+} TankInput;
+
+// Tank structure
+typedef struct {
+    char symbol;
+    int x, y;
+    int health;
+    Direction dir;
+    char up_key, down_key, left_key, right_key, fire_key;
+    TankInput input;
+    int shot_speed; // Speed of its projectiles in fixed-point cells per tick, 0 for the game's default
+} Tank;
+
+// Projectile structure (one slot of the projectile pool)
+typedef struct {
+    int x, y; // Cell the projectile is in
+    int32_t fx, fy; // Position, fixed-point
+    int32_t vx, vy; // Velocity, fixed-point cells per tick
+    Direction dir;
+    int active;
+    int owner; // Index of the tank that fired this projectile
+    unsigned long fired; // Tick it was fired on
+    uint16_t generation; // Bumped every time the slot is released
+} Projectile;
+
+// Handle to a pool slot: slot index in the low 16 bits, generation in the high 16
+typedef uint32_t ProjectileHandle;
+#define PROJECTILE_NONE ((ProjectileHandle)0xFFFFFFFFu)
+#define PROJECTILE_POOL_LIMIT 0xFFFF // Largest pool a 16-bit slot index can address
+
+// Entity IDs stored in GameState.entity: 0 is empty, tank i is i + 1
+typedef uint16_t EntityId;
+#define NO_ENTITY 0
+#define TANK_ENTITY(i) ((EntityId)((i) + 1))
+#define ENTITY_TANK(e) ((int)(e) - 1)
+
+#define KEY_MAP_SIZE 256 // Keys bound to tanks are plain characters
+
+struct GameLog;
+struct Ai;
+struct Telemetry;
+struct Sweep;
+
+// Game state structure.
+// The board is kept as bit layers, one bit per cell. Walls and tanks are kept both by row
+// and by column so rays in any direction scan 64 cells per word.
+typedef struct {
+    int width, height;
+    BitLayer walls, walls_col; // Static for the whole game
+    BitLayer tank_bits, tank_bits_col;
+    BitLayer shot_bits; // Cells holding at least one projectile
+    char* map_base; // Mapping the walls live in when loaded from a map file, else NULL
+    size_t map_size;
+    int spawn_x[NUM_PLAYERS], spawn_y[NUM_PLAYERS];
+    EntityId* entity; // Which tank occupies each cell, height * width row-major
+    Tank* tanks;
+    int num_tanks;
+    int tanks_alive;
+    int16_t key_tank[KEY_MAP_SIZE]; // Tank bound to each key, -1 if none
+    uint8_t key_action[KEY_MAP_SIZE];
+    Projectile* projectiles;
+    uint16_t* free_slots; // Stack of released slot indices
+    int max_projectiles;
+    int num_free;
+    int projectile_hwm; // Slots [0, projectile_hwm) have been handed out at least once
+    int num_projectiles; // Number of active projectiles
+    uint64_t* active_slots; // Bit per pool slot in flight, so a tick visits active projectiles only
+    struct Sweep* sweep; // Scratch of the projectile pass: swept cells, the cell hash and the impacts found
+    int projectile_speed; // Default speed of new projectiles, fixed-point cells per tick
+    unsigned long tick; // Simulation ticks since the round started
+    unsigned long projectile_steps; // Projectile cell advances since the round started
+    int move_ticks; // Ticks between moves while a direction is held
+    int fire_ticks; // Ticks between shots while fire is held
+    int game_over;
+    int winner; // Index of winning tank (-1 if no winner yet)
+    Rng rng; // Board and spawn randomness, reseeded every round
+    struct GameLog* log; // Every tank_action() is recorded here when set
+    struct Ai* ai; // Drives the bots (and optionally players) every tick when set
+    uint8_t* bot_driven; // Per tank, non-zero when a bot plugin drives it instead of the AI; NULL without plugins
+    struct Telemetry* telemetry; // Match events and tick timings are recorded here when set
+    uint32_t match; // Telemetry number of the round in progress
+    pthread_mutex_t board_mutex;
+    long long lock_since; // When board_mutex was taken, for the hold-time counter
+} GameState;
+
+// Cell access, x is the column and y the row
+#define WALL_AT(g, x, y) bit_test(&(g)->walls, (x), (y))
+#define TANK_AT(g, x, y) bit_test(&(g)->tank_bits, (x), (y))
+#define SHOT_AT(g, x, y) bit_test(&(g)->shot_bits, (x), (y))
+#define ENTITY(g, x, y) ((g)->entity[(size_t)(y) * (g)->width + (x)])
+
+// Function to take board_mutex, timing the wait and the hold when counters or tracing are on
+static inline void game_lock(GameState* g) {
+    if (!(perf_enabled | trace_enabled)) {
+        pthread_mutex_lock(&g->board_mutex);
+        return;
+    }
+    long long t0 = perf_clock();
+    pthread_mutex_lock(&g->board_mutex);
+    g->lock_since = perf_clock();
+    if (perf_enabled) {
+        perf_record(PERF_LOCK_WAIT, g->lock_since - t0);
+    }
+    if (trace_enabled) {
+        trace_record("lock wait", t0, g->lock_since - t0);
+    }
+}
+
+// Function to release board_mutex
+static inline void game_unlock(GameState* g) {
+    if (g->lock_since) {
+        long long now = perf_clock();
+        if (perf_enabled) {
+            perf_record(PERF_LOCK_HOLD, now - g->lock_since);
+        }
+        if (trace_enabled) {
+            trace_record("lock hold", g->lock_since, now - g->lock_since);
+        }
+        g->lock_since = 0;
+    }
+    pthread_mutex_unlock(&g->board_mutex);
+}
+
+// Lifetime
+int game_init(GameState* g, int width, int height, int max_projectiles, int num_tanks);
+int game_init_with_walls(GameState* g, int width, int height, int max_projectiles, int num_tanks,
+                         uint64_t* walls, uint64_t* walls_col);
+void game_free(GameState* g);
+
+// Setup
+void setup_tanks(GameState* g, char p1_char, char p2_char);
+void init_board(GameState* g, unsigned int seed);
+void place_tanks(GameState* g);
+void reset_game(GameState* g, unsigned int seed);
+void set_input_rates(GameState* g, int moves_per_sec, int shots_per_sec);
+void set_projectile_speed(GameState* g, int tank, int cells_per_sec);
+
+// Board queries
+char cell_glyph(GameState* g, int x, int y);
+int line_of_fire(GameState* g, int x, int y, Direction dir, int include_tanks, int limit);
+void set_wall(GameState* g, int x, int y);
+
+// Simulation. Moves, shots and tank_action() take board_mutex and may come from any thread while another ticks,
+// as long as no log is attached; setup and reset_game() need the game to themselves.
+int is_valid_position(GameState* g, int x, int y);
+void move_tank(GameState* g, Tank* tank, Direction dir);
+void sync_tank(GameState* g, int i, int x, int y, int health);
+ProjectileHandle fire_projectile(GameState* g, Tank* tank);
+void simulation_tick(GameState* g);
+void tank_action(GameState* g, int tank, Action action);
+void tank_drive_locked(GameState* g, int tank, Action action);
+void tank_key(GameState* g, int tank, Action action, int down);
+void handle_input(GameState* g, int ch);
+int simulation_active(GameState* g);
+
+// Projectile pool
+ProjectileHandle projectile_handle(GameState* g, int slot);
+Projectile* projectile_get(GameState* g, ProjectileHandle handle);
+void reset_projectiles(GameState* g);
+
+#endif
@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "gamelog.h"
+#include "map.h"
+#include "ai.h"
+
+// Function to write an unsigned LEB128 varint
+static void put_varint(FILE* f, uint64_t v) {
+    while (v >= 0x80) {
+        putc((int)(v & 0x7F) | 0x80, f);
+        v >>= 7;
+    }
+    putc((int)v, f);
+}
+
+// Function to start a record: tick delta since the previous record and the record kind
+static void put_record(GameLog* log, unsigned long tick, LogRecord kind) {
+    put_varint(log->f, ((uint64_t)(tick - log->last_tick) << 2) | kind);
+    log->last_tick = tick;
+}
+
+// Function to create a log file and write its header
+int log_open(GameLog* log, const char* path, GameState* g, const char* map_path) {
+    LogHeader hdr;
+    size_t path_len = map_path ? strlen(map_path) : 0;
+    
+    memset(log, 0, sizeof(GameLog));
+    if (path_len > UINT16_MAX) {
+        return -1;
+    }
+    
+    log->f = fopen(path, "wb");
+    if (!log->f) {
+        return -1;
+    }
+    log->buffer = malloc(LOG_BUFFER_SIZE);
+    if (log->buffer) {
+        setvbuf(log->f, log->buffer, _IOFBF, LOG_BUFFER_SIZE);
+    }
+    
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, LOG_MAGIC, 4);
+    hdr.version = LOG_VERSION;
+    hdr.header_size = sizeof(hdr);
+    hdr.width = g->width;
+    hdr.height = g->height;
+    hdr.num_tanks = g->num_tanks;
+    hdr.max_projectiles = g->max_projectiles;
+    hdr.move_ticks = g->move_ticks;
+    hdr.fire_ticks = g->fire_ticks;
+    hdr.ai = g->ai ? 1 + g->ai->players : 0;
+    hdr.map_path_len = path_len;
+    hdr.projectile_speed = g->projectile_speed;
+    
+    if (fwrite(&hdr, sizeof(hdr), 1, log->f) != 1 || fwrite(map_path, 1, path_len, log->f) != path_len) {
+        log_close(log);
+        return -1;
+    }
+    for (int i = 0; i < g->num_tanks; i++) {
+        uint16_t speed = g->tanks[i].shot_speed;
+        if (fwrite(&speed, sizeof(speed), 1, log->f) != 1) {
+            log_close(log);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to record the start of a round (after reset_game() with this seed)
+void log_round(GameLog* log, GameState* g, unsigned int seed) {
+    log->last_tick = 0;
+    put_record(log, 0, LOG_ROUND);
+    put_varint(log->f, seed);
+    putc(g->tanks[0].symbol, log->f);
+    putc(g->tanks[1].symbol, log->f);
+    log->rounds++;
+}
+
+// Function to record one tank action at the tick it was applied in
+void log_action(GameLog* log, unsigned long tick, int tank, Action action) {
+    put_record(log, tick, LOG_ACTION);
+    put_varint(log->f, (uint64_t)tank * NUM_ACTIONS + action);
+    log->events++;
+}
+
+// Function to record a key going down or up at the tick it was applied in
+void log_key(GameLog* log, unsigned long tick, int tank, Action action, int down) {
+    put_record(log, tick, LOG_KEY);
+    put_varint(log->f, ((uint64_t)tank * NUM_ACTIONS + action) << 1 | (down != 0));
+    log->events++;
+}
+
+// Function to record where a round ended and what the board looked like, then flush
+void log_round_end(GameLog* log, GameState* g) {
+    uint64_t hash = game_state_hash(g);
+    
+    put_record(log, g->tick, LOG_END);
+    fwrite(&hash, sizeof(hash), 1, log->f);
+    fflush(log->f);
+}
+
+// Function to flush and close a log
+int log_close(GameLog* log) {
+    int rc = fclose(log->f) == 0 ? 0 : -1;
+    free(log->buffer);
+    log->f = NULL;
+    log->buffer = NULL;
+    return rc;
+}
+
+// Function to tell how many bytes have been logged so far
+long log_size(GameLog* log) {
+    return ftell(log->f);
+}
+
+// Function to mix a value into an FNV-1a hash
+static uint64_t hash_mix(uint64_t h, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        h ^= (v >> (i * 8)) & 0xFF;
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+// Function to hash everything a replay has to reproduce: tanks, projectiles, RNG and outcome
+uint64_t game_state_hash(GameState* g) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    
+    h = hash_mix(h, g->tick);
+    h = hash_mix(h, g->projectile_steps);
+    h = hash_mix(h, (uint64_t)g->winner);
+    h = hash_mix(h, g->tanks_alive);
+    for (int i = 0; i < 4; i++) {
+        h = hash_mix(h, g->rng.s[i]);
+    }
+    for (int i = 0; i < g->num_tanks; i++) {
+        Tank* tank = &g->tanks[i];
+        h = hash_mix(h, ((uint64_t)tank->x << 32) | (uint32_t)tank->y);
+        h = hash_mix(h, ((uint64_t)(uint32_t)tank->health << 32) | tank->dir);
+    }
+    for (int i = 0; i < g->projectile_hwm; i++) {
+        Projectile* proj = &g->projectiles[i];
+        if (proj->active) {
+            h = hash_mix(h, ((uint64_t)i << 32) | proj->dir);
+            h = hash_mix(h, ((uint64_t)(uint32_t)proj->fx << 32) | (uint32_t)proj->fy);
+            h = hash_mix(h, ((uint64_t)(uint32_t)proj->vx << 32) | (uint32_t)proj->vy);
+        }
+    }
+    return h;
+}
+
+// Reader over a log held in memory
+typedef struct {
+    const unsigned char* p;
+    const unsigned char* end;
+    int bad; // Set once the stream is truncated or malformed
+} LogReader;
+
+// Function to read an unsigned LEB128 varint
+static uint64_t get_varint(LogReader* r) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->p >= r->end) {
+            r->bad = 1;
+            return 0;
+        }
+        unsigned char b = *r->p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+    }
+    r->bad = 1;
+    return 0;
+}
+
+// Function to read the whole log file into memory
+static unsigned char* load_file(const char* path, size_t* len) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    
+    unsigned char* buf = NULL;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        long size = ftell(f);
+        rewind(f);
+        buf = size > 0 ? malloc(size) : NULL;
+        if (buf && fread(buf, 1, size, f) != (size_t)size) {
+            free(buf);
+            buf = NULL;
+        }
+        *len = size;
+    }
+    fclose(f);
+    return buf;
+}
+
+// Function to run the simulation up to a tick, stopping early if the round ends
+static void run_until(GameState* g, unsigned long tick) {
+    while (g->tick < tick && !g->game_over) {
+        simulation_tick(g);
+    }
+}
+
+// Function to rebuild the recorded game and re-simulate every round as fast as possible
+int replay_log(const char* path, ReplayResult* result, FILE* verbose) {
+    size_t len = 0;
+    unsigned char* buf = load_file(path, &len);
+    LogHeader hdr;
+    GameState g;
+    
+    memset(result, 0, sizeof(ReplayResult));
+    if (!buf) {
+        return -1;
+    }
+    
+    memcpy(&hdr, buf, len < sizeof(hdr) ? len : sizeof(hdr));
+    if (len < sizeof(hdr) || memcmp(hdr.magic, LOG_MAGIC, 4) != 0 || hdr.version != LOG_VERSION ||
+        hdr.header_size < sizeof(hdr) || hdr.projectile_speed < 1 || hdr.projectile_speed > PROJECTILE_MAX_SPEED ||
+        len < (size_t)hdr.header_size + hdr.map_path_len + hdr.num_tanks * sizeof(uint16_t)) {
+        free(buf);
+        return -1; // Not a log file
+    }
+    
+    // Same board as the recording: the same map file, or a generated board of the same size
+    int rc;
+    if (hdr.map_path_len > 0) {
+        char map_path[UINT16_MAX + 1];
+        memcpy(map_path, buf + hdr.header_size, hdr.map_path_len);
+        map_path[hdr.map_path_len] = '\0';
+        rc = game_load_map(&g, map_path, hdr.max_projectiles, hdr.num_tanks);
+        if (rc == 0 && (g.width != (int)hdr.width || g.height != (int)hdr.height)) {
+            game_free(&g);
+            rc = -1; // Map changed since the recording
+        }
+    } else {
+        rc = game_init(&g, hdr.width, hdr.height, hdr.max_projectiles, hdr.num_tanks);
+    }
+    if (rc < 0) {
+        free(buf);
+        return -1;
+    }
+    g.move_ticks = hdr.move_ticks;
+    g.fire_ticks = hdr.fire_ticks;
+    g.projectile_speed = hdr.projectile_speed;
+    const unsigned char* speeds = buf + hdr.header_size + hdr.map_path_len;
+    for (int i = 0; i < g.num_tanks; i++) {
+        uint16_t speed;
+        memcpy(&speed, speeds + i * sizeof(speed), sizeof(speed));
+        g.tanks[i].shot_speed = speed < PROJECTILE_MAX_SPEED ? speed : PROJECTILE_MAX_SPEED;
+    }
+    
+    // AI tanks are not in the log, they are re-run and make the same decisions
+    Ai ai;
+    if (hdr.ai && ai_init(&ai, &g, hdr.ai - 1) < 0) {
+        game_free(&g);
+        free(buf);
+        return -1;
+    }
+    
+    LogReader r = { speeds + hdr.num_tanks * sizeof(uint16_t), buf + len, 0 };
+    unsigned long tick = 0;
+    int in_round = 0;
+    
+    while (r.p < r.end && !r.bad) {
+        uint64_t head = get_varint(&r);
+        tick += head >> 2;
+        
+        switch (head & 3) {
+            case LOG_ROUND: {
+                unsigned int seed = (unsigned int)get_varint(&r);
+                if (r.end - r.p < 2) {
+                    r.bad = 1;
+                    break;
+                }
+                setup_tanks(&g, (char)r.p[0], (char)r.p[1]);
+                r.p += 2;
+                reset_game(&g, seed);
+                tick = 0;
+                in_round = 1;
+                result->rounds++;
+                break;
+            }
+            case LOG_ACTION: {
+                uint64_t v = get_varint(&r);
+                if (!in_round) {
+                    r.bad = 1;
+                    break;
+                }
+                run_until(&g, tick);
+                tank_action(&g, (int)(v / NUM_ACTIONS), (Action)(v % NUM_ACTIONS));
+                result->events++;
+                break;
+            }
+            case LOG_KEY: {
+                uint64_t v = get_varint(&r);
+                if (!in_round) {
+                    r.bad = 1;
+                    break;
+                }
+                run_until(&g, tick);
+                tank_key(&g, (int)((v >> 1) / NUM_ACTIONS), (Action)((v >> 1) % NUM_ACTIONS), (int)(v & 1));
+                result->events++;
+                break;
+            }
+            case LOG_END: {
+                uint64_t expected;
+                if (!in_round || r.end - r.p < (long)sizeof(expected)) {
+                    r.bad = 1;
+                    break;
+                }
+                memcpy(&expected, r.p, sizeof(expected));
+                r.p += sizeof(expected);
+                run_until(&g, tick);
+                
+                int match = g.tick == tick && game_state_hash(&g) == expected;
+                result->mismatches += !match;
+                result->ticks += g.tick;
+                if (verbose) {
+                    fprintf(verbose, "round %lu: %lu ticks, winner %d, %s\n", result->rounds, g.tick,
+                            g.winner, match ? "state matches" : "STATE MISMATCH");
+                }
+                in_round = 0;
+                break;
+            }
+            default:
+                r.bad = 1;
+                break;
+        }
+    }
+    
+    if (hdr.ai) {
+        ai_free(&ai, &g);
+    }
+    game_free(&g);
+    free(buf);
+    return r.bad ? -1 : 0;
+}
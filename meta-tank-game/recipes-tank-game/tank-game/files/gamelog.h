@@ -0,0 +1,63 @@
+#ifndef TANK_GAMELOG_H
+#define TANK_GAMELOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "game.h"
+
+#define LOG_MAGIC "TLOG"
+#define LOG_VERSION 3 // 2: generated boards come from map_generate(), 3: fixed-point projectiles
+#define LOG_BUFFER_SIZE 65536
+
+// On-disk log header (host byte order), followed by map_path_len bytes of map path, num_tanks 16-bit
+// projectile speeds of the tanks (0 for the default) and then a stream of records. Every record starts with a varint (tick delta << 2 | kind).
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t header_size; // Offset of the map path
+    uint32_t width, height;
+    uint16_t num_tanks;
+    uint16_t max_projectiles;
+    uint16_t move_ticks, fire_ticks;
+    uint16_t map_path_len; // 0 when the board was generated from the round seed
+    uint16_t ai; // 0 without AI, else 1 + the bitmask of AI-driven players (bots are always driven)
+    uint16_t projectile_speed; // Default speed of projectiles, fixed-point cells per tick
+} LogHeader;
+
+// Record kinds
+typedef enum {
+    LOG_ROUND, // varint seed, then the two player symbols; the tick restarts at 0
+    LOG_ACTION, // varint tank * NUM_ACTIONS + action
+    LOG_END, // 8-byte state hash at the round's final tick
+    LOG_KEY, // varint (tank * NUM_ACTIONS + action) << 1 | down, from real key state
+} LogRecord;
+
+// A log being written
+typedef struct GameLog {
+    FILE* f;
+    char* buffer; // stdio buffer, flushed when full and at the end of each round
+    unsigned long last_tick;
+    unsigned long events;
+    unsigned long rounds;
+} GameLog;
+
+// Outcome of replaying one log
+typedef struct {
+    unsigned long rounds;
+    unsigned long mismatches; // Rounds whose final state differs from the recording
+    unsigned long events;
+    unsigned long long ticks;
+} ReplayResult;
+
+int log_open(GameLog* log, const char* path, GameState* g, const char* map_path);
+void log_round(GameLog* log, GameState* g, unsigned int seed);
+void log_action(GameLog* log, unsigned long tick, int tank, Action action);
+void log_key(GameLog* log, unsigned long tick, int tank, Action action, int down);
+void log_round_end(GameLog* log, GameState* g);
+int log_close(GameLog* log);
+long log_size(GameLog* log);
+uint64_t game_state_hash(GameState* g);
+int replay_log(const char* path, ReplayResult* result, FILE* verbose);
+
+#endif
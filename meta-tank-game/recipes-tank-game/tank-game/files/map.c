@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "map.h"
+
+// Function to work out how many bytes the two wall layers of a map take
+size_t map_walls_size(int width, int height) {
+    return (BIT_WORDS(width) * height + BIT_WORDS(height) * width) * sizeof(uint64_t);
+}
+
+// Function to map a map file and build a game whose wall layers are the read-only mapping
+int game_load_map(GameState* g, const char* path, int max_projectiles, int num_tanks) {
+    MapHeader hdr;
+    struct stat st;
+    
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || memcmp(hdr.magic, MAP_MAGIC, 4) != 0 ||
+        hdr.version != MAP_VERSION || hdr.header_size < sizeof(hdr) || hdr.header_size % sizeof(uint64_t) != 0 ||
+        hdr.width < 3 || hdr.height < 3 || hdr.width > MAP_MAX_SIDE || hdr.height > MAP_MAX_SIDE ||
+        fstat(fd, &st) < 0 || (size_t)st.st_size < hdr.header_size + map_walls_size(hdr.width, hdr.height)) {
+        close(fd);
+        return -1; // Not a map file, or truncated
+    }
+    
+    // Pages are only read in when the game touches them, and walls never change so nothing is copied
+    size_t size = hdr.header_size + map_walls_size(hdr.width, hdr.height);
+    char* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    
+    uint64_t* walls = (uint64_t*)(base + hdr.header_size);
+    uint64_t* walls_col = walls + BIT_WORDS(hdr.width) * hdr.height;
+    if (game_init_with_walls(g, hdr.width, hdr.height, max_projectiles, num_tanks, walls, walls_col) < 0) {
+        munmap(base, size);
+        return -1;
+    }
+    
+    g->map_base = base;
+    g->map_size = size;
+    for (int i = 0; i < NUM_PLAYERS; i++) {
+        if (hdr.spawn[i][0] > 0 && hdr.spawn[i][0] < hdr.width - 1 &&
+            hdr.spawn[i][1] > 0 && hdr.spawn[i][1] < hdr.height - 1) {
+            g->spawn_x[i] = hdr.spawn[i][0];
+            g->spawn_y[i] = hdr.spawn[i][1];
+        }
+    }
+    return 0;
+}
+
+// Function to release a mapped board
+void map_unload(GameState* g) {
+    munmap(g->map_base, g->map_size);
+    g->map_base = NULL;
+    g->walls.bits = NULL;
+    g->walls_col.bits = NULL;
+}
+
+// Function to write the board's walls and the player spawns as a map file
+int map_save(GameState* g, const char* path) {
+    MapHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MAP_MAGIC, 4);
+    hdr.version = MAP_VERSION;
+    hdr.header_size = sizeof(hdr);
+    hdr.width = g->width;
+    hdr.height = g->height;
+    for (int i = 0; i < NUM_PLAYERS; i++) {
+        hdr.spawn[i][0] = g->spawn_x[i];
+        hdr.spawn[i][1] = g->spawn_y[i];
+    }
+    
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    
+    // Only walls are part of a map, tanks and projectiles become floor
+    size_t row_words = (size_t)g->walls.stride * g->height;
+    size_t col_words = (size_t)g->walls_col.stride * g->width;
+    int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+             fwrite(g->walls.bits, sizeof(uint64_t), row_words, f) == row_words &&
+             fwrite(g->walls_col.bits, sizeof(uint64_t), col_words, f) == col_words;
+    
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+    return ok ? 0 : -1;
+}
+
+// Function to read this process's resident set size in kilobytes
+long resident_kb() {
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) {
+        return -1;
+    }
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+        resident = -1;
+    }
+    fclose(f);
+    return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
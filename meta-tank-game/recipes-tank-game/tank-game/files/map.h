@@ -0,0 +1,30 @@
+#ifndef TANK_MAP_H
+#define TANK_MAP_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+#define MAP_MAGIC "TMAP"
+#define MAP_VERSION 2
+#define MAP_MAX_SIDE 16384
+
+// On-disk map header (host byte order, both targets are little-endian).
+// It is followed by the wall layers as 64-bit words, ready to be used in place:
+// height rows of BIT_WORDS(width) words, then width columns of BIT_WORDS(height) words.
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t header_size; // Offset of the first wall word, a multiple of 8
+    uint32_t width, height;
+    uint16_t spawn[NUM_PLAYERS][2]; // x, y of each player's start
+    uint32_t reserved[2];
+} MapHeader;
+
+int game_load_map(GameState* g, const char* path, int max_projectiles, int num_tanks);
+size_t map_walls_size(int width, int height);
+void map_unload(GameState* g);
+int map_save(GameState* g, const char* path);
+long resident_kb();
+
+#endif
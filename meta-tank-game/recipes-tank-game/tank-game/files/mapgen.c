@@ -0,0 +1,510 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mapgen.h"
+
+#define SEGMENT_MIN 2 // Wall segment lengths for MAP_LAYOUT_SEGMENTS
+#define SEGMENT_MAX 7
+
+// A horizontal stretch of floor, cells x0 <= x < x1 of one row
+typedef struct {
+    uint16_t x0, x1;
+} Run;
+
+// One band of MAPGEN_CHUNK_ROWS rows and the floor runs found in it
+typedef struct {
+    int y0, y1;
+    Run* runs;
+    uint32_t* parent; // Union-find over this chunk's runs, local indices
+    uint32_t* row_start; // First run of each row, plus one past the last run
+    uint32_t count, cap;
+    uint32_t offset; // Index of the chunk's first run in MapGenJob.parent
+    long sealed;
+} Chunk;
+
+// Work split into units (chunks, or 64-column bands) that threads claim one at a time
+typedef enum {
+    GEN_FILL,
+    GEN_RUNS,
+    GEN_SEAL,
+    GEN_COLUMNS,
+} GenPhase;
+
+typedef struct {
+    GameState* g;
+    const MapGenParams* p;
+    int threads;
+    int num_chunks;
+    Chunk* chunks;
+    uint32_t* parent; // Union-find over every run, global indices
+    uint32_t main_root; // Component holding the spawns
+    GenPhase phase;
+    int units;
+    int next_unit;
+    int failed;
+} MapGenJob;
+
+static const char* const layout_names[NUM_MAP_LAYOUTS] = {
+    [MAP_LAYOUT_SCATTER] = "scatter",
+    [MAP_LAYOUT_SEGMENTS] = "segments",
+};
+
+// Function to fill in the settings init_board() uses
+void map_gen_defaults(MapGenParams* p, uint64_t seed) {
+    p->seed = seed;
+    p->density = MAPGEN_DEFAULT_DENSITY;
+    p->layout = MAP_LAYOUT_SCATTER;
+    p->threads = 0;
+    p->seal_pockets = 1;
+}
+
+// Function to get a layout's name
+const char* map_layout_name(MapLayout layout) {
+    return layout_names[layout];
+}
+
+// Function to look a layout up by name, -1 if there is none
+int map_layout_parse(const char* name) {
+    for (int i = 0; i < NUM_MAP_LAYOUTS; i++) {
+        if (strcmp(name, layout_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Function to set (or clear) the bits x0 <= x < x1 of a row
+static void fill_range(uint64_t* row, int x0, int x1, int set) {
+    while (x0 < x1) {
+        int b = x0 & 63;
+        int n = x1 - x0 < 64 - b ? x1 - x0 : 64 - b;
+        uint64_t mask = (n == 64 ? ~0ULL : (1ULL << n) - 1) << b;
+        if (set) {
+            row[x0 >> 6] |= mask;
+        } else {
+            row[x0 >> 6] &= ~mask;
+        }
+        x0 += n;
+    }
+}
+
+// Function to find the first cell at or after x that is a wall (want 1) or floor (want 0), width if none
+static int scan_row(const uint64_t* row, int x, int width, int want) {
+    while (x < width) {
+        uint64_t w = want ? row[x >> 6] : ~row[x >> 6];
+        w &= ~0ULL << (x & 63);
+        if (w) {
+            int found = (x & ~63) + __builtin_ctzll(w);
+            return found < width ? found : width;
+        }
+        x = (x & ~63) + 64;
+    }
+    return width;
+}
+
+// Function to find a run's component, halving the path on the way
+static uint32_t uf_find(uint32_t* parent, uint32_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// Function to merge two components; the lower index wins, so every parent comes before its child
+static void uf_union(uint32_t* parent, uint32_t a, uint32_t b) {
+    a = uf_find(parent, a);
+    b = uf_find(parent, b);
+    if (a < b) {
+        parent[b] = a;
+    } else if (b < a) {
+        parent[a] = b;
+    }
+}
+
+// Function to join the runs of two vertically adjacent rows wherever they overlap
+static void join_rows(uint32_t* parent, const Run* above, uint32_t na, uint32_t above_id,
+                      const Run* below, uint32_t nb, uint32_t below_id) {
+    uint32_t i = 0, j = 0;
+    while (i < na && j < nb) {
+        if (above[i].x0 < below[j].x1 && below[j].x0 < above[i].x1) {
+            uf_union(parent, above_id + i, below_id + j);
+        }
+        if (above[i].x1 < below[j].x1) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+}
+
+// Function to lay the walls of one chunk; it only uses its own random sequence, so chunks run in any order
+static void fill_chunk(MapGenJob* job, Chunk* ch, int c) {
+    GameState* g = job->g;
+    const MapGenParams* p = job->p;
+    BitLayer* walls = &g->walls;
+    Rng rng;
+    rng_seed(&rng, p->seed + (uint64_t)c * 0xD1B54A32D192ED03ULL);
+    
+    memset(&walls->bits[(size_t)ch->y0 * walls->stride], 0, (size_t)(ch->y1 - ch->y0) * walls->stride * sizeof(uint64_t));
+    
+    // Border, then single cells: each draws 16 bits against the density
+    uint32_t threshold = (uint32_t)p->density * 65536 / 100;
+    for (int y = ch->y0; y < ch->y1; y++) {
+        uint64_t* row = &walls->bits[(size_t)y * walls->stride];
+        if (y == 0 || y == g->height - 1) {
+            fill_range(row, 0, g->width, 1);
+            continue;
+        }
+        bit_set(walls, 0, y);
+        bit_set(walls, g->width - 1, y);
+        
+        if (p->layout != MAP_LAYOUT_SCATTER) {
+            continue;
+        }
+        for (int x = 1; x < g->width - 1; x += 4) {
+            uint64_t r = rng_next(&rng);
+            for (int k = 0; k < 4 && x + k < g->width - 1; k++, r >>= 16) {
+                if ((r & 0xFFFF) < threshold) {
+                    row[(x + k) >> 6] |= 1ULL << ((x + k) & 63);
+                }
+            }
+        }
+    }
+    
+    // Segments are clipped to the chunk so a neighbour never writes into it
+    if (p->layout == MAP_LAYOUT_SEGMENTS) {
+        long cells = (long)(g->width - 2) * (ch->y1 - ch->y0);
+        long segments = cells * p->density / 100 / ((SEGMENT_MIN + SEGMENT_MAX) / 2);
+        for (long s = 0; s < segments; s++) {
+            int x = rng_below(&rng, g->width - 2) + 1;
+            int y = ch->y0 + rng_below(&rng, ch->y1 - ch->y0);
+            int len = SEGMENT_MIN + rng_below(&rng, SEGMENT_MAX - SEGMENT_MIN + 1);
+            int vertical = rng_next(&rng) & 1;
+            if (y == 0 || y == g->height - 1) {
+                continue;
+            }
+            if (vertical) {
+                for (int i = y; i < y + len && i < ch->y1 && i < g->height - 1; i++) {
+                    bit_set(walls, x, i);
+                }
+            } else {
+                int end = x + len < g->width - 1 ? x + len : g->width - 1;
+                fill_range(&walls->bits[(size_t)y * walls->stride], x, end, 1);
+            }
+        }
+    }
+    
+    // Keep the area around each spawn open
+    for (int i = 0; i < NUM_PLAYERS; i++) {
+        int x0 = g->spawn_x[i] - MAPGEN_SPAWN_CLEAR > 1 ? g->spawn_x[i] - MAPGEN_SPAWN_CLEAR : 1;
+        int x1 = g->spawn_x[i] + MAPGEN_SPAWN_CLEAR + 1 < g->width - 1 ? g->spawn_x[i] + MAPGEN_SPAWN_CLEAR + 1 : g->width - 1;
+        for (int y = g->spawn_y[i] - MAPGEN_SPAWN_CLEAR; y <= g->spawn_y[i] + MAPGEN_SPAWN_CLEAR; y++) {
+            if (y >= ch->y0 && y < ch->y1 && y > 0 && y < g->height - 1) {
+                fill_range(&walls->bits[(size_t)y * walls->stride], x0, x1, 0);
+            }
+        }
+    }
+}
+
+// Function to append a floor run to a chunk
+static int push_run(Chunk* ch, int x0, int x1) {
+    if (ch->count == ch->cap) {
+        uint32_t cap = ch->cap ? ch->cap * 2 : 1024;
+        Run* runs = realloc(ch->runs, cap * sizeof(Run));
+        if (!runs) {
+            return -1;
+        }
+        ch->runs = runs;
+        uint32_t* parent = realloc(ch->parent, cap * sizeof(uint32_t));
+        if (!parent) {
+            return -1;
+        }
+        ch->parent = parent;
+        ch->cap = cap;
+    }
+    ch->runs[ch->count] = (Run){ x0, x1 };
+    ch->parent[ch->count] = ch->count;
+    ch->count++;
+    return 0;
+}
+
+// Function to collect a chunk's floor runs and join those that touch inside the chunk
+static void find_runs(MapGenJob* job, Chunk* ch) {
+    GameState* g = job->g;
+    int width = g->width;
+    ch->count = 0;
+    
+    for (int y = ch->y0; y < ch->y1; y++) {
+        const uint64_t* row = &g->walls.bits[(size_t)y * g->walls.stride];
+        uint32_t first = ch->count;
+        ch->row_start[y - ch->y0] = first;
+        
+        for (int x = scan_row(row, 0, width, 0); x < width; ) {
+            int end = scan_row(row, x, width, 1);
+            if (push_run(ch, x, end) < 0) {
+                __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+                return;
+            }
+            x = scan_row(row, end, width, 0);
+        }
+        
+        if (y > ch->y0) {
+            uint32_t above = ch->row_start[y - ch->y0 - 1];
+            join_rows(ch->parent, &ch->runs[above], first - above, above, &ch->runs[first], ch->count - first, first);
+        }
+    }
+    ch->row_start[ch->y1 - ch->y0] = ch->count;
+}
+
+// Function to wall in every run that is not connected to the spawns
+static void seal_chunk(MapGenJob* job, Chunk* ch) {
+    GameState* g = job->g;
+    ch->sealed = 0;
+    
+    for (int r = 0; r < ch->y1 - ch->y0; r++) {
+        uint64_t* row = &g->walls.bits[(size_t)(ch->y0 + r) * g->walls.stride];
+        for (uint32_t i = ch->row_start[r]; i < ch->row_start[r + 1]; i++) {
+            if (job->parent[ch->offset + i] != job->main_root) {
+                fill_range(row, ch->runs[i].x0, ch->runs[i].x1, 1);
+                ch->sealed += ch->runs[i].x1 - ch->runs[i].x0;
+            }
+        }
+    }
+}
+
+// Function to rebuild the column layer for one band of 64 columns from the row layer
+static void build_columns(MapGenJob* job, int wx) {
+    GameState* g = job->g;
+    int x_end = wx * 64 + 64 < g->width ? wx * 64 + 64 : g->width;
+    
+    for (int x = wx * 64; x < x_end; x++) {
+        memset(&g->walls_col.bits[(size_t)x * g->walls_col.stride], 0, g->walls_col.stride * sizeof(uint64_t));
+    }
+    for (int y = 0; y < g->height; y++) {
+        uint64_t word = g->walls.bits[(size_t)y * g->walls.stride + wx];
+        while (word) {
+            bit_set(&g->walls_col, y, wx * 64 + __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+}
+
+// Function to claim and run units of the current phase until none are left
+static void run_units(MapGenJob* job) {
+    int u;
+    while ((u = __atomic_fetch_add(&job->next_unit, 1, __ATOMIC_RELAXED)) < job->units) {
+        switch (job->phase) {
+            case GEN_FILL:
+                fill_chunk(job, &job->chunks[u], u);
+                break;
+            case GEN_RUNS:
+                find_runs(job, &job->chunks[u]);
+                break;
+            case GEN_SEAL:
+                seal_chunk(job, &job->chunks[u]);
+                break;
+            case GEN_COLUMNS:
+                build_columns(job, u);
+                break;
+        }
+    }
+}
+
+// Function run by each helper thread
+static void* gen_worker(void* arg) {
+    run_units(arg);
+    return NULL;
+}
+
+// Function to run one phase on up to job->threads threads, the caller included
+static void run_phase(MapGenJob* job, GenPhase phase, int units) {
+    pthread_t tids[MAPGEN_MAX_THREADS];
+    int helpers = 0;
+    
+    job->phase = phase;
+    job->units = units;
+    job->next_unit = 0;
+    for (int i = 1; i < job->threads && i < units; i++) {
+        if (pthread_create(&tids[helpers], NULL, gen_worker, job) == 0) {
+            helpers++;
+        }
+    }
+    run_units(job);
+    for (int i = 0; i < helpers; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+// Function to join the chunks' runs into one union-find and flatten it so every run points at its root
+static int merge_chunks(MapGenJob* job) {
+    uint32_t total = 0;
+    for (int c = 0; c < job->num_chunks; c++) {
+        job->chunks[c].offset = total;
+        total += job->chunks[c].count;
+    }
+    
+    uint32_t* parent = realloc(job->parent, (total ? total : 1) * sizeof(uint32_t));
+    if (!parent) {
+        return -1;
+    }
+    job->parent = parent;
+    
+    for (int c = 0; c < job->num_chunks; c++) {
+        Chunk* ch = &job->chunks[c];
+        for (uint32_t i = 0; i < ch->count; i++) {
+            parent[ch->offset + i] = ch->parent[i] + ch->offset;
+        }
+    }
+    
+    // Only the rows on either side of a chunk boundary are left to join
+    for (int c = 1; c < job->num_chunks; c++) {
+        Chunk* a = &job->chunks[c - 1];
+        Chunk* b = &job->chunks[c];
+        uint32_t last = a->row_start[a->y1 - a->y0 - 1];
+        join_rows(parent, &a->runs[last], a->count - last, a->offset + last,
+                  b->runs, b->row_start[1], b->offset);
+    }
+    
+    // Parents always come first, so one forward pass reaches every root
+    for (uint32_t i = 0; i < total; i++) {
+        parent[i] = parent[parent[i]];
+    }
+    return 0;
+}
+
+// Function to find the component of the floor run covering a cell, UINT32_MAX on a wall
+static uint32_t component_at(MapGenJob* job, int x, int y) {
+    Chunk* ch = &job->chunks[y / MAPGEN_CHUNK_ROWS];
+    int r = y - ch->y0;
+    for (uint32_t i = ch->row_start[r]; i < ch->row_start[r + 1]; i++) {
+        if (ch->runs[i].x0 <= x && x < ch->runs[i].x1) {
+            return job->parent[ch->offset + i];
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Function to clear an L-shaped corridor between two cells, returns the walls removed
+static long carve_path(GameState* g, int x0, int y0, int x1, int y1) {
+    long carved = 0;
+    int x = x0, y = y0;
+    
+    while (1) {
+        if (WALL_AT(g, x, y)) {
+            bit_clear(&g->walls, x, y);
+            carved++;
+        }
+        if (x != x1) {
+            x += x < x1 ? 1 : -1;
+        } else if (y != y1) {
+            y += y < y1 ? 1 : -1;
+        } else {
+            break;
+        }
+    }
+    return carved;
+}
+
+// Function to generate the walls of a board with writable wall layers (caller owns the game or holds board_mutex).
+// Both spawns always end up connected; returns -1 if out of memory, leaving unchecked walls.
+int map_generate(GameState* g, const MapGenParams* params, MapGenStats* stats) {
+    MapGenParams p = *params;
+    MapGenJob job;
+    memset(&job, 0, sizeof(job));
+    
+    if (p.density < 0) {
+        p.density = 0;
+    } else if (p.density > MAPGEN_MAX_DENSITY) {
+        p.density = MAPGEN_MAX_DENSITY;
+    }
+    if (p.layout < 0 || p.layout >= NUM_MAP_LAYOUTS) {
+        p.layout = MAP_LAYOUT_SCATTER;
+    }
+    
+    job.g = g;
+    job.p = &p;
+    job.num_chunks = (g->height + MAPGEN_CHUNK_ROWS - 1) / MAPGEN_CHUNK_ROWS;
+    job.threads = p.threads > 0 ? p.threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if ((long)g->width * g->height < MAPGEN_PARALLEL_CELLS || job.threads < 1) {
+        job.threads = 1;
+    } else if (job.threads > MAPGEN_MAX_THREADS) {
+        job.threads = MAPGEN_MAX_THREADS;
+    }
+    
+    job.chunks = calloc(job.num_chunks, sizeof(Chunk));
+    if (!job.chunks) {
+        return -1;
+    }
+    for (int c = 0; c < job.num_chunks; c++) {
+        Chunk* ch = &job.chunks[c];
+        ch->y0 = c * MAPGEN_CHUNK_ROWS;
+        ch->y1 = ch->y0 + MAPGEN_CHUNK_ROWS < g->height ? ch->y0 + MAPGEN_CHUNK_ROWS : g->height;
+        ch->row_start = malloc((ch->y1 - ch->y0 + 1) * sizeof(uint32_t));
+        if (!ch->row_start) {
+            job.failed = 1;
+        }
+    }
+    
+    long long t0 = perf_clock();
+    long long span = trace_begin();
+    if (!job.failed) {
+        run_phase(&job, GEN_FILL, job.num_chunks);
+    }
+    trace_end("mapgen fill", span);
+    long long t1 = perf_clock();
+    
+    // Label floor components; if the spawns are apart, carve a corridor and label again
+    span = trace_begin();
+    long carved = 0;
+    for (int pass = 0; pass < 2 && !job.failed; pass++) {
+        run_phase(&job, GEN_RUNS, job.num_chunks);
+        if (job.failed || merge_chunks(&job) < 0) {
+            job.failed = 1;
+            break;
+        }
+        job.main_root = component_at(&job, g->spawn_x[0], g->spawn_y[0]);
+        if (job.main_root == component_at(&job, g->spawn_x[1], g->spawn_y[1])) {
+            break;
+        }
+        carved = carve_path(g, g->spawn_x[0], g->spawn_y[0], g->spawn_x[1], g->spawn_y[1]);
+    }
+    
+    long sealed = 0;
+    if (!job.failed && p.seal_pockets) {
+        run_phase(&job, GEN_SEAL, job.num_chunks);
+        for (int c = 0; c < job.num_chunks; c++) {
+            sealed += job.chunks[c].sealed;
+        }
+    }
+    trace_end("mapgen connect", span);
+    long long t2 = perf_clock();
+    
+    // The column layer is derived from the finished rows
+    span = trace_begin();
+    run_phase(&job, GEN_COLUMNS, g->walls.stride);
+    trace_end("mapgen columns", span);
+    long long t3 = perf_clock();
+    
+    if (stats) {
+        stats->threads = job.threads;
+        stats->chunks = job.num_chunks;
+        stats->fill_ns = t1 - t0;
+        stats->connect_ns = t2 - t1;
+        stats->columns_ns = t3 - t2;
+        stats->total_ns = t3 - t0;
+        stats->carved = carved;
+        stats->sealed = sealed;
+    }
+    
+    for (int c = 0; c < job.num_chunks; c++) {
+        free(job.chunks[c].runs);
+        free(job.chunks[c].parent);
+        free(job.chunks[c].row_start);
+    }
+    free(job.chunks);
+    free(job.parent);
+    return job.failed ? -1 : 0;
+}
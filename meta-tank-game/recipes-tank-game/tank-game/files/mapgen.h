@@ -0,0 +1,45 @@
+#ifndef TANK_MAPGEN_H
+#define TANK_MAPGEN_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+#define MAPGEN_CHUNK_ROWS 64 // Rows generated as one unit; a chunk depends only on the seed and its index
+#define MAPGEN_MAX_THREADS 16
+#define MAPGEN_PARALLEL_CELLS (1 << 18) // Smaller boards are generated on the calling thread
+#define MAPGEN_SPAWN_CLEAR 2 // Cells kept free around each spawn in every direction
+#define MAPGEN_MAX_DENSITY 60 // Percent
+#define MAPGEN_DEFAULT_DENSITY 5 // What init_board() has always used
+
+// How walls are laid out
+typedef enum {
+    MAP_LAYOUT_SCATTER, // Single wall cells
+    MAP_LAYOUT_SEGMENTS, // Short horizontal and vertical wall runs
+    NUM_MAP_LAYOUTS
+} MapLayout;
+
+// Generator settings; the same settings always give the same walls, whatever the thread count
+typedef struct {
+    uint64_t seed;
+    int density; // Percent of the inside that starts as wall
+    MapLayout layout;
+    int threads; // Workers for big boards, 0 for one per online CPU
+    int seal_pockets; // Turn floor that cannot be reached from the spawns into wall
+} MapGenParams;
+
+// What one generation did and cost
+typedef struct {
+    int threads;
+    int chunks;
+    long long fill_ns, connect_ns, columns_ns, total_ns;
+    long carved; // Walls removed to join the spawns
+    long sealed; // Unreachable floor cells filled in
+} MapGenStats;
+
+void map_gen_defaults(MapGenParams* p, uint64_t seed);
+int map_generate(GameState* g, const MapGenParams* p, MapGenStats* stats);
+const char* map_layout_name(MapLayout layout);
+int map_layout_parse(const char* name);
+
+#endif
@@ -0,0 +1,467 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "net.h"
+#include "map.h"
+
+// Function to make room for extra bytes at the end of a buffer
+int netbuf_reserve(NetBuf* b, size_t extra) {
+    if (b->len + extra <= b->cap) {
+        return 0;
+    }
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap < b->len + extra) {
+        cap *= 2;
+    }
+    unsigned char* data = realloc(b->data, cap);
+    if (!data) {
+        return -1;
+    }
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+// Function to append bytes (dropped if memory runs out, the frame is then rejected by its reader)
+void netbuf_put(NetBuf* b, const void* data, size_t len) {
+    if (netbuf_reserve(b, len) == 0) {
+        memcpy(b->data + b->len, data, len);
+        b->len += len;
+    }
+}
+
+// Function to append an unsigned LEB128 varint
+void netbuf_put_varint(NetBuf* b, uint64_t v) {
+    unsigned char tmp[10];
+    size_t n = 0;
+    
+    while (v >= 0x80) {
+        tmp[n++] = (unsigned char)(v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    tmp[n++] = (unsigned char)v;
+    netbuf_put(b, tmp, n);
+}
+
+// Function to drop bytes from the front of a buffer
+void netbuf_consume(NetBuf* b, size_t len) {
+    memmove(b->data, b->data + len, b->len - len);
+    b->len -= len;
+}
+
+// Function to release a buffer
+void netbuf_free(NetBuf* b) {
+    free(b->data);
+    memset(b, 0, sizeof(NetBuf));
+}
+
+// Function to start a frame, returns where it starts for net_end_frame()
+size_t net_begin_frame(NetBuf* b, MsgType type) {
+    size_t start = b->len;
+    unsigned char header[NET_FRAME_HEADER] = { 0, 0, 0, 0, (unsigned char)type };
+    netbuf_put(b, header, sizeof(header));
+    return start;
+}
+
+// Function to fill in a frame's length once its payload is written
+void net_end_frame(NetBuf* b, size_t start) {
+    uint32_t len = (uint32_t)(b->len - start - NET_FRAME_HEADER);
+    memcpy(b->data + start, &len, sizeof(len));
+}
+
+// Function to read an unsigned LEB128 varint
+uint64_t net_get_varint(NetReader* r) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->p >= r->end) {
+            r->bad = 1;
+            return 0;
+        }
+        unsigned char b = *r->p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+    }
+    r->bad = 1;
+    return 0;
+}
+
+// Function to read raw bytes
+int net_get_bytes(NetReader* r, void* out, size_t len) {
+    if ((size_t)(r->end - r->p) < len) {
+        r->bad = 1;
+        return -1;
+    }
+    memcpy(out, r->p, len);
+    r->p += len;
+    return 0;
+}
+
+// Function to find the next complete frame at *offset, returns 1 if one was found, 0 if more bytes are needed
+int net_next_frame(NetBuf* in, size_t* offset, MsgType* type, NetReader* r) {
+    uint32_t len;
+    
+    if (in->len - *offset < NET_FRAME_HEADER) {
+        return 0;
+    }
+    memcpy(&len, in->data + *offset, sizeof(len));
+    if (len > NET_MAX_FRAME) {
+        return -1; // Not our protocol
+    }
+    if (in->len - *offset < NET_FRAME_HEADER + len) {
+        return 0;
+    }
+    
+    *type = (MsgType)in->data[*offset + 4];
+    r->p = in->data + *offset + NET_FRAME_HEADER;
+    r->end = r->p + len;
+    r->bad = 0;
+    *offset += NET_FRAME_HEADER + len;
+    return 1;
+}
+
+// Function to describe the board: its size, which tank the receiver plays, the tank symbols and the walls
+void net_encode_board(NetBuf* b, GameState* g, int you) {
+    size_t start = net_begin_frame(b, MSG_BOARD);
+    
+    netbuf_put_varint(b, you + 1);
+    netbuf_put_varint(b, g->width);
+    netbuf_put_varint(b, g->height);
+    netbuf_put_varint(b, g->num_tanks);
+    for (int i = 0; i < g->num_tanks; i++) {
+        netbuf_put(b, &g->tanks[i].symbol, 1);
+    }
+    netbuf_put(b, g->walls.bits, (size_t)g->walls.stride * g->height * sizeof(uint64_t));
+    net_end_frame(b, start);
+}
+
+// Function to write what changed since prev_tanks and prev_shots, and bring them up to date.
+// With prev_tanks NULL everything is written (a full snapshot). Returns 1 if anything changed.
+// The payload is appended as is, the caller frames it.
+int net_encode_snapshot(NetBuf* b, GameState* g, Tank* prev_tanks, BitLayer* prev_shots) {
+    int full = prev_tanks == NULL;
+    int changed = 0;
+    
+    unsigned char flags = (full ? SNAP_FULL : 0) | (g->game_over ? SNAP_GAME_OVER : 0);
+    netbuf_put(b, &flags, 1);
+    netbuf_put_varint(b, g->tick);
+    netbuf_put_varint(b, g->winner + 1);
+    netbuf_put_varint(b, g->tanks_alive);
+    
+    // Tanks that moved, turned or were hit: index + 1, position, health, direction; 0 ends the list
+    for (int i = 0; i < g->num_tanks; i++) {
+        Tank* tank = &g->tanks[i];
+        if (!full) {
+            Tank* prev = &prev_tanks[i];
+            if (prev->x == tank->x && prev->y == tank->y && prev->health == tank->health && prev->dir == tank->dir) {
+                continue;
+            }
+            *prev = *tank;
+        }
+        netbuf_put_varint(b, i + 1);
+        netbuf_put_varint(b, tank->x);
+        netbuf_put_varint(b, tank->y);
+        netbuf_put_varint(b, tank->health > 0 ? tank->health : 0);
+        netbuf_put_varint(b, tank->dir);
+        changed = 1;
+    }
+    netbuf_put_varint(b, 0);
+    
+    // Projectile cells that appeared or cleared, as gaps between cell indexes (+1); 0 ends the list.
+    // Whole words with no change are skipped.
+    size_t words = (size_t)g->shot_bits.stride * g->height;
+    uint64_t last = 0;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t diff = full ? g->shot_bits.bits[w] : g->shot_bits.bits[w] ^ prev_shots->bits[w];
+        if (!diff) {
+            continue;
+        }
+        if (!full) {
+            prev_shots->bits[w] = g->shot_bits.bits[w];
+        }
+        uint64_t y = w / g->shot_bits.stride;
+        uint64_t x0 = (w % g->shot_bits.stride) * 64;
+        while (diff) {
+            uint64_t cell = y * g->width + x0 + __builtin_ctzll(diff);
+            netbuf_put_varint(b, cell - last + 1);
+            last = cell;
+            diff &= diff - 1;
+            changed = 1;
+        }
+    }
+    netbuf_put_varint(b, 0);
+    return changed;
+}
+
+// Function to set up (or reuse) a mirror game from a board message
+int net_apply_board(GameState* mirror, NetReader* r, int* you) {
+    *you = (int)net_get_varint(r) - 1;
+    int width = (int)net_get_varint(r);
+    int height = (int)net_get_varint(r);
+    int num_tanks = (int)net_get_varint(r);
+    if (r->bad || width < 3 || height < 3 || width > MAP_MAX_SIDE || height > MAP_MAX_SIDE ||
+        num_tanks < NUM_PLAYERS || num_tanks > MAX_TANKS || *you < -1 || *you >= num_tanks) {
+        return -1;
+    }
+    
+    if (!mirror->entity || mirror->width != width || mirror->height != height || mirror->num_tanks != num_tanks) {
+        if (mirror->entity) {
+            game_free(mirror);
+        }
+        if (game_init(mirror, width, height, 1, num_tanks) < 0) {
+            return -1;
+        }
+    }
+    
+    char symbols[MAX_TANKS];
+    if (net_get_bytes(r, symbols, num_tanks) < 0) {
+        return -1;
+    }
+    setup_tanks(mirror, symbols[0], symbols[1]);
+    for (int i = 0; i < num_tanks; i++) {
+        mirror->tanks[i].symbol = symbols[i];
+        mirror->tanks[i].health = 0; // Placed by the full snapshot that follows
+    }
+    
+    // Walls arrive by row, the column layer is rebuilt from them
+    BitLayer* walls = &mirror->walls;
+    if (net_get_bytes(r, walls->bits, (size_t)walls->stride * height * sizeof(uint64_t)) < 0) {
+        return -1;
+    }
+    memset(mirror->walls_col.bits, 0, (size_t)mirror->walls_col.stride * width * sizeof(uint64_t));
+    for (int y = 0; y < height; y++) {
+        for (int w = 0; w < walls->stride; w++) {
+            uint64_t word = walls->bits[(size_t)y * walls->stride + w];
+            while (word) {
+                bit_set(&mirror->walls_col, y, w * 64 + __builtin_ctzll(word));
+                word &= word - 1;
+            }
+        }
+    }
+    
+    memset(mirror->tank_bits.bits, 0, (size_t)mirror->tank_bits.stride * height * sizeof(uint64_t));
+    memset(mirror->tank_bits_col.bits, 0, (size_t)mirror->tank_bits_col.stride * width * sizeof(uint64_t));
+    memset(mirror->entity, 0, (size_t)width * height * sizeof(EntityId));
+    reset_projectiles(mirror);
+    mirror->game_over = 0;
+    mirror->winner = -1;
+    return 0;
+}
+
+// Function to apply a snapshot payload to a mirror game
+int net_apply_snapshot(GameState* mirror, NetReader* r) {
+    unsigned char flags = 0;
+    net_get_bytes(r, &flags, 1);
+    mirror->tick = net_get_varint(r);
+    mirror->winner = (int)net_get_varint(r) - 1;
+    mirror->tanks_alive = (int)net_get_varint(r);
+    mirror->game_over = (flags & SNAP_GAME_OVER) != 0;
+    if (mirror->winner < -1 || mirror->winner >= mirror->num_tanks) {
+        mirror->winner = -1;
+        r->bad = 1;
+    }
+    
+    if (flags & SNAP_FULL) {
+        reset_projectiles(mirror);
+    }
+    
+    for (uint64_t id; (id = net_get_varint(r)) != 0 && !r->bad; ) {
+        int x = (int)net_get_varint(r);
+        int y = (int)net_get_varint(r);
+        int health = (int)net_get_varint(r);
+        int dir = (int)net_get_varint(r);
+        if (id > (uint64_t)mirror->num_tanks || x < 0 || y < 0 || x >= mirror->width || y >= mirror->height ||
+            dir < 0 || dir > RIGHT) {
+            r->bad = 1;
+            break;
+        }
+        sync_tank(mirror, (int)id - 1, x, y, health);
+        mirror->tanks[id - 1].dir = (Direction)dir;
+    }
+    
+    uint64_t cells = (uint64_t)mirror->width * mirror->height;
+    uint64_t cell = 0;
+    for (uint64_t gap; !r->bad && (gap = net_get_varint(r)) != 0; ) {
+        cell += gap - 1;
+        if (cell >= cells) {
+            r->bad = 1;
+            break;
+        }
+        int x = (int)(cell % mirror->width);
+        int y = (int)(cell / mirror->width);
+        bit_flip(&mirror->shot_bits, x, y);
+    }
+    return r->bad ? -1 : 0;
+}
+
+// Function to set the options every game socket gets: non-blocking, no Nagle delay
+static void net_tune_socket(int fd) {
+    int one = 1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// Function to open a non-blocking listening TCP socket on every local address
+int net_listen(int port) {
+    struct sockaddr_in addr;
+    int one = 1;
+    
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, NET_MAX_CLIENTS) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Function to open a non-blocking listening Unix socket, replacing one a crashed game left behind
+int net_listen_unix(const char* path) {
+    struct sockaddr_un addr;
+    
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, NET_MAX_CLIENTS) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Function to connect to a Unix socket path, returns a non-blocking socket
+static int net_connect_unix(const char* path) {
+    struct sockaddr_un addr;
+    
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// Function to connect to "host:port" (or just "host", on the default port), or to a Unix socket path
+// (anything with a '/'), returns a non-blocking socket
+int net_connect(const char* addr) {
+    char host[256];
+    char port[16];
+    struct addrinfo hints, *res;
+    
+    if (strchr(addr, '/')) {
+        return net_connect_unix(addr);
+    }
+    
+    const char* colon = strrchr(addr, ':');
+    size_t host_len = colon ? (size_t)(colon - addr) : strlen(addr);
+    if (host_len >= sizeof(host)) {
+        return -1;
+    }
+    memcpy(host, addr, host_len);
+    host[host_len] = '\0';
+    snprintf(port, sizeof(port), "%s", colon ? colon + 1 : "");
+    if (!colon) {
+        snprintf(port, sizeof(port), "%d", NET_DEFAULT_PORT);
+    }
+    
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host_len ? host : "127.0.0.1", port, &hints, &res) != 0) {
+        return -1;
+    }
+    
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    
+    if (fd >= 0) {
+        net_tune_socket(fd);
+    }
+    return fd;
+}
+
+// Function to write as much queued output as the socket takes, returns -1 if the peer is gone
+int net_flush(int fd, NetBuf* out) {
+    size_t sent = 0;
+    
+    while (sent < out->len) {
+        ssize_t n = send(fd, out->data + sent, out->len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        sent += n;
+    }
+    netbuf_consume(out, sent);
+    return 0;
+}
+
+// Function to read everything the socket has into a buffer, returns -1 on EOF or error
+int net_receive(int fd, NetBuf* in) {
+    while (1) {
+        if (netbuf_reserve(in, 65536) < 0) {
+            return -1;
+        }
+        ssize_t n = recv(fd, in->data + in->len, in->cap - in->len, 0);
+        if (n > 0) {
+            in->len += n;
+            continue;
+        }
+        if (n == 0) {
+            return -1; // Peer closed
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef TANK_NET_H
+#define TANK_NET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "game.h"
+
+#define NET_DEFAULT_PORT 4545
+#define NET_MAX_CLIENTS 16
+#define NET_MAX_BACKLOG (1 << 20) // Bytes queued for one client before it is resynced instead
+#define NET_MAX_FRAME (64 << 20) // Largest frame accepted (a board message for the biggest map)
+#define NET_RESTART_TICKS (3 * TICKS_PER_SEC) // Pause between a round ending and the next one
+
+// Every message is a frame: 4-byte payload length (host byte order), 1-byte type, payload
+typedef enum {
+    MSG_BOARD = 1, // Server to client: board size, tanks and walls; a full snapshot follows
+    MSG_SNAPSHOT, // Server to client: what changed since the previous snapshot
+    MSG_INPUT, // Client to server: one action and the client's send time
+} MsgType;
+
+#define NET_FRAME_HEADER 5
+
+// Snapshot flags
+#define SNAP_FULL 1 // Client clears its projectiles first
+#define SNAP_GAME_OVER 2
+
+// Growable byte buffer for frames being built or received
+typedef struct {
+    unsigned char* data;
+    size_t len, cap;
+} NetBuf;
+
+// Reader over a received frame
+typedef struct {
+    const unsigned char* p;
+    const unsigned char* end;
+    int bad; // Set once the frame is truncated or malformed
+} NetReader;
+
+// Buffers and framing
+int netbuf_reserve(NetBuf* b, size_t extra);
+void netbuf_put(NetBuf* b, const void* data, size_t len);
+void netbuf_put_varint(NetBuf* b, uint64_t v);
+void netbuf_consume(NetBuf* b, size_t len);
+void netbuf_free(NetBuf* b);
+size_t net_begin_frame(NetBuf* b, MsgType type);
+void net_end_frame(NetBuf* b, size_t start);
+uint64_t net_get_varint(NetReader* r);
+int net_get_bytes(NetReader* r, void* out, size_t len);
+int net_next_frame(NetBuf* in, size_t* offset, MsgType* type, NetReader* r);
+
+// Game state on the wire
+void net_encode_board(NetBuf* b, GameState* g, int you);
+int net_encode_snapshot(NetBuf* b, GameState* g, Tank* prev_tanks, BitLayer* prev_shots);
+int net_apply_board(GameState* mirror, NetReader* r, int* you);
+int net_apply_snapshot(GameState* mirror, NetReader* r);
+
+// Sockets
+int net_listen(int port);
+int net_listen_unix(const char* path);
+int net_connect(const char* addr);
+int net_flush(int fd, NetBuf* out);
+int net_receive(int fd, NetBuf* in);
+
+// Client (tank-game -C), runs inside an initialised ncurses screen
+int run_client(const char* addr);
+void print_client_stats(FILE* out);
+
+#endif
@@ -0,0 +1,97 @@
+#include "perf.h"
+
+int perf_enabled = 0;
+
+static PerfStats perf_counters[NUM_PERF_COUNTERS];
+
+static const char* const perf_names[NUM_PERF_COUNTERS] = {
+    [PERF_RENDER] = "render",
+    [PERF_TICK] = "tick",
+    [PERF_LOCK_WAIT] = "lock wait",
+    [PERF_LOCK_HOLD] = "lock hold",
+    [PERF_PROJECTILES] = "projectiles",
+    [PERF_FRAME_BYTES] = "frame bytes",
+    [PERF_AI] = "ai",
+};
+
+// Counters in nanoseconds are printed in microseconds
+static const int perf_is_time[NUM_PERF_COUNTERS] = {
+    [PERF_RENDER] = 1,
+    [PERF_TICK] = 1,
+    [PERF_LOCK_WAIT] = 1,
+    [PERF_LOCK_HOLD] = 1,
+    [PERF_AI] = 1,
+};
+
+// Function to add one value to a counter; relaxed atomics so any thread may record
+void perf_record(PerfCounter c, unsigned long long value) {
+    PerfStats* s = &perf_counters[c];
+    int b = value ? 64 - __builtin_clzll(value) : 0;
+    if (b >= PERF_BUCKETS) {
+        b = PERF_BUCKETS - 1;
+    }
+    
+    __atomic_fetch_add(&s->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->sum, value, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->buckets[b], 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->last, value, __ATOMIC_RELAXED);
+    
+    unsigned long long max = __atomic_load_n(&s->max, __ATOMIC_RELAXED);
+    while (value > max) {
+        if (__atomic_compare_exchange_n(&s->max, &max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break; // On failure max is reloaded and compared again
+        }
+    }
+}
+
+// Function to read a counter
+const PerfStats* perf_stats(PerfCounter c) {
+    return &perf_counters[c];
+}
+
+// Function to estimate a percentile (0-1) from the histogram, as the upper bound of its bucket
+unsigned long long perf_percentile(PerfCounter c, double p) {
+    const PerfStats* s = &perf_counters[c];
+    unsigned long long target = (unsigned long long)(s->count * p);
+    unsigned long long seen = 0;
+    
+    for (int b = 0; b < PERF_BUCKETS; b++) {
+        seen += s->buckets[b];
+        if (seen > target) {
+            unsigned long long upper = b ? 1ULL << b : 0;
+            return upper < s->max ? upper : s->max;
+        }
+    }
+    return s->max;
+}
+
+// Function to get a counter's display name
+const char* perf_name(PerfCounter c) {
+    return perf_names[c];
+}
+
+// Function to write every counter with its histogram
+void perf_dump(FILE* out) {
+    for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+        const PerfStats* s = &perf_counters[c];
+        double scale = perf_is_time[c] ? 1000.0 : 1.0;
+        const char* unit = perf_is_time[c] ? " us" : "";
+        
+        if (s->count == 0) {
+            fprintf(out, "%s: no samples\n", perf_names[c]);
+            continue;
+        }
+        fprintf(out, "%s: %llu samples, avg %.2f%s, p50 %.2f%s, p99 %.2f%s, p99.9 %.2f%s, max %.2f%s\n",
+                perf_names[c], s->count,
+                (double)s->sum / s->count / scale, unit,
+                perf_percentile(c, 0.5) / scale, unit,
+                perf_percentile(c, 0.99) / scale, unit,
+                perf_percentile(c, 0.999) / scale, unit,
+                s->max / scale, unit);
+        for (int b = 0; b < PERF_BUCKETS; b++) {
+            if (s->buckets[b]) {
+                fprintf(out, "  < %-12llu %llu\n", 1ULL << b, s->buckets[b]);
+            }
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef TANK_PERF_H
+#define TANK_PERF_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define PERF_BUCKETS 48 // Power-of-two histogram buckets, bucket b holds values below 2^b
+
+// What is measured
+typedef enum {
+    PERF_RENDER, // ns per render_game() frame
+    PERF_TICK, // ns per simulation_tick()
+    PERF_LOCK_WAIT, // ns spent waiting for board_mutex
+    PERF_LOCK_HOLD, // ns board_mutex was held
+    PERF_PROJECTILES, // Projectiles in flight, sampled every tick
+    PERF_FRAME_BYTES, // Bytes written to the terminal per frame
+    PERF_AI, // ns per ai_tick()
+    NUM_PERF_COUNTERS
+} PerfCounter;
+
+// One counter: totals plus a histogram for percentiles
+typedef struct {
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long max;
+    unsigned long long last;
+    unsigned long long buckets[PERF_BUCKETS];
+} PerfStats;
+
+// Counters cost one predictable branch each while this is 0
+extern int perf_enabled;
+
+void perf_record(PerfCounter c, unsigned long long value);
+const PerfStats* perf_stats(PerfCounter c);
+unsigned long long perf_percentile(PerfCounter c, double p);
+const char* perf_name(PerfCounter c);
+void perf_dump(FILE* out);
+
+// Function to read the monotonic clock in nanoseconds
+static inline long long perf_clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to start timing a span, 0 when counters are off
+static inline long long perf_start() {
+    return perf_enabled ? perf_clock() : 0;
+}
+
+// Function to record the time since perf_start()
+static inline void perf_end(PerfCounter c, long long start) {
+    if (perf_enabled && start) {
+        perf_record(c, perf_clock() - start);
+    }
+}
+
+// Function to record a sampled value
+static inline void perf_sample(PerfCounter c, unsigned long long value) {
+    if (perf_enabled) {
+        perf_record(c, value);
+    }
+}
+
+#endif
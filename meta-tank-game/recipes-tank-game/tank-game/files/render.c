@@ -0,0 +1,526 @@
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+
+#include "ansi.h"
+#include "render.h"
+
+// Snapshot of everything the renderer draws, copied out under board_mutex.
+// Cells are in screen layout: only what the viewports show is copied.
+typedef struct {
+    char* glyph; // snap_width * snap_height
+    EntityId* entity;
+    int* health; // One per tank
+    int tanks_alive;
+} RenderSnapshot;
+
+// One window onto the board
+typedef struct {
+    int screen_x; // Left column on screen
+    int width, height; // Cells shown
+    int origin_x, origin_y; // Board cell in the top-left corner
+    int follow; // Tank kept in view, -1 for a fixed view
+} Viewport;
+
+// Render statistics (bytes are what refresh() hands to write())
+typedef struct {
+    unsigned long frames;
+    unsigned long long bytes_total;
+    unsigned long bytes_max;
+    unsigned long long lock_ns_total; // Holding board_mutex
+    unsigned long lock_ns_max;
+    unsigned long long wait_ns_total; // Waiting for board_mutex
+    unsigned long wait_ns_max;
+} RenderStats;
+
+// Renderer state: front is what is on screen, back receives the next snapshot
+static RenderSnapshot render_buf[2];
+static int render_front = 0;
+static int render_valid = 0; // 0 forces a full repaint on the next frame
+static RenderStats render_stats;
+static int render_tanks;
+
+// Layout, rebuilt when the terminal size changes
+static Viewport views[NUM_PLAYERS];
+static int num_views;
+static int layout_lines = -1, layout_cols = -1;
+static int snap_width, snap_height; // Screen area covered by the viewports
+static int hud_x; // First column of the control panel
+static int overlay_on; // Performance counters drawn under the control panel
+static long long overlay_drawn; // When the overlay was last redrawn
+
+// Direct ANSI output instead of refresh(), for slow serial consoles
+static int ansi_on;
+static AnsiWriter ansi_out;
+static int ansi_fd;
+static long ansi_budget; // Bytes per frame, 0 for no limit
+
+// Color pair lookup: entity_pair by entity ID for tanks, glyph_pair by character for everything else
+static short* entity_pair;
+static short glyph_pair[256];
+
+// Function to read how many bytes this thread has passed to write() so far
+static unsigned long long thread_wchar() {
+    static int fd = -2;
+    char buf[512];
+    
+    if (fd == -2) {
+        fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        return 0; // Not available, byte counts stay at zero
+    }
+    
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) {
+        return 0;
+    }
+    buf[n] = '\0';
+    
+    char* field = strstr(buf, "wchar:");
+    return field ? strtoull(field + 6, NULL, 10) : 0;
+}
+
+// Function to set up the color tables and per-tank buffers for a game
+int render_init(GameState* g) {
+    render_tanks = g->num_tanks;
+    for (int i = 0; i < 2; i++) {
+        render_buf[i].health = calloc(g->num_tanks, sizeof(int));
+        if (!render_buf[i].health) {
+            render_free();
+            return -1;
+        }
+    }
+    
+    entity_pair = calloc(g->num_tanks + 1, sizeof(short));
+    if (!entity_pair) {
+        render_free();
+        return -1;
+    }
+    for (int i = 0; i < g->num_tanks; i++) {
+        entity_pair[TANK_ENTITY(i)] = tank_color_pair(i);
+    }
+    memset(glyph_pair, 0, sizeof(glyph_pair));
+    glyph_pair[(unsigned char)WALL_CHAR] = COLOR_WALL;
+    glyph_pair[(unsigned char)PROJECTILE_CHAR] = COLOR_PROJECTILE;
+    
+    layout_lines = layout_cols = -1;
+    render_valid = 0;
+    return 0;
+}
+
+// Function to split the terminal into viewports: the whole board if it fits, else one per player
+static int render_layout(GameState* g) {
+    int avail_w = COLS - HUD_MIN_WIDTH;
+    int avail_h = LINES;
+    if (avail_w < 3) {
+        avail_w = 3;
+    }
+    if (avail_h < 3) {
+        avail_h = 3;
+    }
+    
+    if (g->width <= avail_w && g->height <= avail_h) {
+        num_views = 1;
+        views[0] = (Viewport){ .screen_x = 0, .width = g->width, .height = g->height, .follow = -1 };
+        snap_width = g->width;
+    } else {
+        // Side by side halves with a one column divider, each following its player
+        int half = (avail_w - 1) / 2;
+        int w = half < g->width ? half : g->width;
+        int h = avail_h < g->height ? avail_h : g->height;
+        num_views = NUM_PLAYERS;
+        game_lock(g); // The game thread moves the tanks
+        for (int i = 0; i < NUM_PLAYERS; i++) {
+            views[i] = (Viewport){ .screen_x = i * (w + 1), .width = w, .height = h, .follow = i };
+            views[i].origin_x = g->tanks[i].x - w / 2;
+            views[i].origin_y = g->tanks[i].y - h / 2;
+        }
+        game_unlock(g);
+        snap_width = 2 * w + 1;
+    }
+    snap_height = views[0].height;
+    hud_x = snap_width + 2;
+    
+    for (int i = 0; i < 2; i++) {
+        free(render_buf[i].glyph);
+        free(render_buf[i].entity);
+        render_buf[i].glyph = calloc((size_t)snap_width * snap_height, 1);
+        render_buf[i].entity = calloc((size_t)snap_width * snap_height, sizeof(EntityId));
+        if (!render_buf[i].glyph || !render_buf[i].entity) {
+            return -1;
+        }
+    }
+    
+    if (ansi_on && ansi_init(&ansi_out, ansi_fd, ansi_budget, LINES, COLS) < 0) {
+        return -1;
+    }
+    
+    layout_lines = LINES;
+    layout_cols = COLS;
+    render_valid = 0;
+    return 0;
+}
+
+// Function to keep a followed tank away from the view edges, jumping to recenter instead of scrolling by one cell
+static void follow_tank(GameState* g, Viewport* v) {
+    if (v->follow < 0) {
+        return;
+    }
+    
+    Tank* tank = &g->tanks[v->follow];
+    int margin_x = v->width / 4;
+    int margin_y = v->height / 4;
+    
+    if (tank->x < v->origin_x + margin_x || tank->x >= v->origin_x + v->width - margin_x) {
+        v->origin_x = tank->x - v->width / 2;
+    }
+    if (tank->y < v->origin_y + margin_y || tank->y >= v->origin_y + v->height - margin_y) {
+        v->origin_y = tank->y - v->height / 2;
+    }
+    
+    // Clamp to the board
+    if (v->origin_x > g->width - v->width) {
+        v->origin_x = g->width - v->width;
+    }
+    if (v->origin_y > g->height - v->height) {
+        v->origin_y = g->height - v->height;
+    }
+    if (v->origin_x < 0) {
+        v->origin_x = 0;
+    }
+    if (v->origin_y < 0) {
+        v->origin_y = 0;
+    }
+}
+
+// Function to pick a tank's color pair: the two players keep theirs, bots cycle through the rest
+short tank_color_pair(int i) {
+    if (i == 0) {
+        return COLOR_PLAYER1;
+    }
+    if (i == 1) {
+        return COLOR_PLAYER2;
+    }
+    return COLOR_BOT1 + (i - NUM_PLAYERS) % NUM_BOT_COLORS;
+}
+
+// Foreground of each color pair, all on black; the direct writer uses the same colors
+static const short pair_fg[] = {
+    [COLOR_PLAYER1] = COLOR_RED,       // Player 1 is red
+    [COLOR_PLAYER2] = COLOR_BLUE,      // Player 2 is blue
+    [COLOR_WALL] = COLOR_WHITE,        // Walls are white
+    [COLOR_PROJECTILE] = COLOR_YELLOW, // Projectiles are yellow
+    [COLOR_HEART] = COLOR_RED,         // Hearts are red
+    [COLOR_BOT1] = COLOR_GREEN,        // Bots cycle through the rest
+    [COLOR_BOT2] = COLOR_MAGENTA,
+    [COLOR_BOT3] = COLOR_CYAN,
+};
+
+// Function to pick a cell's foreground color for writers outside ncurses: tanks by who they are, the rest by glyph
+int render_cell_color(char glyph, EntityId id) {
+    return render_pair_color(id != NO_ENTITY ? tank_color_pair(ENTITY_TANK(id)) : glyph_pair[(unsigned char)glyph]);
+}
+
+// Function to get the foreground color of a color pair, the terminal's own for pair 0
+int render_pair_color(short pair) {
+    return pair ? pair_fg[pair] : ANSI_DEFAULT_COLOR;
+}
+
+// Function to register the color pairs with ncurses
+void init_colors() {
+    for (short p = 1; p < (short)(sizeof(pair_fg) / sizeof(pair_fg[0])); p++) {
+        init_pair(p, pair_fg[p], COLOR_BLACK);
+    }
+}
+
+// Function to release the snapshot buffers
+void render_free() {
+    for (int i = 0; i < 2; i++) {
+        free(render_buf[i].glyph);
+        free(render_buf[i].entity);
+        free(render_buf[i].health);
+        render_buf[i].glyph = NULL;
+        render_buf[i].entity = NULL;
+        render_buf[i].health = NULL;
+    }
+    free(entity_pair);
+    entity_pair = NULL;
+    ansi_free(&ansi_out);
+}
+
+// Function to force a full repaint on the next frame (after clear() or a new round)
+void render_invalidate() {
+    render_valid = 0;
+}
+
+// Function to turn the performance overlay on or off (counters must be enabled to have anything to show)
+void render_set_overlay(int on) {
+    overlay_on = on;
+    render_valid = 0;
+}
+
+// Function to write frames straight to fd as ANSI sequences, at most budget bytes each (0 for no limit).
+// ncurses still reads the keyboard and draws the menus.
+void render_set_ansi(int fd, long budget) {
+    ansi_on = 1;
+    ansi_fd = fd;
+    ansi_budget = budget;
+    layout_lines = layout_cols = -1;
+}
+
+// Function to draw a character in a color pair on the output in use
+static void put_char(int y, int x, char ch, short pair) {
+    if (ansi_on) {
+        ansi_put(&ansi_out, y, x, ch, pair ? pair_fg[pair] : ANSI_DEFAULT_COLOR);
+    } else if (pair) {
+        attron(COLOR_PAIR(pair));
+        mvaddch(y, x, ch);
+        attroff(COLOR_PAIR(pair));
+    } else {
+        mvaddch(y, x, ch);
+    }
+}
+
+// Function to draw formatted text in a color pair on the output in use
+static void put_text(int y, int x, short pair, const char* fmt, ...) {
+    char text[128];
+    va_list ap;
+    
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    
+    if (ansi_on) {
+        ansi_puts(&ansi_out, y, x, text, pair ? pair_fg[pair] : ANSI_DEFAULT_COLOR);
+    } else if (pair) {
+        attron(COLOR_PAIR(pair));
+        mvaddstr(y, x, text);
+        attroff(COLOR_PAIR(pair));
+    } else {
+        mvaddstr(y, x, text);
+    }
+}
+
+// Function to draw the performance counters under the control panel
+static void draw_overlay() {
+    static const PerfCounter timed[] = { PERF_RENDER, PERF_TICK, PERF_LOCK_WAIT, PERF_LOCK_HOLD };
+    int row = OVERLAY_ROW;
+    
+    if (row + 6 > LINES) {
+        return; // No room
+    }
+    for (size_t i = 0; i < sizeof(timed) / sizeof(timed[0]); i++) {
+        put_text(row++, hud_x, 0, "%-9s p50 %6.1f p99 %7.1f us ", perf_name(timed[i]),
+                 perf_percentile(timed[i], 0.5) / 1000.0, perf_percentile(timed[i], 0.99) / 1000.0);
+    }
+    put_text(row++, hud_x, 0, "Shots: %llu (max %llu)   ", perf_stats(PERF_PROJECTILES)->last,
+             perf_stats(PERF_PROJECTILES)->max);
+    put_text(row++, hud_x, 0, "Bytes/frame: %llu (p99 %llu)   ", perf_stats(PERF_FRAME_BYTES)->last,
+             perf_percentile(PERF_FRAME_BYTES, 0.99));
+}
+
+// Function to copy the visible cells, holding board_mutex as briefly as possible
+static void take_snapshot(GameState* g, RenderSnapshot* snap) {
+    struct timespec t0, t1, t2;
+    
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    game_lock(g);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    
+    // Copy row segments of each viewport, cost follows the screen size, not the board
+    for (int v = 0; v < num_views; v++) {
+        Viewport* view = &views[v];
+        follow_tank(g, view);
+        for (int y = 0; y < view->height; y++) {
+            size_t src = (size_t)(view->origin_y + y) * g->width + view->origin_x;
+            size_t dst = (size_t)y * snap_width + view->screen_x;
+            for (int x = 0; x < view->width; x++) {
+                snap->glyph[dst + x] = cell_glyph(g, view->origin_x + x, view->origin_y + y);
+            }
+            memcpy(snap->entity + dst, g->entity + src, view->width * sizeof(EntityId));
+        }
+    }
+    for (int i = 0; i < render_tanks; i++) {
+        snap->health[i] = g->tanks[i].health;
+    }
+    snap->tanks_alive = g->tanks_alive;
+    
+    game_unlock(g);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    
+    unsigned long wait = (t1.tv_sec - t0.tv_sec) * 1000000000UL + (t1.tv_nsec - t0.tv_nsec);
+    render_stats.wait_ns_total += wait;
+    if (wait > render_stats.wait_ns_max) {
+        render_stats.wait_ns_max = wait;
+    }
+    unsigned long ns = (t2.tv_sec - t1.tv_sec) * 1000000000UL + (t2.tv_nsec - t1.tv_nsec);
+    render_stats.lock_ns_total += ns;
+    if (ns > render_stats.lock_ns_max) {
+        render_stats.lock_ns_max = ns;
+    }
+}
+
+// Function to draw a single screen cell with its color
+static void draw_cell(const RenderSnapshot* snap, int y, int x) {
+    size_t idx = (size_t)y * snap_width + x;
+    char cell = snap->glyph[idx];
+    EntityId id = snap->entity[idx];
+    
+    // Tanks are colored by who they are, everything else by glyph
+    short pair = id != NO_ENTITY ? entity_pair[id] : glyph_pair[(unsigned char)cell];
+    put_char(y, x, cell, pair);
+}
+
+// Function to draw a player's health as hearts, blanking lost ones
+static void draw_hearts(int row, int health) {
+    for (int i = 0; i < health; i++) {
+        put_text(row, hud_x + 9 + i*2, COLOR_HEART, HEART_STR);  // Multiplying by 2 to account for the width of "<3"
+    }
+    for (int i = health < 0 ? 0 : health; i < MAX_HEALTH; i++) {
+        put_text(row, hud_x + 9 + i*2, 0, "  ");
+    }
+}
+
+// Function to draw the parts of the control panel that never change during a round
+static void draw_static_hud(GameState* g) {
+    put_text(0, hud_x, 0, "Player %c: ", g->tanks[0].symbol);
+    put_text(1, hud_x, 0, "Player %c: ", g->tanks[1].symbol);
+    
+    // Display controls
+    put_text(3, hud_x, COLOR_PLAYER1, "Player %c Controls:", g->tanks[0].symbol);
+    put_text(4, hud_x, 0, "  Up: %c", g->tanks[0].up_key);
+    put_text(5, hud_x, 0, "  Down: %c", g->tanks[0].down_key);
+    put_text(6, hud_x, 0, "  Left: %c", g->tanks[0].left_key);
+    put_text(7, hud_x, 0, "  Right: %c", g->tanks[0].right_key);
+    put_text(8, hud_x, 0, "  Fire: %c", g->tanks[0].fire_key);
+    
+    put_text(10, hud_x, COLOR_PLAYER2, "Player %c Controls:", g->tanks[1].symbol);
+    put_text(11, hud_x, 0, "  Up: %c", g->tanks[1].up_key);
+    put_text(12, hud_x, 0, "  Down: %c", g->tanks[1].down_key);
+    put_text(13, hud_x, 0, "  Left: %c", g->tanks[1].left_key);
+    put_text(14, hud_x, 0, "  Right: %c", g->tanks[1].right_key);
+    put_text(15, hud_x, 0, "  Fire: %c", g->tanks[1].fire_key);
+    
+    put_text(17, hud_x, 0, "Press 'q' to quit");
+    
+    // Divider between the players' views (line drawing characters are not worth their bytes on a serial link)
+    if (num_views > 1) {
+        for (int y = 0; y < snap_height; y++) {
+            if (ansi_on) {
+                ansi_put(&ansi_out, y, views[1].screen_x - 1, '|', ANSI_DEFAULT_COLOR);
+            } else {
+                mvaddch(y, views[1].screen_x - 1, ACS_VLINE);
+            }
+        }
+    }
+}
+
+// Function to render the game from a snapshot, drawing only what changed
+void render_game(GameState* g) {
+    if (LINES != layout_lines || COLS != layout_cols) {
+        if (render_layout(g) < 0) {
+            return; // Out of memory, skip the frame
+        }
+    }
+    
+    RenderSnapshot* back = &render_buf[render_front ^ 1];
+    const RenderSnapshot* front = &render_buf[render_front];
+    long long start = perf_start();
+    long long span = trace_begin();
+    
+    take_snapshot(g, back);
+    trace_end("snapshot", span);
+    
+    // Everything below runs without board_mutex
+    unsigned long long before = thread_wchar();
+    int full = !render_valid;
+    if (full) {
+        if (ansi_on) {
+            // Have ncurses really clear the terminal, then draw over it directly
+            clear();
+            refresh();
+            ansi_blank(&ansi_out);
+        } else {
+            erase();
+        }
+        draw_static_hud(g);
+    }
+    
+    // Display the visible part of the board
+    for (int v = 0; v < num_views; v++) {
+        for (int y = 0; y < views[v].height; y++) {
+            size_t row = (size_t)y * snap_width;
+            for (int x = views[v].screen_x; x < views[v].screen_x + views[v].width; x++) {
+                if (full || back->glyph[row + x] != front->glyph[row + x] ||
+                    back->entity[row + x] != front->entity[row + x]) {
+                    draw_cell(back, y, x);
+                }
+            }
+        }
+    }
+    
+    // Display player health as hearts
+    for (int i = 0; i < NUM_PLAYERS; i++) {
+        if (full || back->health[i] != front->health[i]) {
+            draw_hearts(i, back->health[i]);
+        }
+    }
+    
+    // With bots on the board, show how many tanks are left
+    if (render_tanks > NUM_PLAYERS && (full || back->tanks_alive != front->tanks_alive)) {
+        put_text(18, hud_x, 0, "Tanks alive: %d/%d ", back->tanks_alive, render_tanks);
+    }
+    
+    // Performance overlay, refreshed a few times a second
+    if (overlay_on && (full || start - overlay_drawn >= OVERLAY_INTERVAL_NS)) {
+        draw_overlay();
+        overlay_drawn = start;
+    }
+    
+    long long flush = trace_begin();
+    if (ansi_on) {
+        ansi_flush(&ansi_out);
+    } else {
+        refresh();
+    }
+    trace_end("refresh", flush);
+    unsigned long bytes = thread_wchar() - before;
+    
+    render_stats.frames++;
+    render_stats.bytes_total += bytes;
+    if (bytes > render_stats.bytes_max) {
+        render_stats.bytes_max = bytes;
+    }
+    
+    render_front ^= 1;
+    render_valid = 1;
+    perf_sample(PERF_FRAME_BYTES, bytes);
+    perf_end(PERF_RENDER, start);
+    trace_end("render", span);
+}
+
+// Function to print render statistics once the terminal is released
+void print_render_stats(FILE* out) {
+    if (render_stats.frames == 0) {
+        return;
+    }
+    fprintf(out, "render: %lu frames, %.1f bytes/frame (max %lu), lock wait %.2f us avg (max %.2f us), "
+            "lock hold %.2f us avg (max %.2f us)\n",
+            render_stats.frames,
+            (double)render_stats.bytes_total / render_stats.frames,
+            render_stats.bytes_max,
+            render_stats.wait_ns_total / 1000.0 / render_stats.frames,
+            render_stats.wait_ns_max / 1000.0,
+            render_stats.lock_ns_total / 1000.0 / render_stats.frames,
+            render_stats.lock_ns_max / 1000.0);
+    if (ansi_on) {
+        ansi_print_stats(&ansi_out, out);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef TANK_RENDER_H
+#define TANK_RENDER_H
+
+#include <stdio.h>
+
+#include "game.h"
+
+// Color pairs
+#define COLOR_PLAYER1 1
+#define COLOR_PLAYER2 2
+#define COLOR_WALL 3
+#define COLOR_PROJECTILE 4
+#define COLOR_HEART 5
+#define COLOR_BOT1 6
+#define COLOR_BOT2 7
+#define COLOR_BOT3 8
+#define NUM_BOT_COLORS 3
+
+#define HEART_STR "<3"  // Using text emoticon heart
+#define HUD_MIN_WIDTH 20 // Columns kept free for the control panel when sizing viewports
+#define OVERLAY_ROW 19 // First HUD row of the performance overlay
+#define OVERLAY_INTERVAL_NS 250000000LL // Overlay redraw period, so it doesn't dominate the frame
+
+int render_init(GameState* g);
+void init_colors();
+short tank_color_pair(int i);
+int render_cell_color(char glyph, EntityId id);
+int render_pair_color(short pair);
+void render_free();
+void render_invalidate();
+void render_set_overlay(int on);
+void render_set_ansi(int fd, long budget);
+void render_game(GameState* g);
+void print_render_stats(FILE* out);
+
+#endif
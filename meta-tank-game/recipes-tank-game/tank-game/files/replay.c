@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "gamelog.h"
+
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int main(int argc, char* argv[]) {
+    int repeat = 1;
+    int verbose = 0;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "n:v")) != -1) {
+        switch (opt) {
+            case 'n':
+                repeat = atoi(optarg);
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                repeat = 0;
+                break;
+        }
+    }
+    
+    if (optind != argc - 1 || repeat < 1) {
+        fprintf(stderr,
+                "Usage: %s [-n times] [-v] <file.log>\n"
+                "  -n  replay the log this many times (default 1)\n"
+                "  -v  print the outcome of every round\n",
+                argv[0]);
+        return 1;
+    }
+    
+    // Re-simulate without any sleeps, checking every round's final state each time
+    ReplayResult result;
+    unsigned long mismatches = 0;
+    long long start = now_ns();
+    
+    for (int i = 0; i < repeat; i++) {
+        if (replay_log(argv[optind], &result, verbose && i == 0 ? stdout : NULL) < 0) {
+            fprintf(stderr, "tank-replay: cannot replay %s\n", argv[optind]);
+            return 1;
+        }
+        mismatches += result.mismatches;
+    }
+    
+    double secs = (now_ns() - start) / 1e9;
+    double game_secs = (double)result.ticks * repeat * TICK_USEC / 1e6;
+    
+    printf("%s: %lu rounds, %lu events, %llu ticks\n", argv[optind], result.rounds, result.events, result.ticks);
+    printf("replayed %d times in %.3f s: %.0f ticks/s, %.0fx real time\n",
+           repeat, secs, result.ticks * repeat / secs, game_secs / secs);
+    
+    if (mismatches > 0) {
+        printf("FAILED: %lu rounds ended in a different state\n", mismatches);
+        return 2;
+    }
+    printf("all rounds match the recording\n");
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef TANK_RNG_H
+#define TANK_RNG_H
+
+#include <stdint.h>
+
+// Self-contained PRNG (xoshiro256**), so a seed gives the same board on every libc
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+// Function to expand a seed into generator state with splitmix64
+static inline void rng_seed(Rng* r, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        r->s[i] = z ^ (z >> 31);
+    }
+}
+
+// Function to rotate a word left
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Function to draw the next 64 random bits
+static inline uint64_t rng_next(Rng* r) {
+    uint64_t* s = r->s;
+    uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+    return result;
+}
+
+// Function to draw a number in [0, n)
+static inline uint32_t rng_below(Rng* r, uint32_t n) {
+    return (uint32_t)(((rng_next(r) >> 32) * n) >> 32);
+}
+
+#endif
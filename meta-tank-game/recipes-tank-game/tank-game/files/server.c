@@ -0,0 +1,395 @@
+#define _GNU_SOURCE // accept4()
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#include "game.h"
+#include "map.h"
+#include "net.h"
+#include "ai.h"
+
+#define MAX_CATCHUP_TICKS 10 // Most ticks run for one timer wakeup
+
+// One connected client
+typedef struct {
+    int fd; // -1 for a free slot
+    int tank; // Tank it controls, -1 for a spectator
+    NetBuf in, out;
+    uint64_t echo; // Send time of its latest input, returned with the next snapshot
+    int needs_sync; // Owed a board and full snapshot once its backlog drains
+    long long connected_ns;
+    unsigned long long bytes_sent;
+    unsigned long snapshots;
+    unsigned long inputs;
+    unsigned long resyncs;
+} Client;
+
+static GameState game;
+static Ai game_ai; // Used with -a
+static Client clients[NET_MAX_CLIENTS];
+static volatile sig_atomic_t stop;
+
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to ask the main loop to finish
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+// Function to queue bytes for a client and count them
+static void client_queue(Client* c, NetBuf* frames) {
+    netbuf_put(&c->out, frames->data, frames->len);
+    c->bytes_sent += frames->len;
+}
+
+// Function to queue everything a client needs to draw the game from scratch
+static void client_queue_full(Client* c, NetBuf* scratch) {
+    scratch->len = 0;
+    net_encode_board(scratch, &game, c->tank);
+    size_t start = net_begin_frame(scratch, MSG_SNAPSHOT);
+    netbuf_put_varint(scratch, c->echo);
+    net_encode_snapshot(scratch, &game, NULL, NULL);
+    net_end_frame(scratch, start);
+    client_queue(c, scratch);
+    c->echo = 0;
+    c->snapshots++;
+}
+
+// Function to print what a client cost
+static void print_client(Client* c, int i) {
+    double secs = (now_ns() - c->connected_ns) / 1e9;
+    fprintf(stderr, "client %d (%s %c): %.1f s, %llu bytes (%.0f B/s), %lu snapshots (%.1f B avg), %lu inputs, %lu resyncs\n",
+            i, c->tank >= 0 ? "tank" : "spectator", c->tank >= 0 ? game.tanks[c->tank].symbol : '-',
+            secs, c->bytes_sent, secs > 0 ? c->bytes_sent / secs : 0.0,
+            c->snapshots, c->snapshots ? (double)c->bytes_sent / c->snapshots : 0.0,
+            c->inputs, c->resyncs);
+}
+
+// Function to drop a client
+static void client_close(Client* c, int i) {
+    print_client(c, i);
+    close(c->fd);
+    netbuf_free(&c->in);
+    netbuf_free(&c->out);
+    c->fd = -1;
+}
+
+// Function to accept every pending connection, giving each the first free player tank
+static void accept_clients(int lfd, NetBuf* scratch) {
+    int fd;
+    
+    while ((fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        Client* c = NULL;
+        int taken[NUM_PLAYERS] = { 0 };
+        for (int i = 0; i < NET_MAX_CLIENTS; i++) {
+            if (clients[i].fd < 0 && !c) {
+                c = &clients[i];
+            } else if (clients[i].fd >= 0 && clients[i].tank >= 0) {
+                taken[clients[i].tank] = 1;
+            }
+        }
+        if (!c) {
+            close(fd); // Server full
+            continue;
+        }
+        
+        memset(c, 0, sizeof(Client));
+        c->fd = fd;
+        c->tank = -1;
+        for (int t = 0; t < NUM_PLAYERS && c->tank < 0; t++) {
+            if (!taken[t]) {
+                c->tank = t;
+            }
+        }
+        c->connected_ns = now_ns();
+        client_queue_full(c, scratch);
+    }
+}
+
+// Function to act on every complete input frame a client has sent
+static int client_read(Client* c) {
+    if (net_receive(c->fd, &c->in) < 0) {
+        return -1;
+    }
+    
+    size_t offset = 0;
+    MsgType type;
+    NetReader r;
+    int found;
+    while ((found = net_next_frame(&c->in, &offset, &type, &r)) > 0) {
+        if (type != MSG_INPUT) {
+            continue;
+        }
+        unsigned char action;
+        uint64_t sent;
+        if (net_get_bytes(&r, &action, 1) < 0 || net_get_bytes(&r, &sent, sizeof(sent)) < 0) {
+            return -1;
+        }
+        if (c->tank >= 0 && action < NUM_ACTIONS) {
+            tank_action(&game, c->tank, (Action)action);
+        }
+        c->echo = sent;
+        c->inputs++;
+    }
+    netbuf_consume(&c->in, offset);
+    return found < 0 ? -1 : 0;
+}
+
+// Function to send every client what changed, computed once and shared
+static void broadcast(Tank* prev_tanks, BitLayer* prev_shots, NetBuf* body, NetBuf* scratch) {
+    body->len = 0;
+    int changed = net_encode_snapshot(body, &game, prev_tanks, prev_shots);
+    
+    for (int i = 0; i < NET_MAX_CLIENTS; i++) {
+        Client* c = &clients[i];
+        if (c->fd < 0 || (!changed && !c->echo && !c->needs_sync)) {
+            continue;
+        }
+        
+        // A client that can't keep up gets a fresh copy once it has caught up, not an ever-growing queue
+        if (c->needs_sync) {
+            if (c->out.len == 0) {
+                client_queue_full(c, scratch);
+                c->needs_sync = 0;
+            }
+            continue;
+        }
+        if (c->out.len > NET_MAX_BACKLOG) {
+            c->needs_sync = 1;
+            c->resyncs++;
+            continue;
+        }
+        
+        scratch->len = 0;
+        size_t start = net_begin_frame(scratch, MSG_SNAPSHOT);
+        netbuf_put_varint(scratch, c->echo);
+        netbuf_put(scratch, body->data, body->len);
+        net_end_frame(scratch, start);
+        client_queue(c, scratch);
+        c->echo = 0;
+        c->snapshots++;
+    }
+}
+
+// Function to remember the state every in-sync client now has
+static void snapshot_baseline(Tank* prev_tanks, BitLayer* prev_shots) {
+    memcpy(prev_tanks, game.tanks, game.num_tanks * sizeof(Tank));
+    memcpy(prev_shots->bits, game.shot_bits.bits, (size_t)prev_shots->stride * game.height * sizeof(uint64_t));
+}
+
+// Function to print command line help
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-p port] [-M map_file] [-n tanks] [-m moves_per_sec] [-f shots_per_sec] [-s seed] [-a] [-T trace.json]\n"
+            "  -p  TCP port to listen on (default %d)\n"
+            "  -n  tanks on the board, players plus bots (default %d)\n"
+            "  -a  let the AI drive the bots\n",
+            prog, NET_DEFAULT_PORT, NUM_PLAYERS);
+}
+
+int main(int argc, char* argv[]) {
+    int port = NET_DEFAULT_PORT;
+    int num_tanks = NUM_PLAYERS;
+    int moves_per_sec = MOVE_RATE;
+    int shots_per_sec = FIRE_RATE;
+    unsigned int seed = time(NULL);
+    const char* map_path = NULL;
+    const char* trace_path = NULL;
+    int use_ai = 0;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "p:M:n:m:f:s:aT:")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'M':
+                map_path = optarg;
+                break;
+            case 'n':
+                num_tanks = atoi(optarg);
+                break;
+            case 'm':
+                moves_per_sec = atoi(optarg);
+                break;
+            case 'f':
+                shots_per_sec = atoi(optarg);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'a':
+                use_ai = 1;
+                break;
+            case 'T':
+                trace_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    if (trace_path && trace_init(TRACE_DEFAULT_EVENTS) < 0) {
+        fprintf(stderr, "tank-server: out of memory\n");
+        return 1;
+    }
+    
+    // The server owns the only real game; clients mirror it
+    int rc = map_path ? game_load_map(&game, map_path, MAX_PROJECTILES, num_tanks)
+                      : game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, MAX_PROJECTILES, num_tanks);
+    if (rc < 0) {
+        fprintf(stderr, "tank-server: cannot set up the game\n");
+        return 1;
+    }
+    set_input_rates(&game, moves_per_sec, shots_per_sec);
+    if (use_ai && ai_init(&game_ai, &game, 0) < 0) {
+        fprintf(stderr, "tank-server: out of memory\n");
+        return 1;
+    }
+    setup_tanks(&game, 'A', 'B');
+    reset_game(&game, seed);
+    
+    Tank* prev_tanks = malloc(game.num_tanks * sizeof(Tank));
+    BitLayer prev_shots;
+    if (!prev_tanks || bit_layer_alloc(&prev_shots, game.width, game.height) < 0) {
+        fprintf(stderr, "tank-server: out of memory\n");
+        return 1;
+    }
+    snapshot_baseline(prev_tanks, &prev_shots);
+    
+    int lfd = net_listen(port);
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (lfd < 0 || tfd < 0) {
+        perror("tank-server");
+        return 1;
+    }
+    struct itimerspec its = { .it_interval = { 0, TICK_USEC * 1000L }, .it_value = { 0, TICK_USEC * 1000L } };
+    timerfd_settime(tfd, 0, &its, NULL);
+    
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal; // No SA_RESTART, poll() returns EINTR
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    
+    for (int i = 0; i < NET_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+    fprintf(stderr, "tank-server: %dx%d board, listening on port %d\n", game.width, game.height, port);
+    
+    NetBuf body = { 0 }, scratch = { 0 };
+    struct pollfd fds[2 + NET_MAX_CLIENTS];
+    int slot_of[2 + NET_MAX_CLIENTS];
+    int restart_wait = 0;
+    
+    while (!stop) {
+        int nfds = 2;
+        fds[0] = (struct pollfd){ .fd = lfd, .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = tfd, .events = POLLIN };
+        for (int i = 0; i < NET_MAX_CLIENTS; i++) {
+            if (clients[i].fd >= 0) {
+                fds[nfds] = (struct pollfd){ .fd = clients[i].fd, .events = POLLIN | (clients[i].out.len ? POLLOUT : 0) };
+                slot_of[nfds++] = i;
+            }
+        }
+        
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        
+        // Inputs first, so they land in the same tick as on a local keyboard
+        long long input = trace_begin();
+        for (int f = 2; f < nfds; f++) {
+            Client* c = &clients[slot_of[f]];
+            if ((fds[f].revents & (POLLIN | POLLHUP | POLLERR)) && client_read(c) < 0) {
+                client_close(c, slot_of[f]);
+            }
+        }
+        trace_end("input", input);
+        
+        if (fds[1].revents & POLLIN) {
+            uint64_t expirations;
+            if (read(tfd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                if (expirations > MAX_CATCHUP_TICKS) {
+                    expirations = MAX_CATCHUP_TICKS; // Don't spiral after a long stall
+                }
+                while (expirations-- > 0 && !game.game_over) {
+                    simulation_tick(&game);
+                }
+                if (game.game_over) {
+                    restart_wait++;
+                }
+            }
+        }
+        
+        long long span = trace_begin();
+        broadcast(prev_tanks, &prev_shots, &body, &scratch);
+        trace_end("broadcast", span);
+        
+        // Next round after a pause showing the result; everyone gets the new board
+        if (game.game_over && restart_wait >= NET_RESTART_TICKS) {
+            restart_wait = 0;
+            reset_game(&game, ++seed);
+            snapshot_baseline(prev_tanks, &prev_shots);
+            for (int i = 0; i < NET_MAX_CLIENTS; i++) {
+                if (clients[i].fd >= 0) {
+                    clients[i].needs_sync = 1; // Sent as soon as its queue is empty
+                }
+            }
+            broadcast(prev_tanks, &prev_shots, &body, &scratch);
+        }
+        
+        if (fds[0].revents & POLLIN) {
+            accept_clients(lfd, &scratch);
+        }
+        
+        for (int i = 0; i < NET_MAX_CLIENTS; i++) {
+            if (clients[i].fd >= 0 && clients[i].out.len && net_flush(clients[i].fd, &clients[i].out) < 0) {
+                client_close(&clients[i], i);
+            }
+        }
+    }
+    
+    for (int i = 0; i < NET_MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0) {
+            client_close(&clients[i], i);
+        }
+    }
+    netbuf_free(&body);
+    netbuf_free(&scratch);
+    bit_layer_free(&prev_shots);
+    free(prev_tanks);
+    close(tfd);
+    close(lfd);
+    if (game.ai) {
+        ai_print_stats(&game_ai, stderr);
+        ai_free(&game_ai, &game);
+    }
+    game_free(&game);
+    if (trace_path) {
+        trace_thread_exit();
+        if (trace_write(trace_path) < 0) {
+            fprintf(stderr, "tank-server: cannot write %s\n", trace_path);
+            return 1;
+        }
+    }
+    return 0;
+}
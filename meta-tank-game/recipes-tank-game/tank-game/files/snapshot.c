@@ -0,0 +1,273 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+
+#define ALIGN8(n) (((n) + 7) & ~(size_t)7)
+
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to create the shared mapping for a board and lay it out; the first publish fills it
+int snapshot_open(Snapshot* s, GameState* g) {
+    memset(s, 0, sizeof(Snapshot));
+    size_t cells = (size_t)g->width * g->height;
+    uint32_t chunks_per_row = (g->width + SNAPSHOT_CHUNK - 1) / SNAPSHOT_CHUNK;
+    
+    size_t tanks_off = ALIGN8(sizeof(SnapshotHeader));
+    size_t glyph_off = ALIGN8(tanks_off + g->num_tanks * sizeof(SnapshotTank));
+    size_t entity_off = ALIGN8(glyph_off + cells);
+    size_t chunk_off = ALIGN8(entity_off + cells * sizeof(EntityId));
+    s->size = chunk_off + (size_t)g->height * chunks_per_row * sizeof(uint64_t);
+    
+    s->fd = memfd_create("tank-snapshot", MFD_CLOEXEC);
+    if (s->fd < 0 || ftruncate(s->fd, s->size) < 0) {
+        snapshot_close(s);
+        return -1;
+    }
+    s->map = mmap(NULL, s->size, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+    if (s->map == MAP_FAILED) {
+        s->map = NULL;
+        snapshot_close(s);
+        return -1;
+    }
+    if (bit_layer_alloc(&s->prev_tanks, g->width, g->height) < 0 ||
+        bit_layer_alloc(&s->prev_shots, g->width, g->height) < 0) {
+        snapshot_close(s);
+        return -1;
+    }
+    
+    // A fresh memfd reads as zeros: every chunk at version 0, nothing published yet
+    SnapshotHeader* h = s->map;
+    memcpy(h->magic, SNAPSHOT_MAGIC, 4);
+    h->width = g->width;
+    h->height = g->height;
+    h->num_tanks = g->num_tanks;
+    h->chunks_per_row = chunks_per_row;
+    h->winner = -1;
+    h->tanks_off = tanks_off;
+    h->glyph_off = glyph_off;
+    h->entity_off = entity_off;
+    h->chunk_off = chunk_off;
+    
+    s->hdr = h;
+    s->tanks = (SnapshotTank*)((char*)s->map + tanks_off);
+    s->glyph = (char*)s->map + glyph_off;
+    s->entity = (EntityId*)((char*)s->map + entity_off);
+    s->chunk_version = (uint64_t*)((char*)s->map + chunk_off);
+    s->full = 1;
+    return 0;
+}
+
+// Function to unmap the snapshot; readers must be done with it
+void snapshot_close(Snapshot* s) {
+    if (s->map) {
+        munmap(s->map, s->size);
+    }
+    if (s->fd >= 0) {
+        close(s->fd);
+    }
+    bit_layer_free(&s->prev_tanks);
+    bit_layer_free(&s->prev_shots);
+    s->map = NULL;
+    s->fd = -1;
+}
+
+// Function to make the next publish rewrite the whole board, as a new round changes every cell
+void snapshot_round(Snapshot* s) {
+    s->full = 1;
+}
+
+// Function to rewrite one cell and mark its chunk changed (caller holds board_mutex and the write side of seq)
+static void put_cell(Snapshot* s, GameState* g, int x, int y, uint64_t version) {
+    size_t c = (size_t)y * g->width + x;
+    s->glyph[c] = cell_glyph(g, x, y);
+    s->entity[c] = g->entity[c];
+    s->chunk_version[(size_t)y * s->hdr->chunks_per_row + x / SNAPSHOT_CHUNK] = version;
+    s->cells++;
+}
+
+// Function to publish the board. Only cells whose tank or shot bit flipped since the last publish are
+// rewritten, found a word at a time; readers never wait for this and this never waits for them.
+void snapshot_publish(Snapshot* s, GameState* g) {
+    SnapshotHeader* h = s->hdr;
+    long long t0 = now_ns();
+    
+    game_lock(g);
+    uint32_t seq = h->seq;
+    __atomic_store_n(&h->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    
+    uint64_t version = h->version + 1;
+    size_t words = (size_t)g->tank_bits.stride * g->height;
+    if (s->full) {
+        h->round++;
+        for (int y = 0; y < g->height; y++) {
+            for (int x = 0; x < g->width; x++) {
+                put_cell(s, g, x, y, version);
+            }
+        }
+        memcpy(s->prev_tanks.bits, g->tank_bits.bits, words * sizeof(uint64_t));
+        memcpy(s->prev_shots.bits, g->shot_bits.bits, words * sizeof(uint64_t));
+        s->full = 0;
+    } else {
+        for (size_t i = 0; i < words; i++) {
+            uint64_t tanks = g->tank_bits.bits[i], shots = g->shot_bits.bits[i];
+            uint64_t changed = (tanks ^ s->prev_tanks.bits[i]) | (shots ^ s->prev_shots.bits[i]);
+            s->prev_tanks.bits[i] = tanks;
+            s->prev_shots.bits[i] = shots;
+            while (changed) {
+                int x = (int)(i % g->tank_bits.stride) * 64 + __builtin_ctzll(changed);
+                put_cell(s, g, x, (int)(i / g->tank_bits.stride), version);
+                changed &= changed - 1;
+            }
+        }
+        // A tank can step into a cell another one left since the last publish, the bit stays set
+        for (int i = 0; i < g->num_tanks; i++) {
+            Tank* t = &g->tanks[i];
+            if (t->health > 0 && s->entity[(size_t)t->y * g->width + t->x] != TANK_ENTITY(i)) {
+                put_cell(s, g, t->x, t->y, version);
+            }
+        }
+    }
+    
+    for (int i = 0; i < g->num_tanks; i++) {
+        s->tanks[i] = (SnapshotTank){ g->tanks[i].x, g->tanks[i].y, g->tanks[i].health, g->tanks[i].symbol };
+    }
+    h->tick = g->tick;
+    h->tanks_alive = g->tanks_alive;
+    h->game_over = g->game_over;
+    h->winner = g->winner;
+    h->version = version;
+    __atomic_store_n(&h->seq, seq + 2, __ATOMIC_RELEASE);
+    game_unlock(g);
+    
+    unsigned long long ns = now_ns() - t0;
+    s->publishes++;
+    s->publish_ns += ns;
+    if (ns > s->publish_ns_max) {
+        s->publish_ns_max = ns;
+    }
+}
+
+// Function to print what publishing cost
+void snapshot_print_stats(Snapshot* s, FILE* out) {
+    if (s->publishes == 0) {
+        return;
+    }
+    fprintf(out, "snapshot: %lu publishes, %.1f cells each, %.2f us avg (max %.2f us)\n",
+            s->publishes, (double)s->cells / s->publishes,
+            s->publish_ns / 1000.0 / s->publishes, s->publish_ns_max / 1000.0);
+}
+
+// Function to set up a reader of a snapshot mapping
+int snapshot_reader_init(SnapshotReader* r, const void* map) {
+    const SnapshotHeader* h = map;
+    memset(r, 0, sizeof(SnapshotReader));
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, 4) != 0) {
+        return -1;
+    }
+    
+    r->hdr = h;
+    r->width = h->width;
+    r->height = h->height;
+    r->num_tanks = h->num_tanks;
+    r->chunks_per_row = h->chunks_per_row;
+    r->winner = -1;
+    size_t cells = (size_t)r->width * r->height;
+    size_t chunks = (size_t)r->height * r->chunks_per_row;
+    r->glyph = malloc(cells);
+    r->entity = calloc(cells, sizeof(EntityId));
+    r->tanks = calloc(2 * (size_t)r->num_tanks, sizeof(SnapshotTank)); // Current, then the read in progress
+    r->have = calloc(chunks, sizeof(uint64_t));
+    r->touched = malloc(chunks * sizeof(int));
+    if (!r->glyph || !r->entity || !r->tanks || !r->have || !r->touched) {
+        snapshot_reader_free(r);
+        return -1;
+    }
+    memset(r->glyph, ' ', cells);
+    return 0;
+}
+
+// Function to release a reader's copy
+void snapshot_reader_free(SnapshotReader* r) {
+    free(r->glyph);
+    free(r->entity);
+    free(r->tanks);
+    free(r->have);
+    free(r->touched);
+    memset(r, 0, sizeof(SnapshotReader));
+}
+
+// Function to bring the reader's copy of a region up to date, copying only chunks that changed since it last
+// looked. Returns 0 when the game was publishing meanwhile; the copy is then retried later rather than waited for.
+int snapshot_read(SnapshotReader* r, int x0, int y0, int width, int height) {
+    const SnapshotHeader* h = r->hdr;
+    const char* base = (const char*)h;
+    const uint64_t* version = (const uint64_t*)(base + h->chunk_off);
+    const char* glyph = base + h->glyph_off;
+    const EntityId* entity = (const EntityId*)(base + h->entity_off);
+    SnapshotTank* next_tanks = r->tanks + r->num_tanks;
+    
+    r->reads++;
+    uint32_t seq = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) {
+        r->torn++;
+        return 0;
+    }
+    
+    // Clip the region to the board
+    int x1 = x0 + width < r->width ? x0 + width : r->width;
+    int y1 = y0 + height < r->height ? y0 + height : r->height;
+    x0 = x0 > 0 ? x0 : 0;
+    y0 = y0 > 0 ? y0 : 0;
+    
+    int touched = 0;
+    for (int y = y0; y < y1; y++) {
+        for (int cx = x0 / SNAPSHOT_CHUNK; cx * SNAPSHOT_CHUNK < x1; cx++) {
+            size_t c = (size_t)y * r->chunks_per_row + cx;
+            uint64_t v = __atomic_load_n(&version[c], __ATOMIC_RELAXED);
+            if (v == r->have[c]) {
+                continue;
+            }
+            size_t first = (size_t)y * r->width + cx * SNAPSHOT_CHUNK;
+            int n = r->width - cx * SNAPSHOT_CHUNK < SNAPSHOT_CHUNK ? r->width - cx * SNAPSHOT_CHUNK : SNAPSHOT_CHUNK;
+            memcpy(r->glyph + first, glyph + first, n);
+            memcpy(r->entity + first, entity + first, n * sizeof(EntityId));
+            r->have[c] = v;
+            r->touched[touched++] = (int)c;
+        }
+    }
+    memcpy(next_tanks, base + h->tanks_off, r->num_tanks * sizeof(SnapshotTank));
+    uint64_t tick = h->tick;
+    uint32_t round = h->round;
+    int tanks_alive = h->tanks_alive, game_over = h->game_over, winner = h->winner;
+    
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&h->seq, __ATOMIC_RELAXED) != seq) {
+        // Whatever was copied may be half old, half new: copy those chunks again next time
+        for (int i = 0; i < touched; i++) {
+            r->have[r->touched[i]] = 0;
+        }
+        r->torn++;
+        return 0;
+    }
+    
+    memcpy(r->tanks, next_tanks, r->num_tanks * sizeof(SnapshotTank));
+    r->tick = tick;
+    r->round = round;
+    r->tanks_alive = tanks_alive;
+    r->game_over = game_over;
+    r->winner = winner;
+    r->chunks += touched;
+    return 1;
+}
@@ -0,0 +1,83 @@
+#ifndef TANK_SNAPSHOT_H
+#define TANK_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "game.h"
+
+#define SNAPSHOT_MAGIC "TSNP"
+#define SNAPSHOT_CHUNK 16 // Cells of a row that share one version number
+
+// Header of the shared mapping; the tanks, cells and chunk versions follow at the offsets given.
+// seq is a sequence lock: odd while the game writes, readers copy and then check it did not move.
+typedef struct {
+    char magic[4];
+    uint32_t seq;
+    uint32_t width, height;
+    uint32_t num_tanks;
+    uint32_t chunks_per_row;
+    uint64_t version; // Publishes so far; a chunk changed by publish v has version v
+    uint64_t tick;
+    uint32_t round; // Bumped by the first publish after snapshot_round()
+    int32_t tanks_alive;
+    int32_t game_over;
+    int32_t winner;
+    uint32_t tanks_off, glyph_off, entity_off, chunk_off; // Byte offsets from the header
+} SnapshotHeader;
+
+// One tank as the renderers need it
+typedef struct {
+    int32_t x, y;
+    int32_t health;
+    char symbol;
+} SnapshotTank;
+
+// Game side: the mapping plus what was published last, to find the cells that changed
+typedef struct {
+    int fd; // memfd holding the mapping, another process can map it too
+    void* map;
+    size_t size;
+    SnapshotHeader* hdr;
+    SnapshotTank* tanks;
+    char* glyph; // height * width row-major
+    EntityId* entity;
+    uint64_t* chunk_version;
+    BitLayer prev_tanks, prev_shots; // Layers as of the last publish
+    int full; // Next publish rewrites every cell (new round)
+
+    unsigned long publishes;
+    unsigned long long cells; // Cells rewritten
+    unsigned long long publish_ns, publish_ns_max;
+} Snapshot;
+
+// Renderer side: a private copy and the version of every chunk in it
+typedef struct {
+    const SnapshotHeader* hdr;
+    int width, height, num_tanks, chunks_per_row;
+    char* glyph;
+    EntityId* entity;
+    SnapshotTank* tanks;
+    uint64_t* have; // Version of each chunk copied, 0 for never
+    int* touched; // Chunks copied by the read in progress
+    uint64_t tick;
+    uint32_t round;
+    int tanks_alive, game_over, winner;
+
+    unsigned long reads;
+    unsigned long torn; // Reads the game overlapped, tried again later
+    unsigned long long chunks; // Chunks copied
+} SnapshotReader;
+
+int snapshot_open(Snapshot* s, GameState* g);
+void snapshot_close(Snapshot* s);
+void snapshot_round(Snapshot* s);
+void snapshot_publish(Snapshot* s, GameState* g);
+void snapshot_print_stats(Snapshot* s, FILE* out);
+
+int snapshot_reader_init(SnapshotReader* r, const void* map);
+void snapshot_reader_free(SnapshotReader* r);
+int snapshot_read(SnapshotReader* r, int x0, int y0, int width, int height);
+
+#endif
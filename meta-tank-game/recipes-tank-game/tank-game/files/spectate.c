@@ -0,0 +1,428 @@
+#define _GNU_SOURCE // accept4()
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "spectate.h"
+
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to bump an eventfd
+static void signal_fd(int fd) {
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) < 0) {
+        // Counter saturated, the reader is woken anyway
+    }
+}
+
+// Function to drain an eventfd
+static void drain_fd(int fd) {
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0) {
+        // Nothing pending
+    }
+}
+
+// Function to drop a viewer's reference to a frame
+static void frame_release(SpecFrame* f) {
+    if (--f->refs == 0) {
+        free(f);
+    }
+}
+
+// Function to ask the game thread for a keyframe, waking it if it is idle.
+// The wakeup goes first, so the game thread never sees the flag without a wakeup left to drain.
+static void request_key(Spectate* s) {
+    if (!__atomic_load_n(&s->want_key, __ATOMIC_RELAXED)) {
+        signal_fd(s->key_fd);
+        __atomic_store_n(&s->want_key, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Function to throw away what a viewer has queued, keeping a frame it is halfway through
+static void viewer_flush_queue(Viewer* v) {
+    int keep = v->count > 0 && v->offset > 0;
+    
+    for (int i = keep; i < v->count; i++) {
+        frame_release(v->queue[(v->head + i) % SPECTATE_QUEUE]);
+    }
+    v->count = keep;
+}
+
+// Function to move a viewer that fell behind onto the next keyframe
+static void viewer_skip(Spectate* s, Viewer* v) {
+    viewer_flush_queue(v);
+    v->synced = 0;
+    v->skips++;
+    s->skipped++;
+    request_key(s);
+}
+
+// Function to detach a viewer and release its queue
+static void viewer_close(Spectate* s, Viewer* v) {
+    v->offset = 0;
+    viewer_flush_queue(v);
+    close(v->fd);
+    v->fd = -1;
+    __atomic_fetch_sub(&s->viewers, 1, __ATOMIC_RELAXED);
+}
+
+// Function to hand a published frame to every viewer that can use it.
+// In-sync viewers take deltas; viewers waiting to start take the next keyframe.
+static void fan_out(Spectate* s, SpecFrame* f) {
+    for (int i = 0; i < SPECTATE_MAX_VIEWERS; i++) {
+        Viewer* v = &s->slots[i];
+        if (v->fd < 0) {
+            continue;
+        }
+        if (f->resync && v->synced) {
+            viewer_flush_queue(v);
+            v->synced = 0;
+        }
+        if (f->key ? v->synced : !v->synced) {
+            continue;
+        }
+        if (v->count == SPECTATE_QUEUE) {
+            viewer_skip(s, v); // Too far behind for deltas to be worth sending
+            continue;
+        }
+        f->refs++;
+        v->queue[(v->head + v->count) % SPECTATE_QUEUE] = f;
+        v->count++;
+        v->frames++;
+        v->synced = 1;
+    }
+    frame_release(f); // The pending list's reference
+}
+
+// Function to send as much of a viewer's queue as its socket takes, straight from the shared frames
+static int viewer_write(Spectate* s, Viewer* v, long long now) {
+    struct iovec iov[SPECTATE_QUEUE];
+    
+    for (int i = 0; i < v->count; i++) {
+        SpecFrame* f = v->queue[(v->head + i) % SPECTATE_QUEUE];
+        size_t skip = i == 0 ? v->offset : 0;
+        iov[i].iov_base = f->data + skip;
+        iov[i].iov_len = f->len - skip;
+    }
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = v->count };
+    ssize_t n = sendmsg(v->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        return -1;
+    }
+    
+    if (n <= 0) {
+        // A viewer that takes nothing for too long is gone for good
+        if (!v->stalled_since) {
+            v->stalled_since = now;
+        } else if (now - v->stalled_since > SPECTATE_STALL_NS) {
+            s->dropped++;
+            return -1;
+        }
+        return 0;
+    }
+    v->stalled_since = 0;
+    v->bytes += n;
+    
+    size_t sent = n;
+    while (v->count > 0) {
+        SpecFrame* f = v->queue[v->head];
+        size_t left = f->len - v->offset;
+        if (sent < left) {
+            v->offset += sent;
+            break;
+        }
+        sent -= left;
+        v->offset = 0;
+        v->head = (v->head + 1) % SPECTATE_QUEUE;
+        v->count--;
+        frame_release(f);
+    }
+    return 0;
+}
+
+// Function to take every waiting viewer; each starts from a fresh keyframe
+static void accept_viewers(Spectate* s) {
+    int fd;
+    
+    while ((fd = accept4(s->lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        Viewer* v = NULL;
+        for (int i = 0; i < SPECTATE_MAX_VIEWERS && !v; i++) {
+            if (s->slots[i].fd < 0) {
+                v = &s->slots[i];
+            }
+        }
+        if (!v) {
+            close(fd); // Full
+            continue;
+        }
+        memset(v, 0, sizeof(Viewer));
+        v->fd = fd;
+        s->attached++;
+        __atomic_fetch_add(&s->viewers, 1, __ATOMIC_RELAXED);
+        request_key(s);
+    }
+}
+
+// Function to run the fan-out: accept viewers, queue published frames to them and write.
+// All socket work happens here, so the game thread's cost does not grow with the viewer count.
+static void* fan_out_thread(void* arg) {
+    Spectate* s = arg;
+    struct pollfd fds[2 + SPECTATE_MAX_VIEWERS];
+    int slot_of[2 + SPECTATE_MAX_VIEWERS];
+    SpecFrame* batch[SPECTATE_PENDING];
+    
+    trace_thread_start("spectate");
+    while (1) {
+        int nfds = 2;
+        fds[0] = (struct pollfd){ .fd = s->lfd, .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = s->wake_fd, .events = POLLIN };
+        for (int i = 0; i < SPECTATE_MAX_VIEWERS; i++) {
+            if (s->slots[i].fd >= 0) {
+                fds[nfds] = (struct pollfd){ .fd = s->slots[i].fd, .events = POLLIN | (s->slots[i].count ? POLLOUT : 0) };
+                slot_of[nfds++] = i;
+            }
+        }
+        
+        // Wake up now and then to notice viewers that stopped reading
+        if (poll(fds, nfds, 1000) < 0 && errno != EINTR) {
+            break;
+        }
+        long long now = now_ns();
+        
+        // Take everything published since the last round
+        drain_fd(s->wake_fd);
+        pthread_mutex_lock(&s->lock);
+        int stop = s->stop;
+        int n = s->pending_count;
+        memcpy(batch, s->pending, n * sizeof(SpecFrame*));
+        s->pending_count = 0;
+        pthread_mutex_unlock(&s->lock);
+        if (stop) {
+            for (int i = 0; i < n; i++) {
+                frame_release(batch[i]);
+            }
+            break;
+        }
+        
+        long long span = trace_begin();
+        if (__atomic_exchange_n(&s->lost, 0, __ATOMIC_RELAXED)) {
+            for (int i = 0; i < SPECTATE_MAX_VIEWERS; i++) {
+                if (s->slots[i].fd >= 0 && s->slots[i].synced) {
+                    viewer_skip(s, &s->slots[i]); // Missed a delta
+                }
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            fan_out(s, batch[i]);
+        }
+        
+        // Viewers never send anything that matters: read it away and notice hangups
+        for (int f = 2; f < nfds; f++) {
+            Viewer* v = &s->slots[slot_of[f]];
+            if (fds[f].revents & (POLLIN | POLLHUP | POLLERR)) {
+                char junk[256];
+                ssize_t got = recv(v->fd, junk, sizeof(junk), MSG_DONTWAIT);
+                if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    viewer_close(s, v);
+                }
+            }
+        }
+        
+        for (int i = 0; i < SPECTATE_MAX_VIEWERS; i++) {
+            Viewer* v = &s->slots[i];
+            if (v->fd >= 0 && v->count && viewer_write(s, v, now) < 0) {
+                viewer_close(s, v);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_viewers(s);
+        }
+        trace_end("fan-out", span);
+    }
+    trace_thread_exit();
+    return NULL;
+}
+
+// Function to start publishing a game on a Unix socket and the thread that serves it
+int spectate_open(Spectate* s, GameState* g, const char* path) {
+    memset(s, 0, sizeof(Spectate));
+    s->lfd = s->wake_fd = s->key_fd = -1;
+    for (int i = 0; i < SPECTATE_MAX_VIEWERS; i++) {
+        s->slots[i].fd = -1;
+    }
+    snprintf(s->path, sizeof(s->path), "%s", path);
+    pthread_mutex_init(&s->lock, NULL);
+    
+    s->prev_tanks = malloc(g->num_tanks * sizeof(Tank));
+    if (!s->prev_tanks || bit_layer_alloc(&s->prev_shots, g->width, g->height) < 0) {
+        spectate_close(s);
+        return -1;
+    }
+    s->lfd = net_listen_unix(path);
+    s->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    s->key_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (s->lfd < 0 || s->wake_fd < 0 || s->key_fd < 0 ||
+        pthread_create(&s->thread, NULL, fan_out_thread, s) != 0) {
+        spectate_close(s);
+        return -1;
+    }
+    s->running = 1;
+    return 0;
+}
+
+// Function to stop the fan-out thread, detach every viewer and remove the socket
+void spectate_close(Spectate* s) {
+    if (s->running) {
+        pthread_mutex_lock(&s->lock);
+        s->stop = 1;
+        pthread_mutex_unlock(&s->lock);
+        signal_fd(s->wake_fd);
+        pthread_join(s->thread, NULL);
+        s->running = 0;
+    }
+    for (int i = 0; i < SPECTATE_MAX_VIEWERS; i++) {
+        if (s->slots[i].fd >= 0) {
+            viewer_close(s, &s->slots[i]);
+        }
+    }
+    for (int i = 0; i < s->pending_count; i++) {
+        frame_release(s->pending[i]);
+    }
+    s->pending_count = 0;
+    if (s->lfd >= 0) {
+        close(s->lfd);
+        unlink(s->path);
+    }
+    if (s->wake_fd >= 0) {
+        close(s->wake_fd);
+    }
+    if (s->key_fd >= 0) {
+        close(s->key_fd);
+    }
+    s->lfd = s->wake_fd = s->key_fd = -1;
+    free(s->prev_tanks);
+    s->prev_tanks = NULL;
+    bit_layer_free(&s->prev_shots);
+    netbuf_free(&s->scratch);
+    pthread_mutex_destroy(&s->lock);
+}
+
+// Function to mark the start of a round: the next frame is a keyframe every viewer starts over from
+void spectate_round(Spectate* s) {
+    s->new_round = 1;
+}
+
+// Function to copy the encoded scratch buffer into a shared frame and pass it to the fan-out thread
+static void publish_frame(Spectate* s, int key, int resync) {
+    SpecFrame* f = malloc(sizeof(SpecFrame) + s->scratch.len);
+    if (!f) {
+        __atomic_store_n(&s->lost, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    f->refs = 1;
+    f->key = key;
+    f->resync = resync;
+    f->len = s->scratch.len;
+    memcpy(f->data, s->scratch.data, s->scratch.len);
+    
+    // Never wait for the fan-out thread: if it is that far behind, everyone resyncs later
+    pthread_mutex_lock(&s->lock);
+    int first = s->pending_count == 0; // Otherwise the fan-out thread is already due to wake
+    int queued = s->pending_count < SPECTATE_PENDING;
+    if (queued) {
+        s->pending[s->pending_count++] = f;
+    }
+    pthread_mutex_unlock(&s->lock);
+    if (!queued) {
+        free(f);
+        __atomic_store_n(&s->lost, 1, __ATOMIC_RELAXED);
+    }
+    
+    s->published++;
+    s->keys += key;
+    s->bytes_published += s->scratch.len;
+    if (first) {
+        signal_fd(s->wake_fd);
+    }
+}
+
+// Function to publish what changed since the last frame, once per game loop pass, on the game thread.
+// The frame is encoded once whatever the number of viewers; nothing is encoded while nobody watches.
+void spectate_publish(Spectate* s, GameState* g) {
+    int viewers = __atomic_load_n(&s->viewers, __ATOMIC_RELAXED);
+    int want_key = __atomic_exchange_n(&s->want_key, 0, __ATOMIC_RELAXED);
+    
+    if (want_key) {
+        drain_fd(s->key_fd);
+    }
+    if (!viewers && !want_key) {
+        s->have_baseline = 0; // Whoever comes next starts from a keyframe
+        return;
+    }
+    
+    long long start = now_ns();
+    long long span = trace_begin();
+    game_lock(g);
+    
+    // Delta for the viewers already in sync, against what the last frame left them with
+    if (s->have_baseline && !s->new_round) {
+        s->scratch.len = 0;
+        size_t frame = net_begin_frame(&s->scratch, MSG_SNAPSHOT);
+        netbuf_put_varint(&s->scratch, 0); // No input to echo
+        int changed = net_encode_snapshot(&s->scratch, g, s->prev_tanks, &s->prev_shots);
+        net_end_frame(&s->scratch, frame);
+        if (changed) {
+            publish_frame(s, 0, 0);
+        }
+    }
+    
+    // Keyframe for viewers starting out, and for everyone when the board is new
+    if (want_key || !s->have_baseline || s->new_round) {
+        s->scratch.len = 0;
+        net_encode_board(&s->scratch, g, -1);
+        size_t frame = net_begin_frame(&s->scratch, MSG_SNAPSHOT);
+        netbuf_put_varint(&s->scratch, 0);
+        net_encode_snapshot(&s->scratch, g, NULL, NULL);
+        net_end_frame(&s->scratch, frame);
+        publish_frame(s, 1, s->new_round);
+        
+        memcpy(s->prev_tanks, g->tanks, g->num_tanks * sizeof(Tank));
+        memcpy(s->prev_shots.bits, g->shot_bits.bits, (size_t)s->prev_shots.stride * g->height * sizeof(uint64_t));
+        s->have_baseline = 1;
+        s->new_round = 0;
+    }
+    
+    game_unlock(g);
+    trace_end("publish", span);
+    unsigned long long ns = now_ns() - start;
+    s->passes++;
+    s->publish_ns += ns;
+    if (ns > s->publish_ns_max) {
+        s->publish_ns_max = ns;
+    }
+}
+
+// Function to print what publishing cost the game thread and what the viewers got
+void spectate_print_stats(Spectate* s, FILE* out) {
+    if (s->published == 0) {
+        return;
+    }
+    fprintf(out, "spectate: %lu frames (%lu keyframes), %.1f bytes/frame, publish %.2f us/pass (max %.2f us) on the game thread\n",
+            s->published, s->keys, (double)s->bytes_published / s->published,
+            s->publish_ns / 1000.0 / s->passes, s->publish_ns_max / 1000.0);
+    fprintf(out, "spectate: %lu viewers attached, %lu skipped forward to a keyframe, %lu dropped\n",
+            s->attached, s->skipped, s->dropped);
+}
@@ -0,0 +1,78 @@
+#ifndef TANK_SPECTATE_H
+#define TANK_SPECTATE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "game.h"
+#include "net.h"
+
+#define SPECTATE_MAX_VIEWERS 64
+#define SPECTATE_QUEUE 32 // Frames queued for one viewer before it is skipped forward to a keyframe
+#define SPECTATE_PENDING 64 // Frames published but not yet handed to the viewers
+#define SPECTATE_STALL_NS (5 * 1000000000LL) // A viewer that takes no bytes for this long is dropped
+
+// One published frame, shared by every viewer queue that holds it and freed with the last one
+typedef struct {
+    int refs; // Only the fan-out thread touches it once the frame is published
+    int key; // Board and full snapshot, a viewer can start from it
+    int resync; // New round: every viewer starts over from this frame
+    size_t len;
+    unsigned char data[];
+} SpecFrame;
+
+// One attached viewer, owned by the fan-out thread
+typedef struct {
+    int fd; // -1 for a free slot
+    SpecFrame* queue[SPECTATE_QUEUE];
+    int head, count;
+    size_t offset; // Bytes of the head frame already sent
+    int synced; // Has a keyframe and every delta since
+    long long stalled_since; // When the socket stopped taking bytes, 0 while it keeps up
+    unsigned long long bytes;
+    unsigned long frames;
+    unsigned long skips;
+} Viewer;
+
+// Read-only fan-out of snapshots to local viewers over a Unix socket.
+// The game thread encodes each frame once; a thread of its own queues it to every viewer and writes.
+typedef struct Spectate {
+    int lfd;
+    int wake_fd; // eventfd: frames pending or stop requested
+    int key_fd; // eventfd: the fan-out thread wants a keyframe, for a game loop that is idle
+    char path[108];
+    pthread_t thread;
+    int running;
+
+    pthread_mutex_t lock; // Guards pending, pending_count and stop
+    SpecFrame* pending[SPECTATE_PENDING];
+    int pending_count;
+    int stop;
+    int want_key; // Atomic, set by the fan-out thread
+    int lost; // Atomic, pending was full and a frame was thrown away
+    int viewers; // Atomic, viewers attached
+
+    // Game thread only
+    Tank* prev_tanks; // What the last published frame left the viewers with
+    BitLayer prev_shots;
+    int have_baseline;
+    int new_round;
+    NetBuf scratch;
+    unsigned long passes; // Calls that had viewers to publish for
+    unsigned long published, keys;
+    unsigned long long bytes_published;
+    unsigned long long publish_ns, publish_ns_max;
+
+    // Fan-out thread only
+    Viewer slots[SPECTATE_MAX_VIEWERS];
+    unsigned long attached, skipped, dropped;
+} Spectate;
+
+int spectate_open(Spectate* s, GameState* g, const char* path);
+void spectate_close(Spectate* s);
+void spectate_round(Spectate* s);
+void spectate_publish(Spectate* s, GameState* g);
+void spectate_print_stats(Spectate* s, FILE* out);
+
+#endif
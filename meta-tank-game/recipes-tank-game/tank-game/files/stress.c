@@ -0,0 +1,490 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "ai.h"
+
+// Stress defaults
+#define DEFAULT_SECONDS 10
+#define DEFAULT_INPUT_THREADS 4
+#define DEFAULT_READERS 1
+#define DEFAULT_REPORT 60
+#define MAX_THREADS 64
+#define HANDLES_HELD 16 // Projectile handles each reader keeps across lock holds
+
+// Tick latency histogram: 16 buckets per power of two, so a percentile is within 1/16 of its value
+#define LAT_SUB 16
+#define LAT_BUCKETS (64 * LAT_SUB)
+
+// One stress run's settings
+typedef struct {
+    int width, height;
+    int tanks;
+    int input_threads;
+    int readers;
+    int seconds;
+    int report; // Seconds between progress lines, 0 for none
+    long rate; // Actions per second per input thread, 0 for as fast as possible
+    int paced; // Tick at the game's own rate instead of flat out
+    int ai; // Bots are driven by the AI, the input threads drive the players
+    unsigned int seed;
+} StressConfig;
+
+// One input or reader thread
+typedef struct {
+    int id;
+    pthread_t thread;
+    Rng rng;
+    unsigned long long ops; // Actions sent, or handles resolved by a reader
+    unsigned long long stale; // Reader handles whose slot was released since
+} Worker;
+
+static const StressConfig* cfg;
+static GameState game;
+static pthread_rwlock_t round_lock = PTHREAD_RWLOCK_INITIALIZER; // Held for writing while a round is reset
+static int stop; // Atomic
+static unsigned long long latency[LAT_BUCKETS];
+
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to find the histogram bucket of a latency
+static int lat_bucket(long long ns) {
+    if (ns < LAT_SUB) {
+        return ns < 0 ? 0 : (int)ns;
+    }
+    int msb = 63 - __builtin_clzll((unsigned long long)ns);
+    return (msb - 3) * LAT_SUB + (int)((ns >> (msb - 4)) & (LAT_SUB - 1));
+}
+
+// Function to give the largest latency a bucket holds
+static long long lat_upper(int b) {
+    if (b < LAT_SUB) {
+        return b;
+    }
+    int shift = b / LAT_SUB - 1;
+    return ((long long)(LAT_SUB + b % LAT_SUB) << shift) + (1LL << shift) - 1;
+}
+
+// Function to read a percentile (0..1) off the latency histogram, in nanoseconds
+static long long lat_percentile(double q) {
+    unsigned long long total = 0;
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+        total += latency[b];
+    }
+    unsigned long long want = (unsigned long long)(q * total + 0.999999);
+    if (want < 1) {
+        want = 1;
+    }
+    unsigned long long seen = 0;
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+        seen += latency[b];
+        if (seen >= want) {
+            return lat_upper(b);
+        }
+    }
+    return 0;
+}
+
+// Function to describe a broken invariant, returns 1 for the check to pass on
+static int violation(char* why, size_t len, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(why, len, fmt, ap);
+    va_end(ap);
+    return 1;
+}
+
+// Function to check that the walls agree with their transpose; they only change between rounds
+static int check_walls(GameState* g, char* why, size_t len) {
+    for (int y = 0; y < g->height; y++) {
+        for (int x = 0; x < g->width; x++) {
+            if (WALL_AT(g, x, y) != bit_test(&g->walls_col, y, x)) {
+                return violation(why, len, "wall layers disagree at (%d, %d)", x, y);
+            }
+        }
+    }
+    return 0;
+}
+
+// Function to check the board and the projectile pool against each other (caller holds board_mutex).
+// Returns 0 when every invariant holds, else 1 with the first broken one described in why.
+static int check_board(GameState* g, unsigned char* slot_seen, BitLayer* scratch, char* why, size_t len) {
+    // Every live tank is on its own cell in all three tank layers, dead tanks are on none
+    int alive = 0;
+    for (int i = 0; i < g->num_tanks; i++) {
+        Tank* t = &g->tanks[i];
+        if (t->health <= 0) {
+            continue;
+        }
+        alive++;
+        if (t->x < 0 || t->x >= g->width || t->y < 0 || t->y >= g->height) {
+            return violation(why, len, "tank %d off the board at (%d, %d)", i, t->x, t->y);
+        }
+        if (ENTITY(g, t->x, t->y) != TANK_ENTITY(i)) {
+            return violation(why, len, "tank %d missing from the entity layer at (%d, %d)", i, t->x, t->y);
+        }
+        if (WALL_AT(g, t->x, t->y)) {
+            return violation(why, len, "tank %d inside a wall at (%d, %d)", i, t->x, t->y);
+        }
+    }
+    if (alive != g->tanks_alive) {
+        return violation(why, len, "tanks_alive is %d with %d live tanks", g->tanks_alive, alive);
+    }
+    if (g->game_over != (alive <= 1)) {
+        return violation(why, len, "game_over is %d with %d live tanks", g->game_over, alive);
+    }
+    
+    // Every occupied cell names a live tank that stands there, so no two tanks share a cell
+    for (int y = 0; y < g->height; y++) {
+        for (int x = 0; x < g->width; x++) {
+            EntityId e = ENTITY(g, x, y);
+            if (TANK_AT(g, x, y) != (e != NO_ENTITY) || bit_test(&g->tank_bits_col, y, x) != (e != NO_ENTITY)) {
+                return violation(why, len, "tank layers disagree at (%d, %d)", x, y);
+            }
+            if (e != NO_ENTITY) {
+                int i = ENTITY_TANK(e);
+                if (i < 0 || i >= g->num_tanks || g->tanks[i].health <= 0 ||
+                    g->tanks[i].x != x || g->tanks[i].y != y) {
+                    return violation(why, len, "entity at (%d, %d) names tank %d, which is not there", x, y, i);
+                }
+            }
+        }
+    }
+    
+    // Free slots are distinct released slots below the high-water mark, the rest are in flight
+    memset(slot_seen, 0, g->max_projectiles);
+    for (int k = 0; k < g->num_free; k++) {
+        int s = g->free_slots[k];
+        if (s >= g->projectile_hwm || slot_seen[s] || g->projectiles[s].active) {
+            return violation(why, len, "free list entry %d holds slot %d, which is not free", k, s);
+        }
+        slot_seen[s] = 1;
+    }
+    int active = 0;
+    for (int s = 0; s < g->projectile_hwm; s++) {
+        Projectile* p = &g->projectiles[s];
+        if (!p->active) {
+            if (!slot_seen[s]) {
+                return violation(why, len, "released slot %d missing from the free list", s);
+            }
+            continue;
+        }
+        active++;
+        if (p->x < 0 || p->x >= g->width || p->y < 0 || p->y >= g->height) {
+            return violation(why, len, "projectile %d off the board at (%d, %d)", s, p->x, p->y);
+        }
+        if (WALL_AT(g, p->x, p->y) || !SHOT_AT(g, p->x, p->y)) {
+            return violation(why, len, "projectile %d in a wall or missing from the shot layer at (%d, %d)", s, p->x, p->y);
+        }
+        if (p->owner < 0 || p->owner >= g->num_tanks) {
+            return violation(why, len, "projectile %d has no owner", s);
+        }
+    }
+    if (active != g->num_projectiles || active + g->num_free != g->projectile_hwm) {
+        return violation(why, len, "num_projectiles is %d with %d slots in flight and %d free of %d", g->num_projectiles, active, g->num_free, g->projectile_hwm);
+    }
+    
+    // The shot layer holds nothing but projectiles: lift them off a copy and nothing may be left
+    memcpy(scratch->bits, g->shot_bits.bits, (size_t)scratch->stride * g->height * sizeof(uint64_t));
+    for (int s = 0; s < g->projectile_hwm; s++) {
+        if (g->projectiles[s].active) {
+            bit_clear(scratch, g->projectiles[s].x, g->projectiles[s].y);
+        }
+    }
+    for (size_t w = 0; w < (size_t)scratch->stride * g->height; w++) {
+        if (scratch->bits[w]) {
+            int x = (int)(w % scratch->stride) * 64 + __builtin_ctzll(scratch->bits[w]);
+            return violation(why, len, "shot layer has (%d, %d) set without a projectile", x, (int)(w / scratch->stride));
+        }
+    }
+    return 0;
+}
+
+// Function to sleep until an absolute monotonic time
+static void sleep_until(long long when) {
+    struct timespec ts = { .tv_sec = when / 1000000000LL, .tv_nsec = when % 1000000000LL };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+// Function run by each input thread: random actions for random tanks the AI does not drive
+static void* input_thread(void* arg) {
+    Worker* w = arg;
+    int drivable = cfg->ai ? NUM_PLAYERS : cfg->tanks;
+    long long gap = cfg->rate > 0 ? 1000000000LL / cfg->rate : 0;
+    long long next = now_ns();
+    
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        int tank = rng_below(&w->rng, drivable);
+        Action action = (Action)rng_below(&w->rng, NUM_ACTIONS);
+        
+        pthread_rwlock_rdlock(&round_lock);
+        tank_action(&game, tank, action);
+        pthread_rwlock_unlock(&round_lock);
+        w->ops++;
+        
+        if (gap) {
+            next += gap;
+            sleep_until(next);
+        }
+    }
+    return NULL;
+}
+
+// Function run by each reader thread: hold projectile handles across lock holds and resolve them later,
+// the way a renderer or a remote view would, while the tick thread releases and reuses the slots
+static void* reader_thread(void* arg) {
+    Worker* w = arg;
+    ProjectileHandle held[HANDLES_HELD];
+    
+    for (int k = 0; k < HANDLES_HELD; k++) {
+        held[k] = PROJECTILE_NONE;
+    }
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        pthread_rwlock_rdlock(&round_lock);
+        game_lock(&game);
+        for (int k = 0; k < HANDLES_HELD; k++) {
+            Projectile* p = projectile_get(&game, held[k]);
+            if (p && (p->x < 0 || p->x >= game.width || p->y < 0 || p->y >= game.height)) {
+                fprintf(stderr, "tank-stress: handle resolved to a projectile off the board\n");
+                abort();
+            }
+            w->ops += held[k] != PROJECTILE_NONE;
+            w->stale += held[k] != PROJECTILE_NONE && !p;
+            
+            // Swap in a handle to a random slot that is in flight now
+            held[k] = PROJECTILE_NONE;
+            if (game.projectile_hwm > 0) {
+                int slot = rng_below(&w->rng, game.projectile_hwm);
+                if (game.projectiles[slot].active) {
+                    held[k] = projectile_handle(&game, slot);
+                }
+            }
+        }
+        game_unlock(&game);
+        pthread_rwlock_unlock(&round_lock);
+        sched_yield();
+    }
+    return NULL;
+}
+
+// Function to start the next round while no input or reader thread is inside the game
+static void next_round(GameState* g, unsigned int seed) {
+    pthread_rwlock_wrlock(&round_lock);
+    reset_game(g, seed);
+    pthread_rwlock_unlock(&round_lock);
+}
+
+// Function to print the latency percentiles so far
+static void print_latency(FILE* out) {
+    fprintf(out, "tick latency: p50 %.2f us  p99 %.2f us  p999 %.2f us  max %.2f us\n",
+            lat_percentile(0.5) / 1000.0, lat_percentile(0.99) / 1000.0,
+            lat_percentile(0.999) / 1000.0, lat_percentile(1.0) / 1000.0);
+}
+
+// Function to run the tick thread until the time is up or an invariant breaks, returns the violation count
+static int run_stress(Worker* workers, int count) {
+    unsigned char* slot_seen = malloc(game.max_projectiles);
+    BitLayer scratch;
+    char why[160];
+    unsigned long ticks = 0, rounds = 1;
+    int failed = 0;
+    long long start = now_ns();
+    long long end = start + cfg->seconds * 1000000000LL;
+    long long next_report = start + cfg->report * 1000000000LL;
+    long long deadline = start;
+    
+    if (!slot_seen || bit_layer_alloc(&scratch, game.width, game.height) < 0) {
+        free(slot_seen);
+        return 1;
+    }
+    if (check_walls(&game, why, sizeof(why))) {
+        fprintf(stderr, "tank-stress: round 1: %s\n", why);
+        bit_layer_free(&scratch);
+        free(slot_seen);
+        return 1;
+    }
+    
+    while (!failed) {
+        long long now = now_ns();
+        if (now >= end) {
+            break;
+        }
+        if (cfg->report && now >= next_report) {
+            unsigned long long ops = 0;
+            for (int i = 0; i < count; i++) {
+                ops += workers[i].ops;
+            }
+            printf("stress: %.0f s, %lu ticks, %lu rounds, %llu operations\n", (now - start) / 1e9, ticks, rounds, ops);
+            print_latency(stdout);
+            fflush(stdout);
+            next_report += cfg->report * 1000000000LL;
+        }
+        if (cfg->paced) {
+            deadline += TICK_USEC * 1000LL;
+            sleep_until(deadline);
+        }
+        
+        long long t0 = now_ns();
+        simulation_tick(&game);
+        latency[lat_bucket(now_ns() - t0)]++;
+        ticks++;
+        
+        game_lock(&game);
+        failed = check_board(&game, slot_seen, &scratch, why, sizeof(why));
+        int over = game.game_over;
+        game_unlock(&game);
+        
+        if (failed) {
+            fprintf(stderr, "tank-stress: round %lu tick %lu: %s\n", rounds, game.tick, why);
+        } else if (over) {
+            next_round(&game, cfg->seed + rounds++);
+            failed = check_walls(&game, why, sizeof(why));
+            if (failed) {
+                fprintf(stderr, "tank-stress: round %lu: %s\n", rounds, why);
+            }
+        }
+    }
+    
+    double secs = (now_ns() - start) / 1e9;
+    printf("stress: %dx%d board, %d tanks, %d input threads, %d readers: %lu ticks in %.1f s (%.0f ticks/s), %lu rounds\n",
+           cfg->width, cfg->height, cfg->tanks, cfg->input_threads, cfg->readers, ticks, secs, ticks / secs, rounds);
+    print_latency(stdout);
+    printf("invariants: %s after %lu checked ticks\n", failed ? "BROKEN" : "held", ticks);
+    
+    bit_layer_free(&scratch);
+    free(slot_seen);
+    return failed;
+}
+
+// Function to print command line help
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-b WxH] [-n tanks] [-j threads] [-R readers] [-d seconds] [-r rate] [-i seconds] [-s seed] [-a] [-p]\n"
+            "  -b  board size (default %dx%d)\n"
+            "  -n  tanks on the board, players plus bots (default 16)\n"
+            "  -j  input threads sending moves and shots (default %d)\n"
+            "  -R  reader threads resolving projectile handles (default %d)\n"
+            "  -d  seconds to run (default %d)\n"
+            "  -r  actions per second per input thread (default as fast as possible)\n"
+            "  -i  seconds between progress lines, 0 for none (default %d)\n"
+            "  -s  seed for the boards and the input (default 1)\n"
+            "  -a  let the AI drive the bots, the input threads drive the players\n"
+            "  -p  tick at the game's own rate instead of flat out\n",
+            prog, BOARD_WIDTH, BOARD_HEIGHT, DEFAULT_INPUT_THREADS, DEFAULT_READERS, DEFAULT_SECONDS, DEFAULT_REPORT);
+}
+
+int main(int argc, char* argv[]) {
+    StressConfig config = {
+        .width = BOARD_WIDTH, .height = BOARD_HEIGHT, .tanks = 16,
+        .input_threads = DEFAULT_INPUT_THREADS, .readers = DEFAULT_READERS,
+        .seconds = DEFAULT_SECONDS, .report = DEFAULT_REPORT, .seed = 1
+    };
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "b:n:j:R:d:r:i:s:ap")) != -1) {
+        switch (opt) {
+            case 'b':
+                if (sscanf(optarg, "%dx%d", &config.width, &config.height) != 2) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'n':
+                config.tanks = atoi(optarg);
+                break;
+            case 'j':
+                config.input_threads = atoi(optarg);
+                break;
+            case 'R':
+                config.readers = atoi(optarg);
+                break;
+            case 'd':
+                config.seconds = atoi(optarg);
+                break;
+            case 'r':
+                config.rate = atol(optarg);
+                break;
+            case 'i':
+                config.report = atoi(optarg);
+                break;
+            case 's':
+                config.seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'a':
+                config.ai = 1;
+                break;
+            case 'p':
+                config.paced = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    int count = config.input_threads + config.readers;
+    if (config.seconds <= 0 || config.tanks < NUM_PLAYERS || config.tanks > MAX_TANKS ||
+        config.input_threads < 1 || config.readers < 0 || count > MAX_THREADS || config.report < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    cfg = &config;
+    
+    if (game_init(&game, config.width, config.height, MAX_PROJECTILES, config.tanks) < 0) {
+        fprintf(stderr, "tank-stress: cannot allocate %dx%d board\n", config.width, config.height);
+        return 1;
+    }
+    Ai ai;
+    if (config.ai && ai_init(&ai, &game, 0) < 0) {
+        game_free(&game);
+        return 1;
+    }
+    setup_tanks(&game, 'A', 'B');
+    reset_game(&game, config.seed);
+    
+    Worker workers[MAX_THREADS];
+    int started = 0;
+    for (int i = 0; i < count; i++) {
+        Worker* w = &workers[i];
+        memset(w, 0, sizeof(*w));
+        w->id = i;
+        rng_seed(&w->rng, config.seed * 7919ULL + i);
+        if (pthread_create(&w->thread, NULL, i < config.input_threads ? input_thread : reader_thread, w) != 0) {
+            fprintf(stderr, "tank-stress: cannot start thread %d\n", i);
+            break;
+        }
+        started++;
+    }
+    
+    int failed = started < count || run_stress(workers, started);
+    
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    unsigned long long actions = 0, resolved = 0, stale = 0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        if (i < config.input_threads) {
+            actions += workers[i].ops;
+        } else {
+            resolved += workers[i].ops;
+            stale += workers[i].stale;
+        }
+    }
+    printf("stress: %llu actions, %llu held handles resolved (%llu stale)\n", actions, resolved, stale);
+    
+    if (config.ai) {
+        ai_print_stats(&ai, stdout);
+        ai_free(&ai, &game);
+    }
+    game_free(&game);
+    return failed;
+}
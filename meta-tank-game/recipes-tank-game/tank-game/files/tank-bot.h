@@ -0,0 +1,84 @@
+#ifndef TANK_BOT_H
+#define TANK_BOT_H
+
+// Bot plugin ABI. A plugin is a shared object loaded with tank-game -B; it includes only this header.
+// Structs here only ever grow at the end, and TANK_BOT_ABI_VERSION changes when anything else does.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TANK_BOT_ABI_VERSION 1
+#define TANK_BOT_ENTRY "tank_bot_plugin" // Symbol the game looks up: const TankBotPlugin* tank_bot_plugin(void)
+
+// What a bot does this tick; directions move (or turn, when blocked), as a held key would
+enum {
+    TANK_BOT_UP, TANK_BOT_DOWN, TANK_BOT_LEFT, TANK_BOT_RIGHT, TANK_BOT_FIRE, TANK_BOT_IDLE
+};
+
+// Read-only view of the live game, nothing is copied for it. Pointers stay valid for the whole game;
+// what they point at only changes between act() calls, unless the bot runs past its budget.
+// Tanks and projectiles are arrays of the game's own structs: use the sizes and offsets, or the accessors below.
+typedef struct {
+    uint32_t abi_version;
+    uint32_t size; // sizeof the view the game filled in
+    int32_t width, height;
+    int32_t self; // Tank this call is for
+    int32_t num_tanks;
+    uint64_t tick; // Ticks since the round started
+    uint32_t round; // Bumped every time a new round starts
+
+    // Boards: bit x of row y is (rows[y * stride + x / 64] >> x % 64) & 1
+    uint32_t stride; // 64-bit words per row
+    const uint64_t* walls;
+    const uint64_t* tanks_at; // Cells with a live tank
+    const uint64_t* shots_at; // Cells with at least one projectile
+    const uint16_t* entity; // height * width row-major: 0 empty, tank i is i + 1
+
+    // Tanks: int32 fields at these offsets of each tank_size-byte element
+    const void* tanks;
+    uint32_t tank_size;
+    uint32_t tank_x, tank_y, tank_health, tank_dir;
+
+    // Projectiles: slots [0, projectile_slots) of the pool, skip those whose active field is 0
+    const void* projectiles;
+    uint32_t projectile_size;
+    uint32_t projectile_x, projectile_y, projectile_dir, projectile_active, projectile_owner;
+    int32_t projectile_slots;
+    int32_t num_projectiles;
+
+    // Velocity of each projectile in 1/256ths of a cell per tick; present when size reaches past them
+    uint32_t projectile_vx, projectile_vy;
+} TankBotView;
+
+// A plugin: create() makes the state of one tank's bot, act() picks its action every tick
+typedef struct {
+    uint32_t abi_version; // TANK_BOT_ABI_VERSION the plugin was built with
+    const char* name;
+    void* (*create)(const TankBotView* view, int tank); // NULL is a valid state
+    int (*act)(void* bot, const TankBotView* view); // Returns a TANK_BOT_* action
+    void (*destroy)(void* bot);
+} TankBotPlugin;
+
+typedef const TankBotPlugin* (*TankBotEntry)(void);
+
+// Function to read one int32 field of a tank or projectile
+static inline int32_t tank_bot_field(const void* base, uint32_t size, int index, uint32_t offset) {
+    return *(const int32_t*)((const char*)base + (uint64_t)size * index + offset);
+}
+
+// Function to test one cell of a board
+static inline int tank_bot_cell(const TankBotView* v, const uint64_t* rows, int x, int y) {
+    return (rows[(uint64_t)y * v->stride + (x >> 6)] >> (x & 63)) & 1;
+}
+
+#define TANK_BOT_TANK(v, i, field) tank_bot_field((v)->tanks, (v)->tank_size, (i), (v)->tank_##field)
+#define TANK_BOT_PROJECTILE(v, i, field) tank_bot_field((v)->projectiles, (v)->projectile_size, (i), (v)->projectile_##field)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
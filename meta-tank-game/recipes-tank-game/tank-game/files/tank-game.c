@@ -1,439 +1,337 @@
 #include <ncurses.h>
-#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <time.h>
 #include <locale.h>
+#include <poll.h>
+#include <sys/timerfd.h>
 
-// Constants
-#define MAX_TANKS 2
-#define MAX_PROJECTILES 100
-#define BOARD_HEIGHT 20
-#define BOARD_WIDTH 60
-#define WALL_CHAR '#'
-#define PROJECTILE_CHAR '.'
-#define HEART_STR "<3"  // Using text emoticon heart
-#define MAX_HEALTH 10
-#define PROJECTILE_SPEED 100000 // microseconds
+#include "game.h"
+#include "render.h"
+#include "map.h"
+#include "gamelog.h"
+#include "net.h"
+#include "ai.h"
+#include "spectate.h"
+#include "evdev.h"
+#include "checkpoint.h"
+#include "bot.h"
+#include "terminal.h"
+#include "telemetry.h"
 
-// Color pairs
-#define COLOR_PLAYER1 1
-#define COLOR_PLAYER2 2
-#define COLOR_WALL 3
-#define COLOR_PROJECTILE 4
-#define COLOR_HEART 5
+#define MAX_CATCHUP_TICKS 10 // Most ticks run for one timer wakeup
+#define WORKLOAD_SEED 1 // Every -W run plays the same rounds, so builds can be compared
 
-// Direction enum
-typedef enum {
-    UP, DOWN, LEFT, RIGHT
-} Direction;
+// Global game state
+static GameState game;
+static GameLog game_log; // Used when recording with -R
+static Ai game_ai; // Used with -b or -A
+static Spectate game_spectate; // Used with -V
+static int spectating;
+static Evdev game_keys; // Used with -K or -E
+static int keyboard; // Keys come from game_keys, the terminal only quits
+static Checkpoint game_checkpoint; // Used with -k
+static int checkpointing;
+static BotHost game_bots; // Used with -B
+static int plugins;
+static Terminals game_terms; // Used with -t
+static int terminals;
+static Telemetry game_telemetry; // Used with -L
 
-// Tank structure
+// Input-to-screen latency, measured from poll() waking on stdin to the end of refresh()
 typedef struct {
-    char symbol;
-    int x, y;
-    int health;
-    Direction dir;
-    pthread_t thread;
-    char up_key, down_key, left_key, right_key, fire_key;
-} Tank;
+    unsigned long events;
+    unsigned long long ns_total;
+    unsigned long ns_max;
+} LatencyStats;
 
-// Projectile structure
-typedef struct {
-    int x, y;
-    Direction dir;
-    pthread_t thread;
-    int active;
-    char owner; // Tank symbol that fired this projectile
-} Projectile;
+static LatencyStats input_latency;
 
-// Game state structure
-typedef struct {
-    char board[BOARD_HEIGHT][BOARD_WIDTH];
-    Tank tanks[MAX_TANKS];
-    Projectile projectiles[MAX_PROJECTILES];
-    int num_projectiles;
-    int game_over;
-    int winner; // Index of winning tank (-1 if no winner yet)
-    pthread_mutex_t board_mutex;
-} GameState;
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-// Global game state
-GameState game;
+// Function to arm or disarm the periodic simulation timer
+static void set_tick_timer(int tfd, int armed) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (armed) {
+        its.it_interval.tv_nsec = TICK_USEC * 1000L;
+        its.it_value = its.it_interval;
+    }
+    timerfd_settime(tfd, 0, &its, NULL);
+}
 
-// Function to initialize the board with walls
-void init_board() {
-    pthread_mutex_lock(&game.board_mutex);
-    
-    // Clear the board
-    for (int y = 0; y < BOARD_HEIGHT; y++) {
-        for (int x = 0; x < BOARD_WIDTH; x++) {
-            if (y == 0 || y == BOARD_HEIGHT - 1 || x == 0 || x == BOARD_WIDTH - 1) {
-                game.board[y][x] = WALL_CHAR; // Border walls
-            } else {
-                game.board[y][x] = ' '; // Empty space
-            }
-        }
+// Function to run one round, returns 1 if the player asked to quit the program
+static int game_loop(int tfd) {
+    struct pollfd fds[4 + EVDEV_MAX_DEVICES + 1] = {
+        { .fd = STDIN_FILENO, .events = POLLIN },
+        { .fd = tfd, .events = POLLIN },
+        { .fd = spectating ? game_spectate.key_fd : -1, .events = POLLIN }, // A new viewer needs a keyframe
+        { .fd = terminals ? game_terms.event_fd : -1, .events = POLLIN }, // Keys typed on the -t terminals
+    };
+    int armed = 0;
+    
+    // Keyboards (or a capture being replayed) after the fixed descriptors
+    int nfds = 4 + (keyboard ? evdev_pollfds(&game_keys, fds + 4, EVDEV_MAX_DEVICES + 1) : 0);
+    
+    nodelay(stdscr, TRUE); // getch() only drains what poll() reported
+    render_game(&game);
+    if (terminals) {
+        terminals_publish(&game_terms, &game);
     }
     
-    // Add some random walls (simple maze)
-    srand(time(NULL));
-    for (int i = 0; i < (BOARD_HEIGHT * BOARD_WIDTH) / 20; i++) {
-        int x = rand() % (BOARD_WIDTH - 2) + 1;
-        int y = rand() % (BOARD_HEIGHT - 2) + 1;
+    while (!game.game_over) {
+        // The timer only runs while projectiles fly or keys are held
+        int want_ticks = simulation_active(&game);
+        if (want_ticks != armed) {
+            set_tick_timer(tfd, want_ticks);
+            armed = want_ticks;
+        }
         
-        // Avoid placing walls near tank starting positions
-        if ((x < 5 && y < 5) || (x > BOARD_WIDTH - 6 && y > BOARD_HEIGHT - 6)) {
-            continue;
+        long long idle = trace_begin();
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
         }
+        long long woke = now_ns();
+        int had_input = 0;
+        trace_end("poll", idle);
         
-        game.board[y][x] = WALL_CHAR;
-    }
-    
-    pthread_mutex_unlock(&game.board_mutex);
-}
-
-// Function to place tanks on the board
-void place_tanks() {
-    pthread_mutex_lock(&game.board_mutex);
-    
-    // Place tank 1 in the top-left corner
-    game.tanks[0].x = 2;
-    game.tanks[0].y = 2;
-    game.board[game.tanks[0].y][game.tanks[0].x] = game.tanks[0].symbol;
-    
-    // Place tank 2 in the bottom-right corner
-    game.tanks[1].x = BOARD_WIDTH - 3;
-    game.tanks[1].y = BOARD_HEIGHT - 3;
-    game.board[game.tanks[1].y][game.tanks[1].x] = game.tanks[1].symbol;
-    
-    pthread_mutex_unlock(&game.board_mutex);
-}
-
-// Function to render the game
-void render_game() {
-    clear();
-    
-    pthread_mutex_lock(&game.board_mutex);
-    
-    // Display the board
-    for (int y = 0; y < BOARD_HEIGHT; y++) {
-        for (int x = 0; x < BOARD_WIDTH; x++) {
-            char cell = game.board[y][x];
-            
-            // Set appropriate colors based on cell content
-            if (cell == game.tanks[0].symbol) {
-                attron(COLOR_PAIR(COLOR_PLAYER1));
-                mvaddch(y, x, cell);
-                attroff(COLOR_PAIR(COLOR_PLAYER1));
-            } 
-            else if (cell == game.tanks[1].symbol) {
-                attron(COLOR_PAIR(COLOR_PLAYER2));
-                mvaddch(y, x, cell);
-                attroff(COLOR_PAIR(COLOR_PLAYER2));
+        // Drain every pending key into the per-tank input state
+        if (fds[0].revents & (POLLHUP | POLLERR)) {
+            return 1; // Terminal went away
+        }
+        if (fds[0].revents & POLLIN) {
+            long long span = trace_begin();
+            int ch;
+            while ((ch = getch()) != ERR) {
+                if (ch == 'q') {
+                    game.game_over = 1; // Exit game loop
+                    set_tick_timer(tfd, 0);
+                    return 1; // Exit program
+                }
+                if (!keyboard) {
+                    handle_input(&game, ch); // With a keyboard backend the same keys arrive from there
+                }
             }
-            else if (cell == WALL_CHAR) {
-                attron(COLOR_PAIR(COLOR_WALL));
-                mvaddch(y, x, cell);
-                attroff(COLOR_PAIR(COLOR_WALL));
+            had_input = 1;
+            trace_end("input", span);
+        }
+        
+        // Key downs and ups from the keyboards: every key held is acted on until it is released
+        int key_events = 0;
+        for (int i = 4; i < nfds; i++) {
+            key_events |= fds[i].revents;
+        }
+        if (key_events) {
+            long long span = trace_begin();
+            if (evdev_read(&game_keys, &game) < 0) {
+                keyboard = 0; // Every keyboard was unplugged, the terminal takes over
+                nfds = 4;
             }
-            else if (cell == PROJECTILE_CHAR) {
-                attron(COLOR_PAIR(COLOR_PROJECTILE));
-                mvaddch(y, x, cell);
-                attroff(COLOR_PAIR(COLOR_PROJECTILE));
+            had_input = 1;
+            trace_end("input", span);
+            if (evdev_key_down(&game_keys, KEY_Q)) {
+                game.game_over = 1;
+                set_tick_timer(tfd, 0);
+                return 1;
             }
-            else {
-                mvaddch(y, x, cell);
+        }
+        
+        // The other terminals already applied their keys, this only wakes the timer or quits
+        if (fds[3].revents & POLLIN) {
+            if (terminals_events(&game_terms)) {
+                game.game_over = 1;
+                set_tick_timer(tfd, 0);
+                return 1;
+            }
+            had_input = 1;
+        }
+        
+        // Run the ticks the timer has accumulated
+        if (fds[1].revents & POLLIN) {
+            uint64_t expirations;
+            if (read(tfd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                if (expirations > MAX_CATCHUP_TICKS) {
+                    expirations = MAX_CATCHUP_TICKS; // Don't spiral after a long stall
+                }
+                while (expirations-- > 0 && !game.game_over) {
+                    if (plugins) {
+                        bot_tick(&game_bots, &game);
+                    }
+                    simulation_tick(&game);
+                    if (checkpointing) {
+                        checkpoint_tick(&game_checkpoint, &game);
+                    }
+                }
+            }
+        }
+        
+        // Render game
+        render_game(&game);
+        if (spectating) {
+            spectate_publish(&game_spectate, &game);
+        }
+        if (terminals) {
+            terminals_publish(&game_terms, &game);
+        }
+        
+        if (had_input) {
+            unsigned long ns = now_ns() - woke;
+            input_latency.events++;
+            input_latency.ns_total += ns;
+            if (ns > input_latency.ns_max) {
+                input_latency.ns_max = ns;
             }
         }
     }
     
-    // Display player health as hearts
-    mvprintw(0, BOARD_WIDTH + 2, "Player %c: ", game.tanks[0].symbol);
-    attron(COLOR_PAIR(COLOR_HEART));
-    for (int i = 0; i < game.tanks[0].health; i++) {
-        mvaddstr(0, BOARD_WIDTH + 11 + i*2, HEART_STR);  // Multiplying by 2 to account for the width of "<3"
-    }
-    attroff(COLOR_PAIR(COLOR_HEART));
-    
-    mvprintw(1, BOARD_WIDTH + 2, "Player %c: ", game.tanks[1].symbol);
-    attron(COLOR_PAIR(COLOR_HEART));
-    for (int i = 0; i < game.tanks[1].health; i++) {
-        mvaddstr(1, BOARD_WIDTH + 11 + i*2, HEART_STR);  // Multiplying by 2 to account for the width of "<3"
-    }
-    attroff(COLOR_PAIR(COLOR_HEART));
-    
-    // Display controls
-    attron(COLOR_PAIR(COLOR_PLAYER1));
-    mvprintw(3, BOARD_WIDTH + 2, "Player %c Controls:", game.tanks[0].symbol);
-    attroff(COLOR_PAIR(COLOR_PLAYER1));
-    mvprintw(4, BOARD_WIDTH + 2, "  Up: %c", game.tanks[0].up_key);
-    mvprintw(5, BOARD_WIDTH + 2, "  Down: %c", game.tanks[0].down_key);
-    mvprintw(6, BOARD_WIDTH + 2, "  Left: %c", game.tanks[0].left_key);
-    mvprintw(7, BOARD_WIDTH + 2, "  Right: %c", game.tanks[0].right_key);
-    mvprintw(8, BOARD_WIDTH + 2, "  Fire: %c", game.tanks[0].fire_key);
-    
-    attron(COLOR_PAIR(COLOR_PLAYER2));
-    mvprintw(10, BOARD_WIDTH + 2, "Player %c Controls:", game.tanks[1].symbol);
-    attroff(COLOR_PAIR(COLOR_PLAYER2));
-    mvprintw(11, BOARD_WIDTH + 2, "  Up: %c", game.tanks[1].up_key);
-    mvprintw(12, BOARD_WIDTH + 2, "  Down: %c", game.tanks[1].down_key);
-    mvprintw(13, BOARD_WIDTH + 2, "  Left: %c", game.tanks[1].left_key);
-    mvprintw(14, BOARD_WIDTH + 2, "  Right: %c", game.tanks[1].right_key);
-    mvprintw(15, BOARD_WIDTH + 2, "  Fire: %c", game.tanks[1].fire_key);
-    
-    mvprintw(17, BOARD_WIDTH + 2, "Press 'q' to quit");
-    
-    pthread_mutex_unlock(&game.board_mutex);
-    
-    refresh();
+    set_tick_timer(tfd, 0);
+    return 0;
 }
 
-// Function to check if a position is valid for movement
-int is_valid_position(int x, int y) {
-    if (x < 0 || x >= BOARD_WIDTH || y < 0 || y >= BOARD_HEIGHT) {
-        return 0; // Out of bounds
+// Function to print the input-to-screen latency once the terminal is released
+static void print_input_latency(FILE* out) {
+    if (input_latency.events == 0) {
+        return;
     }
-    
-    pthread_mutex_lock(&game.board_mutex);
-    char cell = game.board[y][x];
-    pthread_mutex_unlock(&game.board_mutex);
-    
-    if (cell == WALL_CHAR || (cell != ' ' && cell != PROJECTILE_CHAR)) {
-        return 0; // Wall or another tank
-    }
-    
-    return 1; // Valid position
+    fprintf(out, "input: %lu wakeups, input-to-screen %.1f us avg (max %.1f us)\n",
+            input_latency.events,
+            input_latency.ns_total / 1000.0 / input_latency.events,
+            input_latency.ns_max / 1000.0);
 }
 
-// Function for tank thread
-void* tank_thread(void* arg) {
-    Tank* tank = (Tank*)arg;
-    
-    while (!game.game_over) {
-        // The tank waits for input in the main loop
-        usleep(100000); // Sleep to prevent high CPU usage
+// Function to write the performance counters to a file, if one was asked for
+static void write_perf(const char* path) {
+    if (!path) {
+        return;
     }
-    
-    return NULL;
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "tank-game: cannot write %s\n", path);
+        return;
+    }
+    perf_dump(f);
+    fclose(f);
 }
 
-// Function to move a tank
-void move_tank(Tank* tank, Direction dir) {
-    // Always update the direction for aiming
-    tank->dir = dir;
-    
-    int new_x = tank->x;
-    int new_y = tank->y;
-    
-    // Calculate new position based on direction
-    switch (dir) {
-        case UP:
-            new_y--;
-            break;
-        case DOWN:
-            new_y++;
-            break;
-        case LEFT:
-            new_x--;
-            break;
-        case RIGHT:
-            new_x++;
-            break;
+// Function to play AI rounds without a terminal as fast as possible, rendering into /dev/null.
+// This is the training run of the profile-guided build, and its timings compare builds.
+static int run_workload(long ticks, long long started, long serial_budget) {
+    FILE* out = fopen("/dev/null", "w");
+    FILE* in = fopen("/dev/null", "r");
+    const char* term = getenv("TERM");
+    SCREEN* screen = out && in ? newterm(term && *term ? term : "xterm", out, in) : NULL;
+    
+    if (screen) {
+        if (has_colors()) {
+            start_color();
+            init_colors();
+        }
+        if (serial_budget >= 0) {
+            render_set_ansi(fileno(out), serial_budget);
+        }
+    } else {
+        fprintf(stderr, "tank-game: no terminal description, running the simulation only\n");
     }
     
-    // Check if the new position is valid
-    if (is_valid_position(new_x, new_y)) {
-        pthread_mutex_lock(&game.board_mutex);
-        
-        // Clear old position
-        game.board[tank->y][tank->x] = ' ';
-        
-        // Update tank position
-        tank->x = new_x;
-        tank->y = new_y;
-        
-        // Place tank at new position
-        game.board[tank->y][tank->x] = tank->symbol;
-        
-        pthread_mutex_unlock(&game.board_mutex);
-    }
-}
-
-// Function for projectile thread
-void* projectile_thread(void* arg) {
-    Projectile* proj = (Projectile*)arg;
-    
-    while (proj->active && !game.game_over) {
-        // Calculate new position based on direction
-        int new_x = proj->x;
-        int new_y = proj->y;
-        
-        switch (proj->dir) {
-            case UP:
-                new_y--;
-                break;
-            case DOWN:
-                new_y++;
-                break;
-            case LEFT:
-                new_x--;
-                break;
-            case RIGHT:
-                new_x++;
-                break;
+    perf_enabled = 1;
+    setup_tanks(&game, 'A', 'B');
+    unsigned int seed = WORKLOAD_SEED;
+    reset_game(&game, seed);
+    
+    unsigned long rounds = 1;
+    long long first_frame = 0;
+    long long run_start = now_ns();
+    for (long t = 0; t < ticks; t++) {
+        if (plugins) {
+            bot_tick(&game_bots, &game);
         }
-        
-        pthread_mutex_lock(&game.board_mutex);
-        
-        // Check if new position is valid
-        if (new_x < 0 || new_x >= BOARD_WIDTH || new_y < 0 || new_y >= BOARD_HEIGHT) {
-            // Hit the board edge
-            if (game.board[proj->y][proj->x] == PROJECTILE_CHAR) {
-                game.board[proj->y][proj->x] = ' '; // Clear old position
-            }
-            proj->active = 0;
-            pthread_mutex_unlock(&game.board_mutex);
-            break;
+        simulation_tick(&game);
+        if (checkpointing) {
+            checkpoint_tick(&game_checkpoint, &game);
         }
-        
-        char target = game.board[new_y][new_x];
-        
-        if (target == WALL_CHAR) {
-            // Hit a wall
-            if (game.board[proj->y][proj->x] == PROJECTILE_CHAR) {
-                game.board[proj->y][proj->x] = ' '; // Clear old position
-            }
-            proj->active = 0;
-            pthread_mutex_unlock(&game.board_mutex);
-            break;
-        } else if (target != ' ' && target != PROJECTILE_CHAR) {
-            // Hit something else (likely a tank)
-            for (int i = 0; i < MAX_TANKS; i++) {
-                if (game.tanks[i].symbol == target && proj->owner != target) {
-                    // Reduce tank health
-                    game.tanks[i].health--;
-                    if (game.tanks[i].health <= 0) {
-                        game.game_over = 1;
-                        // Set the winner to the other player
-                        game.winner = (i == 0) ? 1 : 0;
-                    }
-                }
-            }
-            
-            if (game.board[proj->y][proj->x] == PROJECTILE_CHAR) {
-                game.board[proj->y][proj->x] = ' '; // Clear old position
+        if (screen) {
+            render_game(&game);
+        }
+        if (spectating) {
+            spectate_publish(&game_spectate, &game);
+        }
+        if (terminals) {
+            terminals_publish(&game_terms, &game);
+        }
+        if (t == 0) {
+            first_frame = now_ns() - started;
+        }
+        if (game.game_over) {
+            reset_game(&game, ++seed);
+            render_invalidate();
+            if (spectating) {
+                spectate_round(&game_spectate);
             }
-            proj->active = 0;
-            pthread_mutex_unlock(&game.board_mutex);
-            break;
-        } else {
-            // Move the projectile
-            if (game.board[proj->y][proj->x] == PROJECTILE_CHAR) {
-                game.board[proj->y][proj->x] = ' '; // Clear old position
+            if (terminals) {
+                terminals_round(&game_terms);
             }
-            
-            proj->x = new_x;
-            proj->y = new_y;
-            game.board[proj->y][proj->x] = PROJECTILE_CHAR; // Place at new position
+            rounds++;
         }
-        
-        pthread_mutex_unlock(&game.board_mutex);
-        
-        // Sleep to control projectile speed
-        usleep(PROJECTILE_SPEED);
     }
+    long long run_ns = now_ns() - run_start;
     
-    return NULL;
-}
-
-// Function to fire a projectile
-void fire_projectile(Tank* tank) {
-    if (game.num_projectiles >= MAX_PROJECTILES) {
-        return; // Too many projectiles
+    if (screen) {
+        endwin();
+        delscreen(screen);
     }
-    
-    pthread_mutex_lock(&game.board_mutex);
-    
-    // Find the starting position for the projectile
-    int proj_x = tank->x;
-    int proj_y = tank->y;
-    
-    // Move the projectile one step in the tank's direction to prevent hitting the tank
-    switch (tank->dir) {
-        case UP:
-            proj_y--;
-            break;
-        case DOWN:
-            proj_y++;
-            break;
-        case LEFT:
-            proj_x--;
-            break;
-        case RIGHT:
-            proj_x++;
-            break;
+    if (out) {
+        fclose(out);
     }
-    
-    // Check if the position is valid
-    if (proj_x < 0 || proj_x >= BOARD_WIDTH || proj_y < 0 || proj_y >= BOARD_HEIGHT ||
-        game.board[proj_y][proj_x] == WALL_CHAR || 
-        (game.board[proj_y][proj_x] != ' ' && game.board[proj_y][proj_x] != PROJECTILE_CHAR)) {
-        pthread_mutex_unlock(&game.board_mutex);
-        return; // Can't fire
+    if (in) {
+        fclose(in);
     }
     
-    // Create a new projectile
-    Projectile* proj = &game.projectiles[game.num_projectiles++];
-    proj->x = proj_x;
-    proj->y = proj_y;
-    proj->dir = tank->dir;
-    proj->active = 1;
-    proj->owner = tank->symbol;
-    
-    // Place projectile on board
-    game.board[proj->y][proj->x] = PROJECTILE_CHAR;
-    
-    pthread_mutex_unlock(&game.board_mutex);
-    
-    // Create a thread for the projectile (now we don't detach it)
-    pthread_create(&proj->thread, NULL, projectile_thread, proj);
+    printf("workload: %ld ticks, %lu rounds in %.1f ms (%.0f ticks/s), first frame %.2f ms after start\n",
+           ticks, rounds, run_ns / 1e6, ticks / (run_ns / 1e9), first_frame / 1e6);
+    printf("tick p50 %.2f us p99 %.2f us, render p50 %.2f us p99 %.2f us\n",
+           perf_percentile(PERF_TICK, 0.5) / 1000.0, perf_percentile(PERF_TICK, 0.99) / 1000.0,
+           perf_percentile(PERF_RENDER, 0.5) / 1000.0, perf_percentile(PERF_RENDER, 0.99) / 1000.0);
+    print_render_stats(stdout);
+    if (checkpointing) {
+        checkpoint_discard(&game_checkpoint); // Nothing to resume from a measurement
+        checkpoint_close(&game_checkpoint);
+        checkpointing = 0;
+        checkpoint_print_stats(&game_checkpoint, stdout);
+    }
+    return 0;
 }
 
-// Function to handle keyboard input
-void handle_input(int ch) {
-    for (int i = 0; i < MAX_TANKS; i++) {
-        Tank* tank = &game.tanks[i];
-        
-        if (ch == tank->up_key) {
-            move_tank(tank, UP);
-        } else if (ch == tank->down_key) {
-            move_tank(tank, DOWN);
-        } else if (ch == tank->left_key) {
-            move_tank(tank, LEFT);
-        } else if (ch == tank->right_key) {
-            move_tank(tank, RIGHT);
-        } else if (ch == tank->fire_key) {
-            fire_projectile(tank);
-        }
+// Function to write the Chrome trace, if one was asked for
+static void write_trace(const char* path) {
+    if (!path) {
+        return;
+    }
+    trace_thread_exit();
+    if (trace_write(path) < 0) {
+        fprintf(stderr, "tank-game: cannot write %s\n", path);
     }
 }
 
-// Function to reset game state for a new game
-void reset_game() {
-    // Reset game state variables
-    game.num_projectiles = 0;
-    game.game_over = 0;
-    game.winner = -1;
-    
-    // Reset tank health (positions will be reset by place_tanks)
-    game.tanks[0].health = MAX_HEALTH;
-    game.tanks[1].health = MAX_HEALTH;
-    
-    // Re-initialize board and place tanks
-    init_board();
-    place_tanks();
+// Function to get the width messages are centered in: the board, or the terminal if the board is larger
+static int screen_width() {
+    return game.width < COLS ? game.width : COLS;
+}
+
+// Function to get the height messages are centered in
+static int screen_height() {
+    return game.height < LINES ? game.height : LINES;
 }
 
 // Function to display the main menu and get player settings
@@ -442,7 +340,7 @@ void display_menu() {
     
     // Display title
     attron(A_BOLD);
-    mvprintw(2, BOARD_WIDTH / 2 - 5, "TANK GAME");
+    mvprintw(2, screen_width() / 2 - 5, "TANK GAME");
     attroff(A_BOLD);
     
     // Get player 1 character with input validation
@@ -484,23 +382,7 @@ void display_menu() {
     mvprintw(7, 40, "\n%c", p2_char);
     
     // Set default controls
-    game.tanks[0].symbol = p1_char;
-    game.tanks[0].up_key = 'w';
-    game.tanks[0].down_key = 's';
-    game.tanks[0].left_key = 'a';
-    game.tanks[0].right_key = 'd';
-    game.tanks[0].fire_key = ' '; // Space
-    game.tanks[0].health = MAX_HEALTH;
-    game.tanks[0].dir = RIGHT;
-    
-    game.tanks[1].symbol = p2_char;
-    game.tanks[1].up_key = 'i';
-    game.tanks[1].down_key = 'k';
-    game.tanks[1].left_key = 'j';
-    game.tanks[1].right_key = 'l';
-    game.tanks[1].fire_key = 'm';
-    game.tanks[1].health = MAX_HEALTH;
-    game.tanks[1].dir = LEFT;
+    setup_tanks(&game, p1_char, p2_char);
     
     // Display controls
     attron(COLOR_PAIR(COLOR_PLAYER1));
@@ -531,10 +413,314 @@ void display_menu() {
     }
 }
 
-int main() {
-    // Initialize game state
-    memset(&game, 0, sizeof(GameState));
-    pthread_mutex_init(&game.board_mutex, NULL);
+int main(int argc, char* argv[]) {
+    long long started = now_ns();
+    int moves_per_sec = MOVE_RATE;
+    int shots_per_sec = FIRE_RATE;
+    const char* map_path = NULL;
+    const char* log_path = NULL;
+    const char* server_addr = NULL;
+    const char* perf_path = NULL;
+    const char* trace_path = NULL;
+    int overlay = 0;
+    int bots = 0;
+    int demo = 0;
+    long workload = 0;
+    long serial_budget = -1;
+    const char* spectate_path = NULL;
+    const char* keyboards = NULL;
+    const char* key_capture = NULL;
+    const char* checkpoint_path = NULL;
+    const char* bot_specs[BOT_MAX_PLUGINS];
+    int num_bot_specs = 0;
+    long bot_budget = BOT_BUDGET_USEC;
+    const char* terminal_specs[TERMINAL_MAX];
+    int num_terminal_specs = 0;
+    const char* telemetry_path = NULL;
+    const char* speed_specs[MAX_TANKS + 1];
+    int num_speed_specs = 0;
+    int opt;
+    
+    // Parse command line options
+    while ((opt = getopt(argc, argv, "m:f:M:R:C:PD:T:b:AW:S:V:K:E:k:B:u:t:L:F:")) != -1) {
+        switch (opt) {
+            case 'm':
+                moves_per_sec = atoi(optarg);
+                break;
+            case 'f':
+                shots_per_sec = atoi(optarg);
+                break;
+            case 'M':
+                map_path = optarg;
+                break;
+            case 'R':
+                log_path = optarg;
+                break;
+            case 'C':
+                server_addr = optarg;
+                break;
+            case 'P':
+                overlay = 1;
+                perf_enabled = 1;
+                break;
+            case 'D':
+                perf_path = optarg;
+                perf_enabled = 1;
+                break;
+            case 'T':
+                trace_path = optarg;
+                break;
+            case 'b':
+                bots = atoi(optarg);
+                break;
+            case 'A':
+                demo = 1;
+                break;
+            case 'W':
+                workload = atol(optarg);
+                demo = 1;
+                break;
+            case 'S':
+                serial_budget = atol(optarg);
+                break;
+            case 'V':
+                spectate_path = optarg;
+                break;
+            case 'K':
+                keyboards = optarg;
+                break;
+            case 'E':
+                key_capture = optarg;
+                break;
+            case 'k':
+                checkpoint_path = optarg;
+                break;
+            case 'B':
+                if (num_bot_specs == BOT_MAX_PLUGINS) {
+                    fprintf(stderr, "tank-game: at most %d -B plugins\n", BOT_MAX_PLUGINS);
+                    return 1;
+                }
+                bot_specs[num_bot_specs++] = optarg;
+                break;
+            case 'u':
+                bot_budget = atol(optarg);
+                break;
+            case 't':
+                if (num_terminal_specs == TERMINAL_MAX) {
+                    fprintf(stderr, "tank-game: at most %d -t terminals\n", TERMINAL_MAX);
+                    return 1;
+                }
+                terminal_specs[num_terminal_specs++] = optarg;
+                break;
+            case 'L':
+                telemetry_path = optarg;
+                break;
+            case 'F':
+                if (num_speed_specs == MAX_TANKS + 1) {
+                    fprintf(stderr, "tank-game: at most %d -F speeds\n", MAX_TANKS + 1);
+                    return 1;
+                }
+                speed_specs[num_speed_specs++] = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-m moves_per_sec] [-f shots_per_sec] [-M map_file] [-R record.log] [-C host:port] [-P] [-D perf.txt] [-T trace.json] [-b bots] [-A] [-W ticks] [-S bytes_per_frame] [-V spectate.sock] [-K auto|/dev/input/eventN[,...]] [-E keys.ev] [-k checkpoint] [-B bot.so[:tanks]] [-u bot_usec] [-t tty[:tank]] [-L telemetry.tel] [-F [tank:]cells_per_sec]\n", argv[0]);
+                return 1;
+        }
+    }
+    
+    render_set_overlay(overlay);
+    if (trace_path && trace_init(TRACE_DEFAULT_EVENTS) < 0) {
+        fprintf(stderr, "tank-game: out of memory\n");
+        return 1;
+    }
+    
+    // Playing on a tank-server: the server owns the game, this process only draws it
+    if (server_addr) {
+        setlocale(LC_ALL, "");
+        initscr();
+        cbreak();
+        noecho();
+        keypad(stdscr, TRUE);
+        curs_set(0);
+        if (has_colors()) {
+            start_color();
+            init_colors();
+        }
+        
+        int rc = run_client(server_addr);
+        endwin();
+        if (rc < 0) {
+            fprintf(stderr, "tank-game: lost connection to %s\n", server_addr);
+        }
+        print_render_stats(stderr);
+        print_client_stats(stderr);
+        write_perf(perf_path);
+        write_trace(trace_path);
+        return rc < 0 ? 1 : 0;
+    }
+    
+    // Initialize game state, from a map file if one was given
+    long long load_start = now_ns();
+    if (bots < 0 || bots > MAX_TANKS - NUM_PLAYERS) {
+        fprintf(stderr, "tank-game: -b takes 0 to %d bots\n", MAX_TANKS - NUM_PLAYERS);
+        return 1;
+    }
+    if (map_path) {
+        if (game_load_map(&game, map_path, MAX_PROJECTILES, NUM_PLAYERS + bots) < 0) {
+            fprintf(stderr, "tank-game: cannot load map %s\n", map_path);
+            return 1;
+        }
+    } else if (game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, MAX_PROJECTILES, NUM_PLAYERS + bots) < 0) {
+        fprintf(stderr, "tank-game: out of memory\n");
+        return 1;
+    }
+    long long load_ns = now_ns() - load_start;
+    long load_rss = resident_kb();
+    
+    if (render_init(&game) < 0) {
+        fprintf(stderr, "tank-game: out of memory\n");
+        return 1;
+    }
+    set_input_rates(&game, moves_per_sec, shots_per_sec);
+    
+    // Projectile speeds: the game's default, or one tank's own with tank:cells_per_sec (tank:0 puts the default back)
+    for (int i = 0; i < num_speed_specs; i++) {
+        const char* colon = strchr(speed_specs[i], ':');
+        int tank = colon ? atoi(speed_specs[i]) : -1;
+        int cells_per_sec = atoi(colon ? colon + 1 : speed_specs[i]);
+        if (cells_per_sec < (tank >= 0 ? 0 : 1) || tank < -1 || tank >= game.num_tanks) {
+            fprintf(stderr, "tank-game: bad projectile speed %s\n", speed_specs[i]);
+            return 1;
+        }
+        set_projectile_speed(&game, tank, cells_per_sec);
+    }
+    
+    // Bots are always AI tanks; in demo mode the AI plays both players too
+    if ((bots > 0 || demo) && ai_init(&game_ai, &game, demo ? (1u << NUM_PLAYERS) - 1 : 0) < 0) {
+        fprintf(stderr, "tank-game: out of memory\n");
+        return 1;
+    }
+    
+    // Shared-object bots; the tanks they drive are left out of the AI
+    if (num_bot_specs > 0) {
+        if (log_path) {
+            fprintf(stderr, "tank-game: -R cannot record plugin bots, tank-replay has no way to run them again\n");
+            return 1;
+        }
+        if (bot_host_init(&game_bots, &game, bot_budget) < 0) {
+            fprintf(stderr, "tank-game: out of memory\n");
+            return 1;
+        }
+        for (int i = 0; i < num_bot_specs; i++) {
+            if (bot_load(&game_bots, &game, bot_specs[i]) < 0) {
+                fprintf(stderr, "tank-game: cannot load bot plugin %s\n", bot_specs[i]);
+                bot_host_free(&game_bots, &game);
+                return 1;
+            }
+        }
+        plugins = 1;
+    }
+    
+    // Players on terminals of their own, drawn from a shared snapshot of the board
+    if (num_terminal_specs > 0) {
+        if (log_path) {
+            fprintf(stderr, "tank-game: -R cannot record keys typed on -t terminals\n");
+            return 1;
+        }
+        if (terminals_open(&game_terms, &game, serial_budget) < 0) {
+            fprintf(stderr, "tank-game: cannot create the board snapshot\n");
+            return 1;
+        }
+        for (int i = 0; i < num_terminal_specs; i++) {
+            if (terminal_add(&game_terms, terminal_specs[i]) < 0) {
+                fprintf(stderr, "tank-game: cannot play on terminal %s\n", terminal_specs[i]);
+                terminals_close(&game_terms);
+                return 1;
+            }
+        }
+        terminals = 1;
+    }
+    
+    // Match events and tick timings, written in the background
+    if (telemetry_path) {
+        if (telemetry_open(&game_telemetry, telemetry_path) < 0) {
+            fprintf(stderr, "tank-game: cannot write telemetry to %s\n", telemetry_path);
+            return 1;
+        }
+        game.telemetry = &game_telemetry;
+        game.match = telemetry_match(&game_telemetry); // For a round resumed from a checkpoint
+    }
+    
+    // Record every round for tank-replay
+    if (log_path) {
+        if (log_open(&game_log, log_path, &game, map_path) < 0) {
+            fprintf(stderr, "tank-game: cannot write log %s\n", log_path);
+            return 1;
+        }
+        game.log = &game_log;
+    }
+    
+    // Live view for local spectators (tank-game -C path)
+    if (spectate_path) {
+        if (spectate_open(&game_spectate, &game, spectate_path) < 0) {
+            fprintf(stderr, "tank-game: cannot open spectator socket %s\n", spectate_path);
+            return 1;
+        }
+        spectating = 1;
+    }
+    
+    // Key state straight from the keyboards, or from a captured event stream
+    if (key_capture) {
+        if (evdev_open_replay(&game_keys, key_capture) < 0) {
+            fprintf(stderr, "tank-game: cannot read key events from %s\n", key_capture);
+            return 1;
+        }
+    } else if (keyboards && evdev_open(&game_keys, keyboards) < 0) {
+        fprintf(stderr, "tank-game: cannot open keyboard %s\n", keyboards);
+        return 1;
+    }
+    keyboard = keyboards || key_capture;
+    
+    // Periodic checkpoints; one left behind by a crash resumes its round instead of showing the menu
+    int resume = 0;
+    if (checkpoint_path) {
+        if (checkpoint_open(&game_checkpoint, &game, checkpoint_path, map_path, CHECKPOINT_TICKS) < 0) {
+            fprintf(stderr, "tank-game: out of memory\n");
+            return 1;
+        }
+        checkpointing = 1;
+        resume = workload == 0 && checkpoint_restore(&game_checkpoint, &game) == 0;
+    }
+    
+    // Headless run for training and comparing builds
+    if (workload > 0) {
+        int rc = run_workload(workload, started, serial_budget);
+        if (spectating) {
+            spectate_close(&game_spectate);
+            spectate_print_stats(&game_spectate, stdout);
+        }
+        if (game.log) {
+            log_close(game.log);
+        }
+        ai_free(&game_ai, &game);
+        if (plugins) {
+            bot_print_stats(&game_bots, stdout);
+            bot_host_free(&game_bots, &game);
+        }
+        if (terminals) {
+            terminals_print_stats(&game_terms, stdout);
+            terminals_close(&game_terms);
+        }
+        if (game.telemetry) {
+            telemetry_close(game.telemetry);
+            telemetry_print_stats(game.telemetry, stdout);
+        }
+        render_free();
+        game_free(&game);
+        write_perf(perf_path);
+        write_trace(trace_path);
+        return rc;
+    }
     
     // Initialize ncurses
     setlocale(LC_ALL, ""); // Set locale for UTF-8
@@ -549,11 +735,20 @@ int main() {
         start_color();
         
         // Define color pairs
-        init_pair(COLOR_PLAYER1, COLOR_RED, COLOR_BLACK);       // Player 1 is red
-        init_pair(COLOR_PLAYER2, COLOR_BLUE, COLOR_BLACK);      // Player 2 is blue
-        init_pair(COLOR_WALL, COLOR_WHITE, COLOR_BLACK);        // Walls are white
-        init_pair(COLOR_PROJECTILE, COLOR_YELLOW, COLOR_BLACK); // Projectiles are yellow
-        init_pair(COLOR_HEART, COLOR_RED, COLOR_BLACK);         // Hearts are red
+        init_colors();
+    }
+    
+    // Frames go straight to the terminal, budgeted for a slow serial console
+    if (serial_budget >= 0) {
+        render_set_ansi(STDOUT_FILENO, serial_budget);
+    }
+    
+    // Simulation timer, armed by the game loop while projectiles fly or keys are held
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd < 0) {
+        endwin();
+        perror("tank-game: timerfd_create");
+        return 1;
     }
     
     int quit_program = 0;
@@ -562,100 +757,133 @@ int main() {
         // Reset game state for a new session
         game.game_over = 0;
         game.winner = -1;
-        game.num_projectiles = 0;
         
-        // Display menu and get player settings
-        display_menu();
+        // The round a checkpoint was restored from carries on where it stopped
+        GameLog* log = game.log;
+        if (resume) {
+            resume = 0;
+            game.log = NULL; // The recording has no start for this round
+            if (game.ai) {
+                ai_reset(&game);
+            }
+        } else {
+            // Display menu and get player settings; a demo needs nobody at the keyboard
+            if (demo) {
+                setup_tanks(&game, 'A', 'B');
+            } else {
+                display_menu();
+            }
+            
+            if (game.game_over) {
+                quit_program = 1;
+                break; // User quit from menu
+            }
+            
+            // Reset game for a new round
+            unsigned int seed = time(NULL);
+            reset_game(&game, seed);
+            if (game.log) {
+                log_round(game.log, &game, seed);
+            }
+        }
+        render_invalidate();
+        if (spectating) {
+            spectate_round(&game_spectate);
+        }
+        if (terminals) {
+            terminals_round(&game_terms);
+        }
         
-        if (game.game_over) {
+        // Game loop
+        if (game_loop(tfd)) {
             quit_program = 1;
-            break; // User quit from menu
         }
-        
-        // Reset game for a new round
-        reset_game();
-        
-        // Create tank threads
-        for (int i = 0; i < MAX_TANKS; i++) {
-            pthread_create(&game.tanks[i].thread, NULL, tank_thread, &game.tanks[i]);
+        if (game.log) {
+            log_round_end(game.log, &game);
         }
+        game.log = log;
         
-        // Set non-blocking getch for the game
-        timeout(100);
-        
-        // Game loop
-        while (!game.game_over) {
-            // Handle input
-            int ch = getch();
-            if (ch != ERR) {
-                if (ch == 'q') {
-                    game.game_over = 1; // Exit game loop
-                    quit_program = 1;  // Exit program
-                    break;
-                }
-                handle_input(ch);
-            }
-            
-            // Clean up inactive projectiles
-            pthread_mutex_lock(&game.board_mutex);
-            for (int i = 0; i < game.num_projectiles; i++) {
-                if (!game.projectiles[i].active) {
-                    // Join the thread
-                    pthread_join(game.projectiles[i].thread, NULL);
-                    
-                    // Remove this projectile by swapping with the last one
-                    game.projectiles[i] = game.projectiles[game.num_projectiles - 1];
-                    game.num_projectiles--;
-                    i--; // Recheck this index again
-                }
-            }
-            pthread_mutex_unlock(&game.board_mutex);
-            
-            // Render game
-            render_game();
-            
-            // Sleep to control game speed
-            usleep(50000);
+        // A finished round, or one the player quit, is not resumed
+        if (checkpointing) {
+            checkpoint_discard(&game_checkpoint);
         }
         
         // Display game over message
         clear();
-        if (game.winner >= 0 && game.winner < MAX_TANKS && !quit_program) {
-            int color = (game.winner == 0) ? COLOR_PLAYER1 : COLOR_PLAYER2;
+        if (game.winner >= 0 && game.winner < game.num_tanks && !quit_program) {
+            int color = tank_color_pair(game.winner);
             attron(COLOR_PAIR(color) | A_BOLD);
-            mvprintw(BOARD_HEIGHT / 2, (BOARD_WIDTH - 25) / 2, "Jucatorul %c a castigat!", game.tanks[game.winner].symbol);
+            mvprintw(screen_height() / 2, (screen_width() - 25) / 2, "Jucatorul %c a castigat!", game.tanks[game.winner].symbol);
             attroff(COLOR_PAIR(color) | A_BOLD);
         } else if (!quit_program) {
-            mvprintw(BOARD_HEIGHT / 2, (BOARD_WIDTH - 10) / 2, "Joc incheiat!");
+            mvprintw(screen_height() / 2, (screen_width() - 10) / 2, "Joc incheiat!");
         }
         
-        if (!quit_program) {
-            mvprintw(BOARD_HEIGHT / 2 + 2, (BOARD_WIDTH - 40) / 2, "Apasa orice tasta pentru a reveni la meniu...");
+        if (!quit_program && demo) {
+            // Next round after a pause, Q still quits
+            refresh();
+            timeout(3000);
+            int ch = getch();
+            if (ch == 'q' || ch == 'Q') {
+                quit_program = 1;
+            }
+        } else if (!quit_program) {
+            mvprintw(screen_height() / 2 + 2, (screen_width() - 40) / 2, "Apasa orice tasta pentru a reveni la meniu...");
             refresh();
             
             // Wait for key press (blocking)
             timeout(-1);
             getch();
         }
-        
-        // Wait for tank threads to finish
-        for (int i = 0; i < MAX_TANKS; i++) {
-            pthread_cancel(game.tanks[i].thread); // Cancel thread in case it's stuck
-            pthread_join(game.tanks[i].thread, NULL);
-        }
-        
-        // Cancel and join any active projectile threads
-        for (int i = 0; i < game.num_projectiles; i++) {
-            if (game.projectiles[i].active) {
-                pthread_cancel(game.projectiles[i].thread);
-                pthread_join(game.projectiles[i].thread, NULL);
-            }
-        }
     }
     
     // Clean up
-    pthread_mutex_destroy(&game.board_mutex);
+    close(tfd);
     endwin();
+    render_free();
+    if (game.log) {
+        long bytes = log_size(game.log);
+        fprintf(stderr, "log: %lu rounds, %lu events in %ld bytes written to %s\n",
+                game_log.rounds, game_log.events, bytes, log_path);
+        log_close(game.log);
+    }
+    if (game.ai) {
+        ai_print_stats(&game_ai, stderr);
+        ai_free(&game_ai, &game);
+    }
+    if (plugins) {
+        bot_print_stats(&game_bots, stderr);
+        bot_host_free(&game_bots, &game);
+    }
+    if (terminals) {
+        terminals_print_stats(&game_terms, stderr);
+        terminals_close(&game_terms);
+    }
+    if (game.telemetry) {
+        telemetry_close(game.telemetry);
+        telemetry_print_stats(game.telemetry, stderr);
+    }
+    if (spectating) {
+        spectate_close(&game_spectate);
+        spectate_print_stats(&game_spectate, stderr);
+    }
+    if (keyboards || key_capture) {
+        evdev_close(&game_keys);
+        evdev_print_stats(&game_keys, stderr);
+    }
+    if (checkpointing) {
+        checkpoint_close(&game_checkpoint);
+        checkpoint_print_stats(&game_checkpoint, stderr);
+    }
+    game_free(&game);
+    print_render_stats(stderr);
+    print_input_latency(stderr);
+    write_perf(perf_path);
+    write_trace(trace_path);
+    if (map_path) {
+        fprintf(stderr, "map: %dx%d loaded in %.2f ms, %ld kB resident after load\n",
+                game.width, game.height, load_ns / 1e6, load_rss);
+    }
     
     return 0;
 }
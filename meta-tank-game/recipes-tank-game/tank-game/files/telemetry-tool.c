@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+
+#define TIME_BUCKETS 40 // Power-of-two histogram of tick times, as the perf counters keep it
+#define MAX_WINNERS 1024 // Tanks whose wins are counted
+
+// What the records of one match add up to
+typedef struct {
+    int started, ended;
+    int resumed; // Its start record says it was picked up from a checkpoint
+    int tanks;
+    uint32_t seed;
+    uint32_t ticks;
+    int winner;
+    unsigned long shots, hits, moves;
+} Match;
+
+// Everything summed over one file
+typedef struct {
+    Match* matches; // Indexed by match number
+    size_t num_matches;
+    unsigned long long tick_ns, tick_ns_max, ticks;
+    unsigned long long tick_buckets[TIME_BUCKETS];
+    unsigned long long projectiles; // Projectiles in flight summed over timed ticks
+    unsigned long long lifetime[TELEMETRY_ENDS], ended[TELEMETRY_ENDS]; // By what stopped the projectile
+    uint32_t lifetime_max;
+    unsigned long wins[MAX_WINNERS];
+    unsigned long draws;
+    unsigned long limited; // Draws cut off by a tick limit
+    unsigned long long dropped; // Records the game could not queue, from TELEMETRY_DROPPED
+    int out_of_memory;
+} Summary;
+
+// Function to find a match by number, growing the table as new numbers appear
+static Match* match_of(Summary* s, uint32_t id) {
+    if (id >= s->num_matches) {
+        size_t n = s->num_matches ? s->num_matches : 64;
+        while (n <= id) {
+            n *= 2;
+        }
+        Match* m = realloc(s->matches, n * sizeof(Match));
+        if (!m) {
+            s->out_of_memory = 1;
+            return NULL;
+        }
+        memset(m + s->num_matches, 0, (n - s->num_matches) * sizeof(Match));
+        s->matches = m;
+        s->num_matches = n;
+    }
+    return &s->matches[id];
+}
+
+// Function to add one batch of records to the summary
+static void visit(const TelemetryRecord* records, size_t count, void* arg) {
+    Summary* s = arg;
+    
+    for (size_t i = 0; i < count; i++) {
+        const TelemetryRecord* r = &records[i];
+        if (r->kind == TELEMETRY_DROPPED) {
+            s->dropped += r->value;
+            continue;
+        }
+        Match* m = match_of(s, r->match);
+        if (!m) {
+            return;
+        }
+        switch (r->kind) {
+            case TELEMETRY_ROUND:
+                m->started = 1;
+                m->resumed = r->arg == TELEMETRY_ROUND_RESUMED;
+                m->tanks = r->tank;
+                m->seed = r->value;
+                break;
+            case TELEMETRY_ROUND_END:
+                m->ended = 1;
+                m->ticks = r->value;
+                m->winner = r->tank == 0xFFFF ? -1 : r->tank;
+                if (m->winner < 0) {
+                    s->draws++;
+                    s->limited += r->arg == TELEMETRY_ROUND_LIMIT;
+                } else if (m->winner < MAX_WINNERS) {
+                    s->wins[m->winner]++;
+                }
+                break;
+            case TELEMETRY_TICK: {
+                int b = r->value ? 32 - __builtin_clz(r->value) : 0;
+                s->ticks++;
+                s->tick_ns += r->value;
+                s->tick_buckets[b < TIME_BUCKETS ? b : TIME_BUCKETS - 1]++;
+                s->tick_ns_max = r->value > s->tick_ns_max ? r->value : s->tick_ns_max;
+                s->projectiles += r->tank;
+                break;
+            }
+            case TELEMETRY_MOVE:
+                m->moves++;
+                break;
+            case TELEMETRY_SHOT:
+                m->shots++;
+                break;
+            case TELEMETRY_HIT:
+                m->hits++;
+                break;
+            case TELEMETRY_PROJECTILE_END: {
+                int why = r->arg < TELEMETRY_ENDS ? r->arg : TELEMETRY_END_WALL;
+                s->ended[why]++;
+                s->lifetime[why] += r->value;
+                s->lifetime_max = r->value > s->lifetime_max ? r->value : s->lifetime_max;
+                break;
+            }
+        }
+    }
+}
+
+// Function to estimate a tick time percentile (0-1) as the upper bound of its bucket
+static unsigned long long tick_percentile(const Summary* s, double p) {
+    unsigned long long target = (unsigned long long)(s->ticks * p);
+    unsigned long long seen = 0;
+    
+    for (int b = 0; b < TIME_BUCKETS; b++) {
+        seen += s->tick_buckets[b];
+        if (seen > target) {
+            unsigned long long upper = b ? 1ULL << b : 0;
+            return upper < s->tick_ns_max ? upper : s->tick_ns_max;
+        }
+    }
+    return s->tick_ns_max;
+}
+
+// Function to print the summary of a file
+static void print_summary(Summary* s, int per_match) {
+    unsigned long started = 0, ended = 0, resumed = 0, unfinished = 0, incomplete = 0;
+    unsigned long long shots = 0, hits = 0, moves = 0, ticks = 0;
+    
+    for (size_t i = 0; i < s->num_matches; i++) {
+        Match* m = &s->matches[i];
+        if (!m->started && !m->ended && m->shots + m->moves == 0) {
+            continue; // Number never used
+        }
+        started += m->started && !m->resumed;
+        resumed += m->resumed;
+        incomplete += !m->started; // Its start record was dropped
+        unfinished += m->started && !m->ended;
+        ended += m->ended;
+        shots += m->shots;
+        hits += m->hits;
+        moves += m->moves;
+        ticks += m->ended ? m->ticks : 0;
+        if (per_match) {
+            if (!m->started) {
+                printf("match %zu: start lost, ", i);
+            } else if (m->resumed) {
+                printf("match %zu: %d tanks, resumed from a checkpoint, ", i, m->tanks);
+            } else {
+                printf("match %zu: %d tanks, seed %u, ", i, m->tanks, m->seed);
+            }
+            if (!m->ended) {
+                printf("unfinished, ");
+            } else if (m->winner < 0) {
+                printf("%u ticks, no winner, ", m->ticks);
+            } else {
+                printf("%u ticks, won by tank %d, ", m->ticks, m->winner);
+            }
+            printf("%lu moves, %lu shots, %lu hits\n", m->moves, m->shots, m->hits);
+        }
+    }
+    
+    printf("matches: %lu started, %lu finished, %lu resumed from a checkpoint, %lu unfinished, %.1f ticks per finished match\n",
+           started, ended, resumed, unfinished, ended ? (double)ticks / ended : 0.0);
+    if (incomplete || s->dropped) {
+        printf("  %llu records dropped by the game, %lu matches lost their start\n", s->dropped, incomplete);
+    }
+    for (int i = 0; i < MAX_WINNERS; i++) {
+        if (s->wins[i]) {
+            printf("  tank %d won %lu (%.1f%%)\n", i, s->wins[i], 100.0 * s->wins[i] / ended);
+        }
+    }
+    if (s->draws) {
+        printf("  no winner in %lu, %lu of them cut off at the tick limit\n", s->draws, s->limited);
+    }
+    printf("shots: %llu, %llu hits (%.1f%% accuracy), %llu moves\n",
+           shots, hits, shots ? 100.0 * hits / shots : 0.0, moves);
+    static const char* const stopped_by[TELEMETRY_ENDS] = { "a wall", "a tank", "another projectile" };
+    for (int why = 0; why < TELEMETRY_ENDS; why++) {
+        printf("projectiles stopped by %s: %llu, %.1f ticks in flight on average\n", stopped_by[why],
+               s->ended[why], s->ended[why] ? (double)s->lifetime[why] / s->ended[why] : 0.0);
+    }
+    printf("longest flight %u ticks\n", s->lifetime_max);
+    if (s->ticks) {
+        printf("ticks: %llu timed, avg %.2f us, p50 %.2f us, p99 %.2f us, max %.2f us, %.1f projectiles in flight\n",
+               s->ticks, (double)s->tick_ns / s->ticks / 1000.0, tick_percentile(s, 0.5) / 1000.0,
+               tick_percentile(s, 0.99) / 1000.0, s->tick_ns_max / 1000.0, (double)s->projectiles / s->ticks);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int per_match = 0;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "m")) != -1) {
+        switch (opt) {
+            case 'm':
+                per_match = 1;
+                break;
+            default:
+                per_match = -1;
+                break;
+        }
+    }
+    
+    if (optind >= argc || per_match < 0) {
+        fprintf(stderr,
+                "Usage: %s [-m] <file.tel>...\n"
+                "  -m  print every match\n",
+                argv[0]);
+        return 1;
+    }
+    
+    int rc = 0;
+    for (int i = optind; i < argc; i++) {
+        TelemetryScan scan;
+        Summary one;
+        memset(&one, 0, sizeof(one));
+        if (telemetry_scan(argv[i], &scan, visit, &one) < 0) {
+            fprintf(stderr, "tank-telemetry: cannot read %s\n", argv[i]);
+            rc = 1;
+            continue;
+        }
+        printf("%s: %llu records in %lu batches, %zu of %zu bytes whole", argv[i], scan.records, scan.batches,
+               scan.valid, scan.size);
+        if (scan.valid < scan.size) {
+            printf(", %zu bytes of a batch cut short ignored", scan.size - scan.valid);
+        }
+        printf("\n");
+        print_summary(&one, per_match);
+        if (one.out_of_memory) {
+            fprintf(stderr, "tank-telemetry: out of memory, %s is summed in part\n", argv[i]);
+            rc = 1;
+        }
+        free(one.matches);
+    }
+    return rc;
+}
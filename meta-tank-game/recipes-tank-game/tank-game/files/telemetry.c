@@ -0,0 +1,362 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+
+static uint32_t sink_ids; // Atomic, tells sinks apart in the per-thread cache
+static __thread TelemetryRing* thread_ring; // This thread's ring in the sink thread_sink
+static __thread uint32_t thread_sink;
+
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to compute the FNV-1a checksum of a batch's records
+static uint64_t checksum(const void* data, size_t n) {
+    const unsigned char* p = data;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Function to read exactly n bytes, returns 0 at a clean or short end
+static int read_full(int fd, void* buf, size_t n) {
+    size_t done = 0;
+    while (done < n) {
+        ssize_t r = read(fd, (char*)buf + done, n - done);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            return 0;
+        }
+        done += r;
+    }
+    return 1;
+}
+
+// Function to walk the whole batches of a telemetry file, handing the records of each to visit (may be NULL).
+// Stops at the first batch that is cut short or fails its checksum; scan->valid says where that was.
+int telemetry_scan(const char* path, TelemetryScan* scan,
+                   void (*visit)(const TelemetryRecord* records, size_t count, void* arg), void* arg) {
+    memset(scan, 0, sizeof(TelemetryScan));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    TelemetryHeader hdr;
+    if (fstat(fd, &st) < 0 || !read_full(fd, &hdr, sizeof(hdr)) || memcmp(hdr.magic, TELEMETRY_MAGIC, 4) != 0 ||
+        hdr.version != TELEMETRY_VERSION || hdr.record_size != sizeof(TelemetryRecord)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    TelemetryRecord* records = malloc(TELEMETRY_BATCH * sizeof(TelemetryRecord));
+    if (!records) {
+        close(fd);
+        return -1;
+    }
+    scan->size = st.st_size;
+    scan->valid = sizeof(hdr);
+    
+    TelemetryBatch batch;
+    while (read_full(fd, &batch, sizeof(batch))) {
+        size_t bytes = (size_t)batch.count * sizeof(TelemetryRecord);
+        if (batch.magic != TELEMETRY_BATCH_MAGIC || batch.count == 0 || batch.count > TELEMETRY_BATCH ||
+            !read_full(fd, records, bytes) || checksum(records, bytes) != batch.checksum) {
+            break;
+        }
+        for (uint32_t i = 0; i < batch.count; i++) {
+            if (records[i].kind < TELEMETRY_KINDS) {
+                scan->kinds[records[i].kind]++;
+            }
+        }
+        if (visit) {
+            visit(records, batch.count, arg);
+        }
+        scan->batches++;
+        scan->records += batch.count;
+        scan->valid += sizeof(batch) + bytes;
+    }
+    
+    free(records);
+    close(fd);
+    return 0;
+}
+
+// Function to find the highest match number in a batch, so matches appended later carry on from it
+static void last_match(const TelemetryRecord* records, size_t count, void* arg) {
+    uint32_t* last = arg;
+    for (size_t i = 0; i < count; i++) {
+        *last = records[i].match > *last ? records[i].match : *last;
+    }
+}
+
+// Function to append one batch with a single write, cutting the file back if the write did not complete
+static int write_batch(Telemetry* t, size_t count) {
+    TelemetryBatch batch = { TELEMETRY_BATCH_MAGIC, (uint32_t)count, 0 };
+    size_t bytes = count * sizeof(TelemetryRecord);
+    batch.checksum = checksum(t->batch, bytes);
+    struct iovec iov[2] = {
+        { &batch, sizeof(batch) },
+        { t->batch, bytes },
+    };
+    
+    ssize_t n;
+    do {
+        n = writev(t->fd, iov, 2);
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)(sizeof(batch) + bytes)) {
+        // A disk-full or short write leaves part of a batch behind; new batches must follow the last whole one
+        if (ftruncate(t->fd, t->kept) < 0) {
+            // The torn batch stays and is cut off by the next telemetry_open()
+        }
+        t->failed++;
+        return -1;
+    }
+    t->kept += n;
+    t->batches++;
+    t->records += count;
+    t->bytes += n;
+    return 0;
+}
+
+// Function to move everything waiting in the rings to the file, a batch at a time (writer thread).
+// Records a ring had to drop are written as a count, so readers can tell a lost record from one never made.
+static void drain(Telemetry* t) {
+    size_t count = 0;
+    int wrote = 0;
+    long long t0 = now_ns();
+    
+    for (TelemetryRing* r = __atomic_load_n(&t->rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+        unsigned long dropped = __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+        if (dropped != r->reported) {
+            if (count == TELEMETRY_BATCH) {
+                write_batch(t, count);
+                count = 0;
+                wrote = 1;
+            }
+            t->batch[count++] = (TelemetryRecord){ TELEMETRY_DROPPED, 0, 0, 0, 0, (uint32_t)(dropped - r->reported) };
+            r->reported = dropped;
+        }
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = r->tail;
+        while (tail != head) {
+            size_t n = head - tail;
+            size_t first = tail & (TELEMETRY_RING - 1);
+            n = n < TELEMETRY_BATCH - count ? n : TELEMETRY_BATCH - count;
+            n = n < TELEMETRY_RING - first ? n : TELEMETRY_RING - first;
+            memcpy(t->batch + count, r->records + first, n * sizeof(TelemetryRecord));
+            count += n;
+            tail += n;
+            __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE); // The slots are free for the game again
+            if (count == TELEMETRY_BATCH) {
+                write_batch(t, count);
+                count = 0;
+                wrote = 1;
+            }
+        }
+    }
+    if (count > 0) {
+        write_batch(t, count);
+        wrote = 1;
+    }
+    if (!wrote) {
+        return;
+    }
+    
+    // One sync per drain: a crash loses at most the last drain, and only whole batches are ever read back
+    fdatasync(t->fd);
+    unsigned long long ns = now_ns() - t0;
+    t->write_ns += ns;
+    t->drains++;
+    if (ns > t->write_ns_max) {
+        t->write_ns_max = ns;
+    }
+}
+
+// Function run by the writer thread: drain the rings every TELEMETRY_FLUSH_MS, and once more when stopped
+static void* writer_thread(void* arg) {
+    Telemetry* t = arg;
+    
+    for (;;) {
+        struct timespec until;
+        clock_gettime(CLOCK_MONOTONIC, &until);
+        until.tv_nsec += TELEMETRY_FLUSH_MS * 1000000L;
+        until.tv_sec += until.tv_nsec / 1000000000L;
+        until.tv_nsec %= 1000000000L;
+        
+        pthread_mutex_lock(&t->lock);
+        while (!t->stop && !t->hurry && pthread_cond_timedwait(&t->wake, &t->lock, &until) != ETIMEDOUT) {
+            // Woken without a reason, keep waiting out the interval
+        }
+        int stop = t->stop;
+        t->early += t->hurry && !stop;
+        t->hurry = 0;
+        pthread_mutex_unlock(&t->lock);
+        
+        drain(t);
+        if (stop) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Function to open a telemetry file for appending, cutting off a batch a crash left half written, and start the writer.
+// Match numbers carry on from the last one in the file.
+int telemetry_open(Telemetry* t, const char* path) {
+    memset(t, 0, sizeof(Telemetry));
+    t->fd = -1;
+    
+    TelemetryScan scan;
+    int exists = telemetry_scan(path, &scan, last_match, &t->next_match) == 0;
+    if (!exists && errno != ENOENT) {
+        struct stat st;
+        if (stat(path, &st) < 0 || st.st_size > 0) {
+            return -1; // Not a telemetry file, leave it alone
+        }
+    }
+    
+    t->batch = malloc(TELEMETRY_BATCH * sizeof(TelemetryRecord));
+    t->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (!t->batch || t->fd < 0) {
+        telemetry_close(t);
+        return -1;
+    }
+    if (exists) {
+        t->kept = scan.valid;
+        if (scan.valid < scan.size && ftruncate(t->fd, scan.valid) < 0) {
+            telemetry_close(t);
+            return -1;
+        }
+    } else {
+        TelemetryHeader hdr = { .version = TELEMETRY_VERSION, .record_size = sizeof(TelemetryRecord) };
+        memcpy(hdr.magic, TELEMETRY_MAGIC, 4);
+        if (write(t->fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+            telemetry_close(t);
+            return -1;
+        }
+        t->kept = sizeof(hdr);
+    }
+    
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&t->lock, NULL);
+    t->id = __atomic_add_fetch(&sink_ids, 1, __ATOMIC_RELAXED);
+    if (pthread_create(&t->thread, NULL, writer_thread, t) != 0) {
+        pthread_mutex_destroy(&t->lock);
+        pthread_cond_destroy(&t->wake);
+        telemetry_close(t);
+        return -1;
+    }
+    t->running = 1;
+    return 0;
+}
+
+// Function to write what is left, close the file and free the rings; every thread recording into the sink must be done
+void telemetry_close(Telemetry* t) {
+    if (t->running) {
+        pthread_mutex_lock(&t->lock);
+        t->stop = 1;
+        pthread_cond_signal(&t->wake);
+        pthread_mutex_unlock(&t->lock);
+        pthread_join(t->thread, NULL);
+        pthread_mutex_destroy(&t->lock);
+        pthread_cond_destroy(&t->wake);
+        t->running = 0;
+    }
+    if (t->fd >= 0) {
+        close(t->fd);
+        t->fd = -1;
+    }
+    free(t->batch);
+    t->batch = NULL;
+    
+    // Every ring was drained by the writer's last pass
+    while (t->rings) {
+        TelemetryRing* r = t->rings;
+        t->rings = r->next;
+        t->dropped += r->dropped;
+        t->threads++;
+        free(r);
+    }
+}
+
+// Function to hand out the number of a new match, unique within the file
+uint32_t telemetry_match(Telemetry* t) {
+    return __atomic_add_fetch(&t->next_match, 1, __ATOMIC_RELAXED);
+}
+
+// Function to find this thread's ring, making one the first time the thread records into this sink
+static TelemetryRing* ring_of_thread(Telemetry* t) {
+    if (thread_sink == t->id) {
+        return thread_ring;
+    }
+    TelemetryRing* r;
+    if (posix_memalign((void**)&r, 64, sizeof(TelemetryRing)) != 0) {
+        return NULL;
+    }
+    memset(r, 0, sizeof(TelemetryRing));
+    r->next = __atomic_load_n(&t->rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&t->rings, &r->next, r, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        // r->next now holds the newer head, try again
+    }
+    thread_ring = r;
+    thread_sink = t->id;
+    return r;
+}
+
+// Function to add a record from any thread. Never blocks: when the writer has fallen a whole ring behind,
+// the record is dropped and counted. A ring half full wakes the writer, the one time a record takes a lock.
+void telemetry_record(Telemetry* t, int kind, uint32_t match, unsigned long tick, int tank, int arg, uint32_t value) {
+    TelemetryRing* r = ring_of_thread(t);
+    if (!r) {
+        return;
+    }
+    uint64_t head = r->head;
+    uint64_t waiting = head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if (waiting == TELEMETRY_RING) {
+        __atomic_store_n(&r->dropped, r->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (waiting == TELEMETRY_HIGH_WATER) {
+        pthread_mutex_lock(&t->lock);
+        t->hurry = 1;
+        pthread_cond_signal(&t->wake);
+        pthread_mutex_unlock(&t->lock);
+    }
+    r->records[head & (TELEMETRY_RING - 1)] = (TelemetryRecord){
+        (uint8_t)kind, (uint8_t)arg, (uint16_t)tank, match, (uint32_t)tick, value
+    };
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Function to print what was written (after telemetry_close)
+void telemetry_print_stats(Telemetry* t, FILE* out) {
+    if (t->threads == 0) {
+        return;
+    }
+    fprintf(out, "telemetry: %llu records from %d threads in %lu batches (%.1f KB), %lu dropped, %lu failed writes\n",
+            t->records, t->threads, t->batches, t->bytes / 1024.0, t->dropped, t->failed);
+    if (t->drains > 0) {
+        fprintf(out, "telemetry: %.1f records per batch, %.2f ms per drain and sync (max %.2f ms), %lu drains woken early\n",
+                (double)t->records / t->batches, t->write_ns / 1e6 / t->drains, t->write_ns_max / 1e6, t->early);
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef TANK_TELEMETRY_H
+#define TANK_TELEMETRY_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TELEMETRY_MAGIC "TTEL"
+#define TELEMETRY_BATCH_MAGIC 0x48435442u // "BTCH" read in host byte order
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_RING 65536 // Records each thread can have waiting, a power of two
+#define TELEMETRY_BATCH 16384 // Most records written by one write()
+#define TELEMETRY_FLUSH_MS 250 // How often the writer drains the rings
+#define TELEMETRY_HIGH_WATER (TELEMETRY_RING / 2) // Records waiting in one ring that wake the writer early
+
+// Record kinds
+typedef enum {
+    TELEMETRY_ROUND, // tank = tanks, arg = TELEMETRY_ROUND_*, value = seed (0 when resumed); starts a match
+    TELEMETRY_ROUND_END, // tank = winner (0xFFFF for none), arg = TELEMETRY_ROUND_LIMIT if cut off, value = ticks played
+    TELEMETRY_TICK, // tank = projectiles in flight, value = tick time in ns
+    TELEMETRY_MOVE, // arg = direction, value = x | y << 16 of the new cell
+    TELEMETRY_SHOT, // arg = direction, value = x | y << 16 of the projectile
+    TELEMETRY_HIT, // tank = tank hit, arg = health left, value = shooter
+    TELEMETRY_PROJECTILE_END, // tank = owner, arg = what stopped it, value = ticks in flight
+    TELEMETRY_DROPPED, // match = 0, value = records one thread's ring had no room for since the last one
+    TELEMETRY_KINDS
+} TelemetryKind;
+
+// How a match started
+#define TELEMETRY_ROUND_NEW 0
+#define TELEMETRY_ROUND_RESUMED 1 // Picked up from a checkpoint, its first part is in an earlier run
+#define TELEMETRY_ROUND_LIMIT 1 // On an end record: the match hit a tick limit with no winner
+
+// What ended a projectile
+#define TELEMETRY_END_WALL 0 // A wall or the board edge
+#define TELEMETRY_END_TANK 1
+#define TELEMETRY_END_SHOT 2 // Met another projectile
+#define TELEMETRY_ENDS 3
+
+// One fixed-size record, in host byte order
+typedef struct {
+    uint8_t kind;
+    uint8_t arg;
+    uint16_t tank;
+    uint32_t match; // Match number given by telemetry_match()
+    uint32_t tick;
+    uint32_t value;
+} TelemetryRecord;
+
+// On-disk file header, followed by batches
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+} TelemetryHeader;
+
+// Header of one batch of records. A batch cut short by a crash fails its checksum; the next
+// telemetry_open() cuts it off so new batches follow the last whole one.
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t checksum; // FNV-1a of the records
+} TelemetryBatch;
+
+// Records waiting from one thread: only that thread writes head, only the writer thread writes tail
+typedef struct TelemetryRing {
+    TelemetryRecord records[TELEMETRY_RING];
+    struct TelemetryRing* next; // Every ring of the sink, newest first
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t tail __attribute__((aligned(64)));
+    unsigned long dropped; // Records the ring had no room for, atomic
+    unsigned long reported; // Drops already written as a TELEMETRY_DROPPED record, writer thread only
+} TelemetryRing;
+
+// Telemetry sink shared by every game of the process. Game threads append records to rings of their own
+// without locks or system calls; a writer thread moves them to the file in batches.
+typedef struct Telemetry {
+    int fd;
+    uint32_t id; // Tells this sink from earlier ones in the per-thread ring cache
+    TelemetryRing* rings; // Atomic head of the ring list
+    uint32_t next_match; // Atomic
+    pthread_t thread;
+    int running;
+    pthread_mutex_t lock; // Guards stop and hurry, only for the writer's timed wait
+    pthread_cond_t wake;
+    int stop;
+    int hurry; // A ring reached the high-water mark: drain now rather than at the end of the interval
+    TelemetryRecord* batch; // Writer thread only
+    size_t kept; // Bytes of whole batches found in the file on open
+
+    // Writer thread
+    unsigned long drains, batches, failed;
+    unsigned long early; // Drains started by the high-water mark
+    unsigned long long records, bytes;
+    unsigned long long write_ns, write_ns_max;
+    
+    // Totals of the rings, gathered when they are freed
+    unsigned long dropped;
+    int threads;
+} Telemetry;
+
+// Summary of a telemetry file, filled in batch by batch
+typedef struct {
+    unsigned long batches;
+    unsigned long long records;
+    unsigned long long kinds[TELEMETRY_KINDS];
+    size_t valid; // Bytes up to the end of the last whole batch
+    size_t size;
+} TelemetryScan;
+
+int telemetry_open(Telemetry* t, const char* path);
+void telemetry_close(Telemetry* t);
+uint32_t telemetry_match(Telemetry* t);
+void telemetry_record(Telemetry* t, int kind, uint32_t match, unsigned long tick, int tank, int arg, uint32_t value);
+void telemetry_print_stats(Telemetry* t, FILE* out);
+int telemetry_scan(const char* path, TelemetryScan* scan,
+                   void (*visit)(const TelemetryRecord* records, size_t count, void* arg), void* arg);
+
+#endif
@@ -0,0 +1,389 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "terminal.h"
+#include "render.h"
+
+// Function to write a control sequence straight to a terminal, outside the frame writer
+static void send_raw(int fd, const char* s) {
+    size_t len = strlen(s);
+    while (len > 0) {
+        ssize_t n = write(fd, s, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        s += n;
+        len -= n;
+    }
+}
+
+// Function to bump an eventfd, never blocking
+static void signal_fd(int fd) {
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) < 0) {
+        // Only fails when the counter is saturated, the reader is awake then anyway
+    }
+}
+
+// Function to set up the shared snapshot; terminals are added with terminal_add()
+int terminals_open(Terminals* ts, GameState* g, long budget) {
+    memset(ts, 0, sizeof(Terminals));
+    ts->g = g;
+    ts->budget = budget > 0 ? budget : 0;
+    ts->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ts->event_fd < 0) {
+        return -1;
+    }
+    if (snapshot_open(&ts->snap, g) < 0) {
+        close(ts->event_fd);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to act on one byte typed on a terminal: wasd or the arrows move, space or enter fires, q quits
+static void terminal_key(Terminal* t, unsigned char ch) {
+    Terminals* ts = t->host;
+    int action = -1;
+    
+    // Arrow keys arrive as ESC [ A to D (or ESC O A to D in application mode)
+    if (t->esc_len == 1) {
+        t->esc_len = ch == '[' || ch == 'O' ? 2 : 0;
+        if (t->esc_len) {
+            return;
+        }
+    } else if (t->esc_len == 2) {
+        t->esc_len = 0;
+        switch (ch) {
+            case 'A':
+                action = ACTION_UP;
+                break;
+            case 'B':
+                action = ACTION_DOWN;
+                break;
+            case 'C':
+                action = ACTION_RIGHT;
+                break;
+            case 'D':
+                action = ACTION_LEFT;
+                break;
+        }
+    }
+    if (ch == 27) {
+        t->esc_len = 1;
+        return;
+    }
+    
+    if (action < 0) {
+        switch (ch) {
+            case 'w':
+            case 'W':
+                action = ACTION_UP;
+                break;
+            case 's':
+            case 'S':
+                action = ACTION_DOWN;
+                break;
+            case 'a':
+            case 'A':
+                action = ACTION_LEFT;
+                break;
+            case 'd':
+            case 'D':
+                action = ACTION_RIGHT;
+                break;
+            case ' ':
+            case '\r':
+                action = ACTION_FIRE;
+                break;
+            case 'q':
+            case 'Q':
+                __atomic_store_n(&ts->quit, 1, __ATOMIC_RELEASE);
+                signal_fd(ts->event_fd);
+                return;
+            default:
+                return;
+        }
+    }
+    
+    tank_action(ts->g, t->tank, (Action)action);
+    t->keys++;
+    signal_fd(ts->event_fd); // The game loop arms its tick timer for held keys
+}
+
+// Function to keep the followed tank away from the view edges, jumping to recenter like the main renderer
+static void follow(Terminal* t) {
+    const SnapshotTank* tank = &t->view.tanks[t->tank];
+    int margin_x = t->view_w / 4, margin_y = t->view_h / 4;
+    
+    if (tank->x < t->origin_x + margin_x || tank->x >= t->origin_x + t->view_w - margin_x) {
+        t->origin_x = tank->x - t->view_w / 2;
+    }
+    if (tank->y < t->origin_y + margin_y || tank->y >= t->origin_y + t->view_h - margin_y) {
+        t->origin_y = tank->y - t->view_h / 2;
+    }
+    t->origin_x = t->origin_x > t->view.width - t->view_w ? t->view.width - t->view_w : t->origin_x;
+    t->origin_y = t->origin_y > t->view.height - t->view_h ? t->view.height - t->view_h : t->origin_y;
+    t->origin_x = t->origin_x < 0 ? 0 : t->origin_x;
+    t->origin_y = t->origin_y < 0 ? 0 : t->origin_y;
+}
+
+// Function to draw the control panel of a terminal's player
+static void draw_hud(Terminal* t) {
+    AnsiWriter* w = &t->out;
+    const SnapshotTank* tank = &t->view.tanks[t->tank];
+    int x = t->view_w + 2;
+    char line[TERMINAL_HUD_WIDTH + 1];
+    int color = render_pair_color(tank_color_pair(t->tank));
+    
+    snprintf(line, sizeof(line), "Player %c", tank->symbol);
+    ansi_puts(w, 0, x, line, color);
+    for (int i = 0; i < MAX_HEALTH; i++) {
+        ansi_puts(w, 1, x + i * 2, i < tank->health ? HEART_STR : "  ", render_pair_color(COLOR_HEART));
+    }
+    snprintf(line, sizeof(line), "Tanks alive: %d/%d ", t->view.tanks_alive, t->view.num_tanks);
+    ansi_puts(w, 3, x, line, ANSI_DEFAULT_COLOR);
+    ansi_puts(w, 5, x, "Move: w a s d, arrows", ANSI_DEFAULT_COLOR);
+    ansi_puts(w, 6, x, "Fire: space", ANSI_DEFAULT_COLOR);
+    ansi_puts(w, 7, x, "Press 'q' to quit", ANSI_DEFAULT_COLOR);
+    
+    if (!t->view.game_over) {
+        snprintf(line, sizeof(line), "%*s", TERMINAL_HUD_WIDTH - 2, "");
+    } else if (t->view.winner >= 0) {
+        snprintf(line, sizeof(line), "Player %c won!", t->view.tanks[t->view.winner].symbol);
+    } else {
+        snprintf(line, sizeof(line), "Round over");
+    }
+    ansi_puts(w, 9, x, line, ANSI_DEFAULT_COLOR);
+}
+
+// Function to draw one frame from the snapshot, 0 when the game was publishing and it should be tried again
+static int draw_frame(Terminal* t) {
+    Terminals* ts = t->host;
+    struct winsize ws;
+    int lines = TERMINAL_LINES, cols = TERMINAL_COLS;
+    
+    if (ioctl(t->fd, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+        lines = ws.ws_row;
+        cols = ws.ws_col;
+    }
+    if (lines != t->lines || cols != t->cols) {
+        if (ansi_init(&t->out, t->fd, ts->budget, lines, cols) < 0) {
+            return 1; // Out of memory, wait for the next frame
+        }
+        send_raw(t->fd, "\033[m\033[H\033[2J");
+        t->lines = lines;
+        t->cols = cols;
+        t->view_w = cols - TERMINAL_HUD_WIDTH < t->view.width ? cols - TERMINAL_HUD_WIDTH : t->view.width;
+        t->view_h = lines < t->view.height ? lines : t->view.height;
+        t->view_w = t->view_w > 3 ? t->view_w : 3;
+    }
+    
+    // Follow the tank where it was, and once more if it moved out of that region meanwhile
+    follow(t);
+    if (!snapshot_read(&t->view, t->origin_x, t->origin_y, t->view_w, t->view_h)) {
+        t->retries++;
+        return 0;
+    }
+    int ox = t->origin_x, oy = t->origin_y;
+    follow(t);
+    if ((ox != t->origin_x || oy != t->origin_y) &&
+        !snapshot_read(&t->view, t->origin_x, t->origin_y, t->view_w, t->view_h)) {
+        t->retries++;
+        return 0;
+    }
+    
+    if (t->view.round != t->round) {
+        t->round = t->view.round;
+        send_raw(t->fd, "\033[m\033[H\033[2J");
+        ansi_blank(&t->out);
+    }
+    for (int y = 0; y < t->view_h; y++) {
+        size_t row = (size_t)(t->origin_y + y) * t->view.width + t->origin_x;
+        for (int x = 0; x < t->view_w; x++) {
+            char glyph = t->view.glyph[row + x];
+            ansi_put(&t->out, y, x, glyph, render_cell_color(glyph, t->view.entity[row + x]));
+        }
+    }
+    draw_hud(t);
+    ansi_flush(&t->out);
+    t->frames++;
+    return 1;
+}
+
+// Function run by each terminal's thread: read its keys, draw a frame whenever the game publishes one
+static void* terminal_main(void* arg) {
+    Terminal* t = arg;
+    Terminals* ts = t->host;
+    struct pollfd fds[2] = {
+        { .fd = t->fd, .events = POLLIN },
+        { .fd = t->wake_fd, .events = POLLIN },
+    };
+    int pending = 1; // Draw the current board straight away
+    
+    while (!__atomic_load_n(&ts->stop, __ATOMIC_ACQUIRE)) {
+        if (pending && draw_frame(t)) {
+            pending = 0;
+        }
+        if (poll(fds, 2, pending ? 1 : -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents & (POLLHUP | POLLERR)) {
+            fprintf(stderr, "terminal: %s hung up\n", t->path);
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            unsigned char buf[64];
+            ssize_t n = read(t->fd, buf, sizeof(buf));
+            for (ssize_t i = 0; i < n; i++) {
+                terminal_key(t, buf[i]);
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            if (read(t->wake_fd, &count, sizeof(count)) == sizeof(count)) {
+                pending = 1;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Function to open a terminal from "path[:tank]", put it in raw mode and start its thread.
+// Without a tank the first terminal plays the second player, the next one the first, and so on.
+int terminal_add(Terminals* ts, const char* spec) {
+    if (ts->count == TERMINAL_MAX) {
+        fprintf(stderr, "terminal: at most %d terminals\n", TERMINAL_MAX);
+        return -1;
+    }
+    Terminal* t = &ts->terms[ts->count];
+    memset(t, 0, sizeof(Terminal));
+    t->host = ts;
+    t->wake_fd = -1;
+    t->path = strdup(spec);
+    if (!t->path) {
+        return -1;
+    }
+    t->tank = (ts->count + 1) % NUM_PLAYERS;
+    char* colon = strrchr(t->path, ':');
+    if (colon && colon[1] && strspn(colon + 1, "0123456789") == strlen(colon + 1)) {
+        *colon = '\0';
+        t->tank = atoi(colon + 1);
+    }
+    if (t->tank >= ts->g->num_tanks) {
+        fprintf(stderr, "terminal: %s: no tank %d\n", t->path, t->tank);
+        free(t->path);
+        return -1;
+    }
+    
+    t->fd = open(t->path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (t->fd < 0) {
+        fprintf(stderr, "terminal: %s: %s\n", t->path, strerror(errno));
+        free(t->path);
+        return -1;
+    }
+    if (tcgetattr(t->fd, &t->saved) < 0) {
+        fprintf(stderr, "terminal: %s is not a terminal\n", t->path);
+        close(t->fd);
+        free(t->path);
+        return -1;
+    }
+    struct termios raw = t->saved;
+    cfmakeraw(&raw);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(t->fd, TCSANOW, &raw);
+    send_raw(t->fd, "\033[?25l"); // Hide the cursor
+    
+    t->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (t->wake_fd < 0 || snapshot_reader_init(&t->view, ts->snap.map) < 0 ||
+        pthread_create(&t->thread, NULL, terminal_main, t) != 0) {
+        tcsetattr(t->fd, TCSANOW, &t->saved);
+        close(t->fd);
+        if (t->wake_fd >= 0) {
+            close(t->wake_fd);
+        }
+        snapshot_reader_free(&t->view);
+        free(t->path);
+        return -1;
+    }
+    t->running = 1;
+    ts->count++;
+    return 0;
+}
+
+// Function to publish the board and wake every terminal (game thread)
+void terminals_publish(Terminals* ts, GameState* g) {
+    if (ts->count == 0) {
+        return;
+    }
+    snapshot_publish(&ts->snap, g);
+    for (int i = 0; i < ts->count; i++) {
+        signal_fd(ts->terms[i].wake_fd);
+    }
+}
+
+// Function to have the next publish send the whole board, for a new round
+void terminals_round(Terminals* ts) {
+    snapshot_round(&ts->snap);
+}
+
+// Function to drain the event fd once the game loop sees it readable; returns 1 when a terminal asked to quit
+int terminals_events(Terminals* ts) {
+    uint64_t count;
+    if (read(ts->event_fd, &count, sizeof(count)) < 0) {
+        // Nothing pending
+    }
+    return __atomic_load_n(&ts->quit, __ATOMIC_ACQUIRE);
+}
+
+// Function to stop the terminal threads and give the terminals back as they were (print the stats first)
+void terminals_close(Terminals* ts) {
+    __atomic_store_n(&ts->stop, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < ts->count; i++) {
+        signal_fd(ts->terms[i].wake_fd);
+    }
+    for (int i = 0; i < ts->count; i++) {
+        Terminal* t = &ts->terms[i];
+        pthread_join(t->thread, NULL);
+        send_raw(t->fd, "\033[m\033[H\033[2J\033[?25h");
+        tcsetattr(t->fd, TCSANOW, &t->saved);
+        close(t->fd);
+        close(t->wake_fd);
+        ansi_free(&t->out);
+        snapshot_reader_free(&t->view);
+        free(t->path);
+    }
+    ts->count = 0;
+    snapshot_close(&ts->snap);
+    close(ts->event_fd);
+}
+
+// Function to print what every terminal drew and copied
+void terminals_print_stats(Terminals* ts, FILE* out) {
+    if (ts->count == 0) {
+        return;
+    }
+    snapshot_print_stats(&ts->snap, out);
+    for (int i = 0; i < ts->count; i++) {
+        Terminal* t = &ts->terms[i];
+        const AnsiStats* a = ansi_stats(&t->out);
+        fprintf(out, "terminal %s (tank %d): %lu frames, %lu keys, %.1f chunks copied per read, %lu reads retried, "
+                "%.1f bytes/frame\n",
+                t->path, t->tank, t->frames, t->keys, t->view.reads ? (double)t->view.chunks / t->view.reads : 0.0,
+                t->view.torn, a->frames ? (double)a->bytes_total / a->frames : 0.0);
+    }
+}
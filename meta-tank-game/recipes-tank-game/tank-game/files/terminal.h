@@ -0,0 +1,61 @@
+#ifndef TANK_TERMINAL_H
+#define TANK_TERMINAL_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include <termios.h>
+
+#include "game.h"
+#include "ansi.h"
+#include "snapshot.h"
+
+#define TERMINAL_MAX 8
+#define TERMINAL_LINES 24 // Size taken when the terminal cannot tell (serial lines)
+#define TERMINAL_COLS 80
+#define TERMINAL_HUD_WIDTH 24 // Columns kept for the control panel
+
+// One extra terminal: a player's own keyboard and screen, served by a thread of its own
+typedef struct {
+    struct Terminals* host;
+    char* path;
+    int fd;
+    int tank; // Tank its keys drive and its view follows
+    struct termios saved; // Settings put back on close
+    int wake_fd; // eventfd: a new snapshot was published, or stop
+    pthread_t thread;
+    int running;
+    AnsiWriter out;
+    SnapshotReader view;
+    int lines, cols;
+    int view_w, view_h; // Board cells shown
+    int origin_x, origin_y; // Board cell in the top-left corner
+    uint32_t round; // Round on screen
+    int esc_len; // Bytes of an arrow key sequence seen so far
+
+    unsigned long frames;
+    unsigned long keys;
+    unsigned long retries; // Frames read while the game was publishing, drawn a moment later
+} Terminal;
+
+// Terminals besides the game's own: the game publishes the board into a shared snapshot after every frame
+// and wakes them; each one copies the cells that changed and draws them without ever taking board_mutex.
+typedef struct Terminals {
+    Terminal terms[TERMINAL_MAX];
+    int count;
+    GameState* g;
+    Snapshot snap;
+    long budget; // Bytes per frame on every terminal, 0 for no limit
+    int event_fd; // eventfd the game loop polls: keys arrived or q was pressed
+    int quit; // Atomic
+    int stop; // Atomic
+} Terminals;
+
+int terminals_open(Terminals* ts, GameState* g, long budget);
+int terminal_add(Terminals* ts, const char* spec);
+void terminals_publish(Terminals* ts, GameState* g);
+void terminals_round(Terminals* ts);
+int terminals_events(Terminals* ts);
+void terminals_close(Terminals* ts);
+void terminals_print_stats(Terminals* ts, FILE* out);
+
+#endif
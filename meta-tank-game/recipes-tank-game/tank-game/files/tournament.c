@@ -0,0 +1,457 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "ai.h"
+#include "telemetry.h"
+
+// Tournament defaults
+#define DEFAULT_MATCHES 2000
+#define DEFAULT_TANKS 4
+#define DEFAULT_TICK_LIMIT (300 * TICKS_PER_SEC) // Five minutes of game time, then the match is a draw
+#define DEFAULT_MAX_UNFINISHED 10 // Percent of matches that may reach the tick limit before the run fails
+#define MAX_WORKERS 256
+#define RANGE(lo, hi) ((uint64_t)(hi) << 32 | (uint32_t)(lo))
+#define RANGE_LO(r) ((uint32_t)(r))
+#define RANGE_HI(r) ((uint32_t)((r) >> 32))
+
+// One tournament's settings
+typedef struct {
+    int width, height;
+    int tanks; // Players plus bots, every one driven by the AI
+    int matches;
+    int threads;
+    long tick_limit;
+    int max_unfinished; // Percent of matches allowed to reach the tick limit, more fails the run
+    unsigned int seed; // Match i is played on seed + i, whichever worker runs it
+    int scaling; // Run again on 1, 2, 4, ... threads up to the thread count
+    int pin; // Pin worker i to CPU i (modulo the CPU count)
+} TournamentConfig;
+
+// How one match ended
+typedef struct {
+    int winner; // Tank index, -1 for a draw (everyone died, or the tick limit came)
+    unsigned long ticks;
+} MatchResult;
+
+// One worker: a match of its own reused round after round, and its share of the match indices.
+// The range [lo, hi) is one word so the owner can pop from the bottom and thieves take the top half with one CAS.
+typedef struct {
+    uint64_t range; // Atomic
+    int id;
+    pthread_t thread;
+    Rng rng; // Picks victims to steal from
+    GameState game;
+    Ai ai;
+    Direction start_dir[MAX_TANKS]; // Facings setup_tanks() gave, every match starts from them
+    unsigned long matches;
+    unsigned long steals; // Ranges taken from other workers
+    unsigned long steal_fails; // Sweeps over every other worker that found nothing
+    unsigned long long ticks;
+    long long busy_ns;
+} __attribute__((aligned(64))) Worker;
+
+static const TournamentConfig* cfg;
+static Worker* workers;
+static int num_workers;
+static MatchResult* results;
+static Telemetry telemetry; // Shared by every worker with -L
+static int recording;
+
+// Function to read the current monotonic time in nanoseconds
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Function to take the next match index from the bottom of a worker's own range, -1 if it is empty
+static long pop_match(Worker* w) {
+    uint64_t r = __atomic_load_n(&w->range, __ATOMIC_ACQUIRE);
+    while (RANGE_LO(r) < RANGE_HI(r)) {
+        if (__atomic_compare_exchange_n(&w->range, &r, RANGE(RANGE_LO(r) + 1, RANGE_HI(r)), 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return RANGE_LO(r);
+        }
+    }
+    return -1;
+}
+
+// Function to move the top half of another worker's range into an empty one's, 0 if every other worker is empty.
+// A match index is handed out once, so a range never comes back and a stale CAS cannot succeed.
+static int steal_matches(Worker* w) {
+    int start = rng_next(&w->rng) % num_workers;
+    
+    for (int i = 0; i < num_workers; i++) {
+        Worker* victim = &workers[(start + i) % num_workers];
+        if (victim == w) {
+            continue;
+        }
+        uint64_t r = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+        while (RANGE_LO(r) < RANGE_HI(r)) {
+            uint32_t lo = RANGE_LO(r), hi = RANGE_HI(r);
+            uint32_t mid = lo + (hi - lo) / 2; // A single match is taken whole
+            if (__atomic_compare_exchange_n(&victim->range, &r, RANGE(lo, mid), 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                // Our own range is empty, so no thief touches it until this store
+                __atomic_store_n(&w->range, RANGE(mid, hi), __ATOMIC_RELEASE);
+                w->steals++;
+                return 1;
+            }
+        }
+    }
+    w->steal_fails++;
+    return 0;
+}
+
+// Function to play one match to the end or the tick limit
+static void play_match(Worker* w, long m) {
+    GameState* g = &w->game;
+    
+    // Tanks keep their facing from round to round, so put them back as setup_tanks() left them
+    for (int i = 0; i < g->num_tanks; i++) {
+        g->tanks[i].dir = w->start_dir[i];
+    }
+    reset_game(g, cfg->seed + (unsigned int)m);
+    while (!g->game_over && (long)g->tick < cfg->tick_limit) {
+        simulation_tick(g);
+    }
+    if (!g->game_over && g->telemetry) {
+        // Stopped by the limit: a draw, which the telemetry has to be told since no tank ended it
+        telemetry_record(g->telemetry, TELEMETRY_ROUND_END, g->match, g->tick, 0xFFFF, TELEMETRY_ROUND_LIMIT, g->tick);
+    }
+    results[m].winner = g->game_over ? g->winner : -1;
+    results[m].ticks = g->tick;
+    w->ticks += g->tick;
+    w->matches++;
+}
+
+// Function run by each worker: its own matches first, then whatever it can steal
+static void* worker_main(void* arg) {
+    Worker* w = arg;
+    
+    if (cfg->pin) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->id % sysconf(_SC_NPROCESSORS_ONLN), &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    
+    long long start = now_ns();
+    for (;;) {
+        long m = pop_match(w);
+        if (m >= 0) {
+            play_match(w, m);
+        } else if (!steal_matches(w)) {
+            break; // Nothing left anywhere; matches already taken are finished by their thieves
+        }
+    }
+    w->busy_ns = now_ns() - start;
+    return NULL;
+}
+
+// Function to set up every worker's match instance, once for all the runs
+static int init_workers(int count) {
+    workers = aligned_alloc(64, count * sizeof(Worker));
+    if (!workers) {
+        return -1;
+    }
+    memset(workers, 0, count * sizeof(Worker));
+    
+    for (int i = 0; i < count; i++) {
+        Worker* w = &workers[i];
+        w->id = i;
+        rng_seed(&w->rng, cfg->seed ^ (0x9E3779B9u * (i + 1)));
+        if (game_init(&w->game, cfg->width, cfg->height, MAX_PROJECTILES, cfg->tanks) < 0) {
+            return -1;
+        }
+        num_workers = i + 1;
+        setup_tanks(&w->game, 'A', 'B');
+        for (int t = 0; t < cfg->tanks; t++) {
+            w->start_dir[t] = w->game.tanks[t].dir;
+        }
+        if (ai_init(&w->ai, &w->game, (1u << NUM_PLAYERS) - 1) < 0) {
+            return -1;
+        }
+        w->game.telemetry = recording ? &telemetry : NULL;
+    }
+    return 0;
+}
+
+// Function to release every worker's match instance
+static void free_workers() {
+    for (int i = 0; i < num_workers; i++) {
+        ai_free(&workers[i].ai, &workers[i].game);
+        game_free(&workers[i].game);
+    }
+    free(workers);
+}
+
+// Function to run every match on the first threads workers, returning the wall time in nanoseconds
+static long long run_tournament(int threads) {
+    num_workers = threads;
+    for (int i = 0; i < threads; i++) {
+        Worker* w = &workers[i];
+        // Even split to start with; stealing evens out matches of different lengths
+        long lo = (long)cfg->matches * i / threads;
+        long hi = (long)cfg->matches * (i + 1) / threads;
+        w->range = RANGE(lo, hi);
+        w->matches = w->steals = w->steal_fails = 0;
+        w->ticks = 0;
+        w->busy_ns = 0;
+    }
+    
+    long long start = now_ns();
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            workers[i].thread = 0; // Its matches are stolen by the others
+        }
+    }
+    worker_main(&workers[0]);
+    for (int i = 1; i < threads; i++) {
+        if (workers[i].thread) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+    return now_ns() - start;
+}
+
+// Function to compare match lengths for qsort
+static int cmp_ul(const void* a, const void* b) {
+    unsigned long x = *(const unsigned long*)a;
+    unsigned long y = *(const unsigned long*)b;
+    return (x > y) - (x < y);
+}
+
+// Function to fold every result into one hash, equal for every thread count when the matches are deterministic
+static uint64_t results_hash() {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (int m = 0; m < cfg->matches; m++) {
+        h = (h ^ (uint64_t)(results[m].winner + 1)) * 0x100000001B3ULL;
+        h = (h ^ results[m].ticks) * 0x100000001B3ULL;
+    }
+    return h;
+}
+
+// Function to print the win rates and match lengths, returning how many matches reached the tick limit
+static unsigned long print_results(FILE* out) {
+    unsigned long* wins = calloc(cfg->tanks, sizeof(unsigned long));
+    unsigned long* lengths = malloc(cfg->matches * sizeof(unsigned long));
+    if (!wins || !lengths) {
+        free(wins);
+        free(lengths);
+        return 0;
+    }
+    
+    unsigned long draws = 0, timeouts = 0;
+    unsigned long long total = 0;
+    for (int m = 0; m < cfg->matches; m++) {
+        if (results[m].winner >= 0) {
+            wins[results[m].winner]++;
+        } else if ((long)results[m].ticks >= cfg->tick_limit) {
+            timeouts++;
+        } else {
+            draws++;
+        }
+        lengths[m] = results[m].ticks;
+        total += results[m].ticks;
+    }
+    qsort(lengths, cfg->matches, sizeof(unsigned long), cmp_ul);
+    
+    fprintf(out, "Win rates over %d matches:\n", cfg->matches);
+    for (int i = 0; i < cfg->tanks; i++) {
+        char symbol = workers[0].game.tanks[i].symbol;
+        fprintf(out, "  tank %d (%c)%s %6lu wins  %5.1f%%\n", i, symbol, i < NUM_PLAYERS ? " [player]" : "         ",
+                wins[i], 100.0 * wins[i] / cfg->matches);
+    }
+    fprintf(out, "  draws            %6lu       %5.1f%%\n", draws, 100.0 * draws / cfg->matches);
+    fprintf(out, "  tick limit       %6lu       %5.1f%%\n", timeouts, 100.0 * timeouts / cfg->matches);
+    
+    double tick_sec = (double)TICK_USEC / 1000000;
+    fprintf(out, "Match length (ticks, game seconds): mean %.0f (%.1fs)  p50 %lu (%.1fs)  p90 %lu (%.1fs)  "
+            "p99 %lu (%.1fs)  max %lu (%.1fs)\n",
+            (double)total / cfg->matches, (double)total / cfg->matches * tick_sec,
+            lengths[cfg->matches / 2], lengths[cfg->matches / 2] * tick_sec,
+            lengths[cfg->matches * 9 / 10], lengths[cfg->matches * 9 / 10] * tick_sec,
+            lengths[cfg->matches * 99 / 100], lengths[cfg->matches * 99 / 100] * tick_sec,
+            lengths[cfg->matches - 1], lengths[cfg->matches - 1] * tick_sec);
+    
+    free(wins);
+    free(lengths);
+    return timeouts;
+}
+
+// Function to print one run's throughput and how the work was spread
+static void print_run(FILE* out, int threads, long long wall_ns, double base_rate) {
+    unsigned long long ticks = 0;
+    unsigned long steals = 0, fails = 0, least = (unsigned long)-1, most = 0;
+    long long busy = 0;
+    for (int i = 0; i < threads; i++) {
+        ticks += workers[i].ticks;
+        steals += workers[i].steals;
+        fails += workers[i].steal_fails;
+        busy += workers[i].busy_ns;
+        least = workers[i].matches < least ? workers[i].matches : least;
+        most = workers[i].matches > most ? workers[i].matches : most;
+    }
+    
+    double secs = wall_ns / 1e9;
+    double rate = cfg->matches / secs;
+    fprintf(out, "%3d threads: %8.1f matches/s  %10.0f ticks/s  %.3fs", threads, rate, ticks / secs, secs);
+    if (base_rate > 0) {
+        fprintf(out, "  speedup %.2fx  efficiency %.0f%%", rate / base_rate, 100.0 * rate / base_rate / threads);
+    }
+    fprintf(out, "  | matches per worker %lu-%lu, %lu steals, %lu empty sweeps, busy %.0f%%\n",
+            least, most, steals, fails, 100.0 * busy / ((double)wall_ns * threads));
+}
+
+// Function to print the usage message
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-b WxH] [-n tanks] [-m matches] [-j threads] [-t ticks] [-s seed] [-f percent] [-S] [-P]\n"
+            "       [-L telemetry.tel]\n"
+            "  -b  board size (default %dx%d)\n"
+            "  -n  tanks per match, players plus bots, all driven by the AI (default %d)\n"
+            "  -m  matches to play (default %d)\n"
+            "  -j  worker threads (default one per online CPU)\n"
+            "  -t  tick limit per match, a draw when reached (default %d)\n"
+            "  -s  seed of the first match, match i uses seed + i (default 1)\n"
+            "  -f  fail when more than this percent of the matches reach the tick limit (default %d)\n"
+            "  -S  scaling run: play the tournament on 1, 2, 4, ... threads up to -j\n"
+            "  -P  pin worker i to CPU i\n"
+            "  -L  append every match's events to a telemetry file (see tank-telemetry)\n",
+            prog, BOARD_WIDTH, BOARD_HEIGHT, DEFAULT_TANKS, DEFAULT_MATCHES, DEFAULT_TICK_LIMIT,
+            DEFAULT_MAX_UNFINISHED);
+}
+
+int main(int argc, char* argv[]) {
+    TournamentConfig config = {
+        .width = BOARD_WIDTH, .height = BOARD_HEIGHT, .tanks = DEFAULT_TANKS,
+        .matches = DEFAULT_MATCHES, .threads = (int)sysconf(_SC_NPROCESSORS_ONLN),
+        .tick_limit = DEFAULT_TICK_LIMIT, .max_unfinished = DEFAULT_MAX_UNFINISHED, .seed = 1
+    };
+    const char* telemetry_path = NULL;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "b:n:m:j:t:s:f:SPL:")) != -1) {
+        switch (opt) {
+            case 'b':
+                if (sscanf(optarg, "%dx%d", &config.width, &config.height) != 2) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'n':
+                config.tanks = atoi(optarg);
+                break;
+            case 'm':
+                config.matches = atoi(optarg);
+                break;
+            case 'j':
+                config.threads = atoi(optarg);
+                break;
+            case 't':
+                config.tick_limit = atol(optarg);
+                break;
+            case 's':
+                config.seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                config.max_unfinished = atoi(optarg);
+                break;
+            case 'S':
+                config.scaling = 1;
+                break;
+            case 'P':
+                config.pin = 1;
+                break;
+            case 'L':
+                telemetry_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    if (config.threads < 1) {
+        config.threads = 1;
+    }
+    if (config.matches < 1 || config.tanks < NUM_PLAYERS || config.tanks > MAX_TANKS ||
+        config.threads > MAX_WORKERS || config.tick_limit < 1 || config.max_unfinished < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    cfg = &config;
+    
+    if (telemetry_path) {
+        if (telemetry_open(&telemetry, telemetry_path) < 0) {
+            fprintf(stderr, "tank-tournament: cannot write telemetry to %s\n", telemetry_path);
+            return 1;
+        }
+        recording = 1;
+    }
+    
+    results = calloc(config.matches, sizeof(MatchResult));
+    if (!results || init_workers(config.threads) < 0) {
+        fprintf(stderr, "tank-tournament: cannot set up %d matches of %dx%d\n", config.threads, config.width, config.height);
+        free_workers();
+        free(results);
+        if (recording) {
+            telemetry_close(&telemetry);
+        }
+        return 1;
+    }
+    
+    printf("Tournament: %d matches, %dx%d, %d tanks, tick limit %ld, seeds %u-%u, %d threads\n",
+           config.matches, config.width, config.height, config.tanks, config.tick_limit,
+           config.seed, config.seed + config.matches - 1, config.threads);
+    
+    int rc = 0;
+    double base_rate = 0;
+    uint64_t first_hash = 0;
+    for (int threads = config.scaling ? 1 : config.threads; ; threads *= 2) {
+        if (threads > config.threads) {
+            threads = config.threads;
+        }
+        long long wall = run_tournament(threads);
+        print_run(stdout, threads, wall, base_rate);
+        
+        uint64_t hash = results_hash();
+        if (base_rate == 0) {
+            base_rate = config.scaling && threads == 1 ? config.matches / (wall / 1e9) : -1;
+            first_hash = hash;
+        } else if (hash != first_hash) {
+            fprintf(stderr, "tank-tournament: results differ on %d threads (%016llx, was %016llx)\n",
+                    threads, (unsigned long long)hash, (unsigned long long)first_hash);
+            rc = 1;
+        }
+        if (threads == config.threads) {
+            break;
+        }
+    }
+    num_workers = config.threads;
+    
+    // Matches that stall until the limit mean the AI has stopped finishing its fights
+    unsigned long unfinished = print_results(stdout);
+    printf("Results hash: %016llx\n", (unsigned long long)first_hash);
+    if (unfinished * 100 > (unsigned long)config.max_unfinished * config.matches) {
+        fprintf(stderr, "tank-tournament: %lu of %d matches reached the tick limit (more than %d%%)\n",
+                unfinished, config.matches, config.max_unfinished);
+        rc = 1;
+    }
+    
+    free_workers();
+    free(results);
+    if (recording) {
+        telemetry_close(&telemetry);
+        telemetry_print_stats(&telemetry, stdout);
+    }
+    return rc;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+// One thread's ring: only its owner writes, the trace is read once every thread is done
+typedef struct {
+    const char* thread_name;
+    int tid;
+    unsigned long long head; // Events ever recorded; the newest is at (head - 1) & mask
+    unsigned long long mask;
+    TraceEvent events[];
+} TraceRing;
+
+int trace_enabled = 0;
+
+static int trace_capacity;
+static TraceRing* trace_rings[TRACE_MAX_THREADS];
+static int trace_num_rings;
+static unsigned long trace_dropped; // Events from threads that never got a ring
+static __thread TraceRing* trace_ring;
+
+// Function to turn tracing on with the given ring size (rounded up to a power of two)
+int trace_init(int events_per_thread) {
+    int cap = 1;
+    while (cap < events_per_thread) {
+        cap <<= 1;
+    }
+    trace_capacity = cap;
+    trace_enabled = 1;
+    return trace_thread_start("main");
+}
+
+// Function to give the calling thread its ring; allocating happens here, never when recording
+int trace_thread_start(const char* name) {
+    if (!trace_enabled || trace_ring) {
+        return 0;
+    }
+    
+    int slot = __atomic_fetch_add(&trace_num_rings, 1, __ATOMIC_RELAXED);
+    if (slot >= TRACE_MAX_THREADS) {
+        return -1; // Its events are counted as dropped
+    }
+    
+    TraceRing* ring = calloc(1, sizeof(TraceRing) + (size_t)trace_capacity * sizeof(TraceEvent));
+    if (!ring) {
+        return -1;
+    }
+    ring->thread_name = name;
+    ring->tid = slot + 1;
+    ring->mask = trace_capacity - 1;
+    trace_ring = ring;
+    __atomic_store_n(&trace_rings[slot], ring, __ATOMIC_RELEASE);
+    trace_record("thread start", perf_clock(), -1);
+    return 0;
+}
+
+// Function to mark the end of the calling thread's life in the trace
+void trace_thread_exit() {
+    trace_instant("thread exit");
+}
+
+// Function to append an event to the calling thread's ring, overwriting the oldest when full
+void trace_record(const char* name, long long start, long long dur) {
+    TraceRing* ring = trace_ring;
+    if (!ring) {
+        __atomic_fetch_add(&trace_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    
+    TraceEvent* ev = &ring->events[ring->head & ring->mask];
+    ev->ts = start;
+    ev->dur = dur;
+    ev->name = name;
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+// Function to write every ring as Chrome trace-event JSON (load it in ui.perfetto.dev or chrome://tracing)
+int trace_write(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        return -1;
+    }
+    
+    int pid = getpid();
+    int rings = trace_num_rings < TRACE_MAX_THREADS ? trace_num_rings : TRACE_MAX_THREADS;
+    unsigned long overwritten = 0;
+    int first = 1;
+    
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (int r = 0; r < rings; r++) {
+        TraceRing* ring = __atomic_load_n(&trace_rings[r], __ATOMIC_ACQUIRE);
+        if (!ring) {
+            continue;
+        }
+        
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", pid, ring->tid, ring->thread_name);
+        first = 0;
+        
+        unsigned long long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        unsigned long long begin = head > ring->mask + 1 ? head - ring->mask - 1 : 0;
+        overwritten += begin;
+        for (unsigned long long i = begin; i < head; i++) {
+            TraceEvent* ev = &ring->events[i & ring->mask];
+            if (ev->dur < 0) {
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                        ev->name, ev->ts / 1000.0, pid, ring->tid);
+            } else {
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                        ev->name, ev->ts / 1000.0, ev->dur / 1000.0, pid, ring->tid);
+            }
+        }
+    }
+    fprintf(f, "\n],\"otherData\":{\"overwritten\":%lu,\"dropped\":%lu}}\n", overwritten, trace_dropped);
+    
+    return fclose(f) == 0 ? 0 : -1;
+}
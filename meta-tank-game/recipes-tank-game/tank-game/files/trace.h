@@ -0,0 +1,45 @@
+#ifndef TANK_TRACE_H
+#define TANK_TRACE_H
+
+
+#include "perf.h"
+
+#define TRACE_MAX_THREADS 64
+#define TRACE_DEFAULT_EVENTS 65536 // Per thread, a power of two; the oldest events are overwritten
+
+// One recorded span (dur > 0 or a complete event) or instant (dur < 0)
+typedef struct {
+    long long ts; // Start, monotonic ns
+    long long dur;
+    const char* name; // Must be a string literal, it is only dereferenced when the trace is written
+} TraceEvent;
+
+// Tracing is off (and every trace point a single branch) until trace_init() succeeds
+extern int trace_enabled;
+
+int trace_init(int events_per_thread);
+int trace_thread_start(const char* name);
+void trace_thread_exit();
+void trace_record(const char* name, long long start, long long dur);
+int trace_write(const char* path);
+
+// Function to start timing a span, 0 when tracing is off
+static inline long long trace_begin() {
+    return trace_enabled ? perf_clock() : 0;
+}
+
+// Function to record a span that started at trace_begin()
+static inline void trace_end(const char* name, long long start) {
+    if (trace_enabled && start) {
+        trace_record(name, start, perf_clock() - start);
+    }
+}
+
+// Function to record a point in time
+static inline void trace_instant(const char* name) {
+    if (trace_enabled) {
+        trace_record(name, perf_clock(), -1);
+    }
+}
+
+#endif